@@ -4,8 +4,31 @@
 extern "C" {
 #endif
 
+#include <stdint.h>
+#include "axis.h"
+
 #define PERIOD_CTRL 10		//!< Period of the control loop in milliseconds.
-#define PERIOD_REF 4000		//!< Period of the reference switch in milliseconds.
+#define PERIOD_REF 4000		//!< Period of the reference switch of the built-in profile (profile.h), ms.
+
+#define IMAGE_FLAG_REMOTE 0x01U	//!< Process image: reference came from the bus.
+#define IMAGE_FLAG_SYNC 0x02U		//!< Process image: tick consumed a SYNC.
+
+/**
+ * @brief Coherent set of control-loop signals from one tick.
+ *
+ * Published once at the end of every control tick; all fields belong to the
+ * same tick. Two buffers alternate, the latest is image_buf[image_seq & 1].
+ */
+typedef struct {
+    uint32_t seq;						//!< Tick sequence number, starts at 1.
+    uint32_t millisec;					//!< Control tick time in milliseconds.
+    uint64_t time_us;					//!< Disciplined (bus-synchronised) time at publication.
+    int32_t reference[AXIS_COUNT];		//!< Reference in effect, RPM.
+    int32_t velocity[AXIS_COUNT];		//!< Measured velocity, RPM.
+    int32_t control[AXIS_COUNT];		//!< Controller output, Q30.
+    uint16_t thermal[AXIS_COUNT];		//!< Winding heat estimate, permille of the limit.
+    uint8_t flags;						//!< IMAGE_FLAG_* bits.
+} ProcessImage_t;
 
 /**
  * @brief Initializes the application.
@@ -26,6 +49,34 @@ void Application_Setup(void);
  */
 void Application_Loop(void);
 
+/**
+ * @brief Synchronous control tick for all axes.
+ *
+ * Runs in the tick layer (see irq.h), pended by the TIM3 (PWM master) update
+ * interrupt once every PERIOD_CTRL milliseconds, after all encoder counts
+ * have been latched at the same instant.
+ * Runs the estimator, controller and actuation for every axis in one pass.
+ */
+void Application_Tick(void);
+
+/**
+ * @brief Work that can wait, run in the background layer after every tick.
+ */
+void Application_Background(void);
+
+/**
+ * @brief Copy the latest process image.
+ *
+ * Lock-free and safe from any context: the reader never disables interrupts
+ * and only fails if its copy overlapped two publications (a reader stalled
+ * for more than a tick), in which case it retries a few times.
+ *
+ * @param image Receives the image.
+ * @return 1 on success, 0 if no consistent image could be taken (or none
+ * was published yet).
+ */
+uint8_t Application_ReadImage(ProcessImage_t *image);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,21 @@
+#ifndef _AXIS_H_
+#define _AXIS_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AXIS_MAX 4			//!< Maximum number of motor axes one board can drive.
+
+#ifndef AXIS_COUNT
+#define AXIS_COUNT 1		//!< Number of motor axes driven by this build (1..AXIS_MAX).
+#endif
+
+#if (AXIS_COUNT < 1) || (AXIS_COUNT > AXIS_MAX)
+#error "AXIS_COUNT must be in the range 1..AXIS_MAX"
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // _AXIS_H_
@@ -0,0 +1,75 @@
+#ifndef _BOOT_H_
+#define _BOOT_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef STM32F103xB
+#include "stm32f1xx.h"
+#endif
+#ifdef STM32L476xx
+#include "stm32l4xx.h"
+#endif
+
+#include <stdint.h>
+
+/*
+ * Boot profile: DWT timestamps at the end of each start-up phase, from main
+ * entry to the end of the first control tick. Reset handler and scatter-load
+ * run before main and are not included. The counter runs at whatever the
+ * core clock is, so each phase is converted to microseconds with the clock
+ * in effect when it started (the phase that switches to the PLL is an upper
+ * bound).
+ */
+
+#ifndef BOOT_FAST
+#define BOOT_FAST 1						//!< 1 starts the PLL at main entry so it locks during HAL_Init.
+#endif
+
+/* Phases, in start-up order; each mark is taken at the end of the phase */
+#define BOOT_MAIN 0U					//!< main entered (time 0).
+#define BOOT_HAL 1U						//!< HAL_Init done.
+#define BOOT_CLOCK 2U					//!< SystemClock_Config done, running from the PLL.
+#define BOOT_PERIPH 3U					//!< CubeMX GPIO and timer init done.
+#define BOOT_AXES 4U					//!< Additional axis timers and pins done.
+#define BOOT_SETUP 5U					//!< Application_Setup done, control tick running.
+#define BOOT_TICK 6U					//!< First closed-loop tick finished.
+#define BOOT_PHASES 7U
+
+/**
+ * @brief Boot profile as laid out in RAM (Watch).
+ */
+typedef struct {
+    uint32_t cycles[BOOT_PHASES];	//!< Cycle counter at each mark.
+    uint32_t us[BOOT_PHASES];		//!< Microseconds from main entry to each mark.
+    uint32_t hz;					//!< Core clock of the phase in progress.
+    uint8_t reported;				//!< Profile has been logged.
+} Boot_Profile_t;
+
+extern Boot_Profile_t g_boot;
+
+/**
+ * @brief Start the boot profile; first statement of main.
+ *
+ * With BOOT_FAST, also starts the PLL with the SystemClock_Config settings,
+ * so SystemClock_Config finds it locked (or nearly) instead of waiting.
+ */
+void Boot_Start(void);
+
+/**
+ * @brief Record the end of a start-up phase.
+ *
+ * @param phase BOOT_* phase that just finished.
+ */
+void Boot_Mark(uint8_t phase);
+
+/**
+ * @brief Log the profile once the first tick has run; call from thread mode.
+ */
+void Boot_Report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // _BOOT_H_
@@ -0,0 +1,185 @@
+#ifndef _CANBUS_H_
+#define _CANBUS_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#ifndef CANBUS_NODE_ID
+#define CANBUS_NODE_ID 1				//!< Node id of this drive on the bus (1..127).
+#endif
+
+#define CANBUS_BITRATE 500000			//!< Bus bit rate in bit/s.
+#define CANBUS_RX_TIMEOUT_MS 100		//!< Remote reference is dropped after this long without a RxPDO.
+
+/* Identifiers (CANopen-style COB-IDs, 11-bit) */
+#define CANBUS_ID_SYNC 0x080U							//!< SYNC, broadcast by the bus master.
+#define CANBUS_ID_TIME 0x100U							//!< TIME follow-up: SYNC counter, 48-bit master time (us).
+#define CANBUS_ID_RXPDO (0x200U + CANBUS_NODE_ID)		//!< Reference in: int16 RPM per axis.
+#define CANBUS_ID_TXPDO(axis) (0x180U + 0x100U * (uint32_t)(axis) + CANBUS_NODE_ID)	//!< Status out, one per axis.
+
+/* TxPDO status byte */
+#define CANBUS_STATUS_REMOTE 0x01U		//!< Reference comes from the bus.
+#define CANBUS_STATUS_TIMEOUT 0x02U		//!< Remote reference timed out, holding zero.
+#define CANBUS_STATUS_SATURATED 0x04U	//!< Control output at its limit.
+#define CANBUS_STATUS_HOT 0x08U			//!< Winding heat at or above the limit (output derated to the continuous current).
+
+/**
+ * @brief Classic CAN frame with an 11-bit identifier.
+ */
+typedef struct {
+    uint32_t id;		//!< Standard identifier.
+    uint8_t dlc;		//!< Data length [0, 8].
+    uint8_t data[8];	//!< Payload, little-endian fields.
+} CanBus_Frame_t;
+
+/**
+ * @brief What the transport should do after handing over a received frame.
+ */
+typedef enum {
+    CANBUS_EVENT_NONE = 0,	//!< Nothing time-critical.
+    CANBUS_EVENT_SYNC,		//!< SYNC received: align the control tick now.
+    CANBUS_EVENT_DROPPED,	//!< Receive queue full, frame lost.
+} CanBus_Event_t;
+
+/**
+ * @brief Initialise queues, PDO state and the transport.
+ *
+ * The transport is asked to accept only the identifiers this node consumes,
+ * so filtering is done in hardware.
+ *
+ * @return 1 if the transport came up, 0 otherwise (the node stays silent).
+ */
+uint8_t CanBus_Init(void);
+
+/**
+ * @brief Consume received frames; call once at the start of each control tick.
+ *
+ * RxPDO values are staged and become active at the next SYNC, so all nodes
+ * switch their references on the same tick.
+ *
+ * @param millisec Current control tick time in milliseconds.
+ * @return 1 if a SYNC was consumed, i.e. this tick should publish its TxPDOs.
+ */
+uint8_t CanBus_Poll(uint32_t millisec);
+
+/**
+ * @brief Get the bus reference for one axis.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @param reference Receives the reference in RPM when remote control is active.
+ * @return 1 if the reference is under remote control, 0 to use the local one.
+ */
+uint8_t CanBus_GetReference(uint8_t axis, int32_t *reference);
+
+/**
+ * @brief Queue the TxPDO of one axis for transmission.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @param velocity Measured velocity in RPM.
+ * @param control Controller output in Q30.
+ * @param thermal Winding heat estimate, permille of the limit.
+ */
+void CanBus_PublishStatus(uint8_t axis, int32_t velocity, int32_t control, uint16_t thermal);
+
+/**
+ * @brief Send a SYNC (time master only).
+ *
+ * The local node treats it as received at its next CanBus_Poll, so it
+ * publishes and switches references on the same tick as everyone else.
+ *
+ * @param counter SYNC counter byte.
+ */
+void CanBus_SendSync(uint8_t counter);
+
+/**
+ * @brief Send the TIME follow-up of a SYNC (time master only).
+ *
+ * @param counter Counter byte of the SYNC it refers to.
+ * @param time_us Master time at which that SYNC was sent.
+ */
+void CanBus_SendTime(uint8_t counter, uint64_t time_us);
+
+/**
+ * @brief Take the last TIME follow-up consumed by CanBus_Poll.
+ *
+ * @param counter Receives the counter byte of the SYNC it refers to.
+ * @param time_us Receives the master time of that SYNC (TIMESYNC_TIME_BITS wide).
+ * @return 1 if a new follow-up was available, 0 otherwise.
+ */
+uint8_t CanBus_TakeTime(uint8_t *counter, uint64_t *time_us);
+
+/**
+ * @brief Hand a received frame to the protocol layer (copying variant of CanBus_RxReserve).
+ *
+ * @param frame Received frame.
+ * @return Event the transport must act on.
+ */
+CanBus_Event_t CanBus_OnFrame(const CanBus_Frame_t *frame);
+
+/**
+ * @brief Get a receive queue slot to fill in place (transport RX interrupt).
+ *
+ * @return Slot to fill, or NULL if the queue is full (the frame is counted as dropped).
+ */
+CanBus_Frame_t *CanBus_RxReserve(void);
+
+/**
+ * @brief Hand the slot from CanBus_RxReserve to the protocol layer.
+ *
+ * @return Event the transport must act on.
+ */
+CanBus_Event_t CanBus_RxCommit(void);
+
+/**
+ * @brief Oldest frame waiting for transmission, read in place (transport TX interrupt).
+ *
+ * @return Frame, or NULL if the transmit queue is empty.
+ */
+const CanBus_Frame_t *CanBus_TxPeek(void);
+
+/**
+ * @brief Drop the frame returned by CanBus_TxPeek once it is in a mailbox.
+ */
+void CanBus_TxRelease(void);
+
+/**
+ * @brief Fetch the next frame to transmit (copying variant of CanBus_TxPeek).
+ *
+ * @param frame Receives the frame.
+ * @return 1 if a frame was returned, 0 if the transmit queue is empty.
+ */
+uint8_t CanBus_NextTx(CanBus_Frame_t *frame);
+
+/* Transport hooks, implemented by canbus_bxcan.c on target or a host stand-in */
+
+/**
+ * @brief Bring up the transport and accept only the listed identifiers.
+ *
+ * @param ids Standard identifiers to accept.
+ * @param count Number of identifiers.
+ * @return 1 on success, 0 otherwise.
+ */
+uint8_t CanBus_Port_Init(const uint16_t *ids, uint8_t count);
+
+/**
+ * @brief Make sure the transmit path drains the queue via CanBus_NextTx.
+ */
+void CanBus_Port_RequestTx(void);
+
+/**
+ * @brief Transmit mailbox interrupt of the target transport (CAN1_TX_IRQHandler).
+ */
+void CanBus_Port_TxIRQHandler(void);
+
+/**
+ * @brief FIFO0 receive interrupt of the target transport (CAN1_RX0_IRQHandler).
+ */
+void CanBus_Port_Rx0IRQHandler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // _CANBUS_H_
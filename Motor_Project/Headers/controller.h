@@ -10,6 +10,50 @@ extern "C" {
 #include <arm_acle.h>
 #endif
 
+/*
+ * Reversal manager. When the reference changes sign, REV_MODE (Watch) picks
+ * how the drive gets through zero before the PI law takes over again:
+ *  - PI: the PI law handles it (feedforward flips, the motor follows)
+ *  - BRAKE: both low sides on (control 0) until the speed is near zero
+ *  - PLUG: drive against the rotation until it reverses, with the estimated
+ *    current (control minus back-EMF, U_PER_RPM * speed) held at REV_I_LIMIT
+ *  - BANGBANG: the same current-limited drive all the way to the new speed,
+ *    handed back REV_HANDOFF_RPM before it
+ * Decisions use the speed predicted for the next tick, extrapolated over
+ * the lag of the velocity estimate (REV_LEAD_MS) and one tick period. At the
+ * handoff the integrator is preloaded with its settled value for the new
+ * direction (the mirror of the old one until that direction has been seen),
+ * so the PI law starts where it will end up.
+ */
+#define CONTROLLER_REV_PI 0				//!< No reversal manager.
+#define CONTROLLER_REV_BRAKE 1			//!< Dynamic braking, then PI.
+#define CONTROLLER_REV_PLUG 2			//!< Current-limited plugging, then PI.
+#define CONTROLLER_REV_BANGBANG 3		//!< Current-limited full drive, then PI.
+
+/*
+ * Thermal protection. Each axis keeps an I^2t estimate of its winding heat:
+ * the current of the last tick (the output that reached the bridge, see
+ * Controller_SetApplied, minus back-EMF, as above) squared relative to
+ * THERM_I_CONT, the current the winding can carry forever, and filtered
+ * with the winding time constant THERM_TAU_MS. 1.0 (the limit) is
+ * the steady state at THERM_I_CONT. From THERM_DERATE_AT on, the output is
+ * held within a current limit of the back-EMF that falls linearly from
+ * unlimited to THERM_I_CONT at the limit, so a stalled motor is throttled
+ * smoothly to a current it can stand rather than cut off. The reversal
+ * manager's drive is limited the same way.
+ */
+
+/*
+ * Manual mode, for commissioning. Bit n of MANUAL_AXES (Watch) puts axis n
+ * on the duty in MANUAL_DUTY[n] (Q30, within the thermal limit) instead of
+ * the PI law and the reversal manager. Meanwhile the integrator is
+ * back-calculated every tick so that feedforward, P term and integrator add
+ * up to the applied duty; clearing the bit hands over to the PI law from
+ * exactly that output. Live changes of Kp and U_PER_RPM are tracked the same
+ * way: the integrator takes up the step they would cause. Both transfers
+ * are bumpless while the integrator needed stays within I_CLAMP.
+ */
+
 /**
  * @brief Apply a PI-control law to calculate the control signal for the motor.
  *
@@ -24,11 +68,86 @@ extern "C" {
  */
 int32_t Controller_PIController(const int32_t* reference, const int32_t* measured, const uint32_t* millisec);
 
+/**
+ * @brief Apply the PI-control law for one motor axis.
+ *
+ * Same law as Controller_PIController, but with per-axis integrator and timing
+ * state. Controller_PIController is equivalent to calling this with axis 0.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @param reference Pointer to the reference value.
+ * @param measured Pointer to the measured value.
+ * @param millisec Pointer to the timestamp in milliseconds.
+ * @return The calculated control signal for the motor.
+ */
+int32_t Controller_PIControllerAxis(uint8_t axis, const int32_t* reference, const int32_t* measured, const uint32_t* millisec);
+
+/**
+ * @brief Report the output that reached the bridge this tick, for the thermal model.
+ *
+ * The drive ramp and the stall detector may apply less than the controller
+ * output, or nothing; the winding heats with what was applied. Call after
+ * actuation; without it the model takes the controller output as applied.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @param applied Output applied, Q30.
+ */
+void Controller_SetApplied(uint8_t axis, int32_t applied);
+
+/**
+ * @brief Hold an output within the thermal limit of an axis.
+ *
+ * For outputs that bypass the PI law (the duty sweep of peripherals.h): the
+ * same current limit around the back-EMF as this tick's controller output.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @param out Output, Q30.
+ * @return out, limited as the controller's last output was.
+ */
+int32_t Controller_ThermalLimit(uint8_t axis, int32_t out);
+
+/**
+ * @brief Whether an axis is in a reversal, with the manager driving the output.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @return CONTROLLER_REV_* strategy in progress, CONTROLLER_REV_PI if none.
+ */
+uint8_t Controller_Reversal(uint8_t axis);
+
+/**
+ * @brief Winding heat estimate of an axis.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @return Heat in permille of the limit; derating starts at THERM_DERATE_AT.
+ */
+uint16_t Controller_Thermal(uint8_t axis);
+
+/**
+ * @brief Copy the controller state (integrators, timing) of all axes.
+ *
+ * Together with Controller_RestoreState this lets a recording start from a
+ * running controller and be replayed from the same state.
+ *
+ * @param dst Destination buffer.
+ * @param size Size of dst in bytes.
+ * @return Bytes written, 0 if dst is too small.
+ */
+uint32_t Controller_SaveState(void* dst, uint32_t size);
+
+/**
+ * @brief Restore controller state saved by Controller_SaveState.
+ *
+ * @param src State blob.
+ * @param size Size of the blob; must match this build (same AXIS_COUNT).
+ * @return 1 on success, 0 on a size mismatch.
+ */
+uint8_t Controller_RestoreState(const void* src, uint32_t size);
+
 /**
  * @brief Reset internal state variables, such as the integrator.
  *
  * This function triggers a reset of the internal state variables of the controller,
- * including the integrator, to their initial values.
+ * including the integrator, to their initial values (for every axis).
  * It doesn't take any arguments and doesn't return any value.
  */
 void Controller_Reset(void);
@@ -0,0 +1,95 @@
+#ifndef _CPULOAD_H_
+#define _CPULOAD_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * CPU load accounting on the cycle counter.
+ *
+ * Every handler brackets its work with CpuLoad_Enter/CpuLoad_Exit, which
+ * charge the cycles since the last switch to whatever context was running, so
+ * each context only gets its own cycles, not those of the layers preempting
+ * it. Thread mode is split after the fact: each pass of the main loop tells
+ * CpuLoad_Thread whether it did any work (streamed log words); passes that
+ * did not only polled, and count as idle.
+ *
+ * CpuLoad_Tick closes a window at every control tick (g_cpuload.tick_load,
+ * tick_peak) and a one second window every CPULOAD_WINDOW_MS (load, share[]).
+ * The second's figures are logged from the background layer, so they reach
+ * the host on the same stream as every other message.
+ */
+
+#define CPULOAD_WINDOW_MS 1000U			//!< Utilisation window.
+
+/* Contexts the cycles are charged to */
+#define CPULOAD_IDLE 0U					//!< Main loop with nothing to do.
+#define CPULOAD_THREAD 1U				//!< Main loop work (log streaming).
+#define CPULOAD_FAST 2U					//!< TIM3 update, fast layer.
+#define CPULOAD_TICK 3U					//!< Control tick layer.
+#define CPULOAD_BACKGROUND 4U			//!< PendSV background layer.
+#define CPULOAD_CAN 5U					//!< CAN RX0 and TX.
+#define CPULOAD_SYSTICK 6U				//!< HAL tick.
+#define CPULOAD_CONTEXTS 7U
+
+/**
+ * @brief CPU load figures (Watch). Shares are in permille.
+ */
+typedef struct {
+    volatile uint32_t load;							//!< Busy share of the last window (everything but idle).
+    volatile uint32_t share[CPULOAD_CONTEXTS];		//!< Share of each context in the last window.
+    volatile uint32_t tick_load;					//!< Busy share of the last control tick period.
+    volatile uint32_t tick_peak;					//!< Worst tick_load in the last window.
+    volatile uint32_t tick_peak_max;				//!< Worst tick_load since CpuLoad_Init.
+    volatile uint32_t windows;						//!< Windows completed.
+    volatile uint32_t cycles[CPULOAD_CONTEXTS];		//!< Cycles charged to each context (wraps).
+} CpuLoad_t;
+
+extern CpuLoad_t g_cpuload;
+
+/**
+ * @brief Start accounting; thread mode is the running context.
+ *
+ * @param tick_ms Control tick period, to count ticks per window.
+ */
+void CpuLoad_Init(uint32_t tick_ms);
+
+/**
+ * @brief Switch to a handler context; first thing in the handler.
+ *
+ * @param context CPULOAD_FAST..CPULOAD_SYSTICK.
+ * @return Preempted context, for CpuLoad_Exit.
+ */
+uint8_t CpuLoad_Enter(uint8_t context);
+
+/**
+ * @brief Charge the handler and return to the preempted context; last thing in the handler.
+ *
+ * @param previous Value returned by the matching CpuLoad_Enter.
+ */
+void CpuLoad_Exit(uint8_t previous);
+
+/**
+ * @brief Close one pass of the main loop.
+ *
+ * @param busy Non-zero if the pass did work; its cycles count as thread, else as idle.
+ */
+void CpuLoad_Thread(uint8_t busy);
+
+/**
+ * @brief Close the tick window, and the utilisation window when it is full; control tick.
+ */
+void CpuLoad_Tick(void);
+
+/**
+ * @brief Log the figures of each newly completed window; background layer.
+ */
+void CpuLoad_Report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // _CPULOAD_H_
@@ -0,0 +1,127 @@
+#ifndef _DRIVE_H_
+#define _DRIVE_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "axis.h"
+#include <stdint.h>
+
+/*
+ * Drive state machine, per axis: owns the bridge enable and scales the
+ * control on its way to the PWM stage.
+ *
+ *   DISABLED --enable--> PRECHARGE --precharge_ms--> READY --enable--> ENABLED
+ *   ENABLED --disable--> STOPPING --ramp done--> DISABLED
+ *   any --fault--> FAULT --faults cleared--> RECOVERING --recover_ms--> PRECHARGE
+ *
+ * PRECHARGE and READY hold the bridge on at zero output, so the bootstrap
+ * supplies of the driver are charged before any torque is asked for.
+ * ENABLED ramps the output in over enable_ms; STOPPING ramps it out over
+ * disable_ms and only then switches the bridge off. A disable in PRECHARGE or
+ * READY, where the output is already zero, goes to DISABLED at once.
+ *
+ * Drive_Fault is the safe torque off: it switches the bridge off on the spot
+ * and latches its cause; FAULT is entered on the next tick. A fault clears
+ * only when every cause has been cleared, after which RECOVERING keeps the
+ * bridge off for recover_ms and then restarts from PRECHARGE if the drive is
+ * still enabled, else goes to DISABLED. A watchdog fault is latched from
+ * g_watchdog and never clears: the reset follows it.
+ *
+ * Commands only set requests and faults; every transition is taken in
+ * Drive_Tick, at most one per axis and tick, fault first, then disable, then
+ * enable, then timers, and each one is logged with its tick time. All calls
+ * belong to the tick layer.
+ */
+
+/* States */
+#define DRIVE_DISABLED 0U				//!< Bridge off.
+#define DRIVE_PRECHARGE 1U				//!< Bridge on at zero output for precharge_ms.
+#define DRIVE_READY 2U					//!< Bridge on at zero output, waiting for enable.
+#define DRIVE_ENABLED 3U				//!< Output follows the control, ramped in.
+#define DRIVE_STOPPING 4U				//!< Output ramps out, then the bridge goes off.
+#define DRIVE_FAULT 5U					//!< Safe torque off until every cause clears.
+#define DRIVE_RECOVERING 6U				//!< Causes cleared, bridge off for recover_ms.
+
+/* Fault causes */
+#define DRIVE_FAULT_STALL 0x01U			//!< Blocked rotor (stall.h).
+#define DRIVE_FAULT_WATCHDOG 0x02U		//!< Supervisor fault (watchdog.h); never clears.
+#define DRIVE_FAULT_USER 0x04U			//!< Raised from the debugger or a host command.
+
+#define DRIVE_GAIN_ONE 32768U			//!< Output gain 1.0, Q15.
+
+/**
+ * @brief Sequencing times (Watch), shared by all axes.
+ */
+typedef struct {
+    volatile uint32_t precharge_ms;	//!< Bridge on at zero output before READY.
+    volatile uint32_t enable_ms;	//!< Ramp of the output from zero to full.
+    volatile uint32_t disable_ms;	//!< Ramp of the output from full to zero.
+    volatile uint32_t recover_ms;	//!< Bridge off after the faults cleared.
+} Drive_Config_t;
+
+/**
+ * @brief State of one axis (Watch).
+ */
+typedef struct {
+    volatile uint8_t state;			//!< DRIVE_* state.
+    volatile uint8_t enable;		//!< Enable request; Drive_Enable/Drive_Disable, or write it.
+    volatile uint8_t faults;		//!< Latched DRIVE_FAULT_* causes.
+    volatile uint16_t gain;			//!< Output gain, Q15 (DRIVE_GAIN_ONE = full).
+    volatile uint32_t since_ms;		//!< Tick time of the last transition.
+    volatile uint32_t transitions;	//!< Transitions since Drive_Init.
+} Drive_Axis_t;
+
+extern Drive_Config_t g_drive_cfg;
+extern Drive_Axis_t g_drive[AXIS_COUNT];
+
+/**
+ * @brief Switch every bridge off and enter DISABLED with no request.
+ */
+void Drive_Init(void);
+
+/**
+ * @brief Ask for the axis to be enabled; the sequence starts on the next tick.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ */
+void Drive_Enable(uint8_t axis);
+
+/**
+ * @brief Ask for a controlled stop: the output ramps to zero, then the bridge goes off.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ */
+void Drive_Disable(uint8_t axis);
+
+/**
+ * @brief Safe torque off: bridge off now, cause latched until Drive_ClearFault.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @param cause DRIVE_FAULT_* flag.
+ */
+void Drive_Fault(uint8_t axis, uint8_t cause);
+
+/**
+ * @brief Clear one fault cause; the drive recovers once none is left.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @param cause DRIVE_FAULT_* flag.
+ */
+void Drive_ClearFault(uint8_t axis, uint8_t cause);
+
+/**
+ * @brief Take the transition due this tick and return the control to apply; every tick.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @param control Control signal, Q30.
+ * @param millisec Tick time in milliseconds.
+ * @return control scaled by the ramp gain; 0 unless ENABLED or STOPPING.
+ */
+int32_t Drive_Tick(uint8_t axis, int32_t control, uint32_t millisec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // _DRIVE_H_
@@ -0,0 +1,152 @@
+#ifndef _IRQ_H_
+#define _IRQ_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef STM32F103xB
+#include "stm32f1xx.h"
+#endif
+#ifdef STM32L476xx
+#include "stm32l4xx.h"
+#endif
+
+#include <stdint.h>
+
+/*
+ * Interrupt priority plan (NVIC group 4: 16 preemption levels, no sub-priority).
+ * Lower numbers preempt higher ones. Thread mode only streams the log.
+ *
+ *   0  reserved      never masked by Irq_Lock (for emergency shutdown paths)
+ *   1  CAN RX/TX     SYNC timestamps must not wait behind the layers below
+ *   2  fast layer    TIM3 update, PWM-synchronous: period count, phase trim,
+ *                    encoder latch; pends the tick when one is due
+ *   3  tick layer    control tick (Application_Tick) on the otherwise unused
+ *                    TIM7 vector, pended by the fast layer
+ *   4  SysTick       HAL time base, only polled from thread mode
+ *  15  background    PendSV: metrics and reports, pended at the end of a tick
+ *
+ * Critical sections raise BASEPRI to IRQ_LOCK_ALL instead of setting PRIMASK,
+ * so priority 0 and the faults are never held off.
+ */
+
+#define IRQ_PRIO_RESERVED 0U			//!< Not masked by Irq_Lock.
+#define IRQ_PRIO_CAN 1U					//!< CAN RX0 and TX.
+#define IRQ_PRIO_FAST 2U				//!< TIM3 update (PWM master).
+#define IRQ_PRIO_TICK 3U				//!< Control tick.
+#define IRQ_PRIO_SYSTICK 4U				//!< HAL tick (TICK_INT_PRIORITY).
+#define IRQ_PRIO_BACKGROUND 15U			//!< PendSV background layer.
+
+#define IRQ_LOCK_ALL IRQ_PRIO_CAN		//!< Irq_Lock masks this priority and everything below it.
+
+#define IRQ_TICK_IRQn TIM7_IRQn			//!< Vector borrowed as the control tick software interrupt.
+
+/* Layers measured in g_irq */
+#define IRQ_LAYER_FAST 0U
+#define IRQ_LAYER_TICK 1U
+#define IRQ_LAYER_BACKGROUND 2U
+#define IRQ_LAYERS 3U
+
+#ifndef IRQ_STACK_SAMPLE
+#define IRQ_STACK_SAMPLE 64U			//!< Every Nth entry of a layer (not the fast one) measures its stack use; 0 = never.
+#endif
+
+#define IRQ_STACK_BYTES 0x800U			//!< Main stack size, must match Stack_Size in startup_stm32l476xx.s.
+#define IRQ_STACK_PAINT 0xDEADBEEFU		//!< Fill pattern for the stack measurement.
+
+/**
+ * @brief Measurements of one interrupt layer (Watch).
+ */
+typedef struct {
+    volatile uint32_t entries;		//!< Times the layer ran.
+    volatile uint32_t latency;		//!< Last delay from trigger to handler entry, CPU cycles.
+    volatile uint32_t latency_max;	//!< Largest delay seen.
+    volatile uint32_t stack_max;	//!< Deepest use below the handler entry, bytes, with preemption; 0 for the fast layer.
+    volatile uint32_t overruns;		//!< Triggered again before the previous run was taken.
+    volatile uint32_t pended_at;	//!< Cycle counter when the layer was last pended.
+} Irq_Layer_t;
+
+/**
+ * @brief Main stack high-water mark (Watch).
+ *
+ * Thread mode and every layer share the main stack. Irq_Init paints all of it
+ * below the caller, and the sampled layer measurements fold the deepest word
+ * touched into used_max before they repaint, so the figure covers every
+ * context since boot. Refreshed by Irq_Report.
+ */
+typedef struct {
+    volatile uint32_t used_max;		//!< Deepest main stack use since boot, bytes.
+    volatile uint32_t free_min;		//!< IRQ_STACK_BYTES - used_max; 0 means it overflowed.
+} Irq_Stack_t;
+
+extern Irq_Layer_t g_irq[IRQ_LAYERS];
+extern Irq_Stack_t g_irq_stack;
+
+/**
+ * @brief Mask every application interrupt (priority IRQ_LOCK_ALL and below).
+ *
+ * Nests: only ever raises the masking level.
+ *
+ * @return Previous BASEPRI, for Irq_Unlock.
+ */
+static inline uint32_t Irq_Lock(void) {
+    const uint32_t basepri = __get_BASEPRI();
+    __set_BASEPRI_MAX(IRQ_LOCK_ALL << (8U - __NVIC_PRIO_BITS));
+    return basepri;
+}
+
+/**
+ * @brief Restore the masking level saved by Irq_Lock.
+ *
+ * @param basepri Value returned by the matching Irq_Lock.
+ */
+static inline void Irq_Unlock(uint32_t basepri) {
+    __set_BASEPRI(basepri);
+}
+
+/**
+ * @brief Set the tick and background layer priorities and enable the tick vector.
+ *
+ * Also paints the free main stack for g_irq_stack; call from thread mode.
+ */
+void Irq_Init(void);
+
+/**
+ * @brief Pend the control tick layer; called from the fast layer.
+ */
+void Irq_PendTick(void);
+
+/**
+ * @brief Pend the background layer.
+ */
+void Irq_PendBackground(void);
+
+/**
+ * @brief Account for a layer entry; first thing in its handler.
+ *
+ * @param layer IRQ_LAYER_*.
+ * @param latency Delay from trigger to entry in CPU cycles, or UINT32_MAX to
+ *        take it from the cycle counter stamp left by Irq_Pend*.
+ * @return Token for Irq_Exit (non-zero when this entry measures stack use).
+ */
+uint32_t Irq_Enter(uint8_t layer, uint32_t latency);
+
+/**
+ * @brief Finish a layer entry; last thing in its handler.
+ *
+ * @param layer IRQ_LAYER_*.
+ * @param token Value returned by Irq_Enter.
+ */
+void Irq_Exit(uint8_t layer, uint32_t token);
+
+/**
+ * @brief Log each layer whose worst latency or stack use grew, and the main
+ * stack high-water mark when it grew; background layer.
+ */
+void Irq_Report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // _IRQ_H_
@@ -0,0 +1,132 @@
+#ifndef _LOCKFREE_H_
+#define _LOCKFREE_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/**
+ * @brief Single-producer/single-consumer ring of fixed-size elements.
+ *
+ * The producer only writes head, the consumer only writes tail, so no
+ * read-modify-write (LDREX/STREX) is needed; acquire/release ordering on the
+ * indices is enough, both between an ISR and thread mode and between two
+ * host threads. Elements are filled and consumed in place (reserve/commit,
+ * peek/release), so nothing is copied through the ring.
+ */
+typedef struct {
+    _Atomic uint32_t head;		//!< Next slot to fill (producer).
+    _Atomic uint32_t tail;		//!< Next slot to drain (consumer).
+    uint8_t *buf;				//!< Storage, count * size bytes.
+    uint32_t size;				//!< Element size in bytes.
+    uint32_t mask;				//!< count - 1, count is a power of two.
+} Ring_t;
+
+/**
+ * @brief Sequence lock for one writer and any number of readers.
+ *
+ * Readers never block the writer; they retry if a write overlapped their copy.
+ */
+typedef struct {
+    _Atomic uint32_t seq;		//!< Odd while a write is in progress.
+} SeqLock_t;
+
+/**
+ * @brief Statically allocate storage for a ring.
+ *
+ * @param name Name of the storage array.
+ * @param type Element type.
+ * @param count Number of elements, a power of two.
+ */
+#define RING_STORAGE(name, type, count) \
+    _Static_assert(((count) & ((count) - 1U)) == 0U && (count) > 0U, "ring size must be a power of two"); \
+    static type name[count]
+
+/**
+ * @brief Initialise an empty ring over caller storage.
+ *
+ * @param ring Ring to initialise.
+ * @param storage count elements of size bytes.
+ * @param size Element size in bytes.
+ * @param count Number of elements, a power of two.
+ * @return 1 on success, 0 if count is not a power of two.
+ */
+uint8_t Ring_Init(Ring_t *ring, void *storage, uint32_t size, uint32_t count);
+
+/**
+ * @brief Producer: get the next free slot to fill in place.
+ *
+ * @param ring Ring.
+ * @return Slot to write, or NULL if the ring is full.
+ */
+void *Ring_Reserve(Ring_t *ring);
+
+/**
+ * @brief Producer: publish the slot returned by Ring_Reserve.
+ *
+ * @param ring Ring.
+ */
+void Ring_Commit(Ring_t *ring);
+
+/**
+ * @brief Consumer: get the oldest element without removing it.
+ *
+ * @param ring Ring.
+ * @return Element to read, or NULL if the ring is empty.
+ */
+const void *Ring_Peek(Ring_t *ring);
+
+/**
+ * @brief Consumer: hand the slot returned by Ring_Peek back to the producer.
+ *
+ * @param ring Ring.
+ */
+void Ring_Release(Ring_t *ring);
+
+/**
+ * @brief Number of committed elements not yet released (either side).
+ *
+ * @param ring Ring.
+ * @return Element count.
+ */
+uint32_t Ring_Count(Ring_t *ring);
+
+/**
+ * @brief Consumer: drop everything queued so far.
+ *
+ * @param ring Ring.
+ */
+void Ring_Flush(Ring_t *ring);
+
+/**
+ * @brief Writer: copy size bytes of src into the protected data.
+ *
+ * @param lock Lock guarding dst.
+ * @param dst Protected data.
+ * @param src New value.
+ * @param size Bytes to copy.
+ */
+void SeqLock_Write(SeqLock_t *lock, void *dst, const void *src, uint32_t size);
+
+/**
+ * @brief Reader: copy a consistent value of the protected data.
+ *
+ * Bounded so a reader that preempts the writer (which can never finish while
+ * the reader spins) gives up instead of hanging.
+ *
+ * @param lock Lock guarding src.
+ * @param dst Receives the copy.
+ * @param src Protected data.
+ * @param size Bytes to copy.
+ * @param tries Attempts before giving up (at least 1).
+ * @return 1 if dst holds a consistent copy, 0 otherwise.
+ */
+uint8_t SeqLock_Read(SeqLock_t *lock, void *dst, const void *src, uint32_t size, uint32_t tries);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // _LOCKFREE_H_
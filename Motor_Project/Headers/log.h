@@ -0,0 +1,126 @@
+#ifndef _LOG_H_
+#define _LOG_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef STM32F103xB
+#include "stm32f1xx.h"
+#endif
+#ifdef STM32L476xx
+#include "stm32l4xx.h"
+#endif
+
+#include <stdint.h>
+
+/*
+ * Deferred-format logging. A call site such as
+ *
+ *     LOG2("timesync: step %d us, drift %d ppb", step, ppb);
+ *
+ * stores only a header word (file id, line, argument count), the cycle
+ * counter and the raw 32-bit arguments. The format string never reaches the
+ * image: Tools/host/log_dict.c extracts it from the sources into a dictionary
+ * keyed by file id and line, and Tools/host/log_decode.c formats the messages
+ * on the host. Keep each LOGn( call and its format string on one line.
+ *
+ * Every file that logs defines a unique LOG_FILE_ID before including this
+ * header. Ids in use:
+ *   1 application.c
+ *   2 timesync.c
+ *   3 boot.c
+ *   4 irq.c
+ *   5 watchdog.c
+ *   6 cpuload.c
+ *   7 stall.c
+ *   8 drive.c
+ *   9 profile.c
+ */
+
+#ifndef LOG_FILE_ID
+#define LOG_FILE_ID 0					//!< 0 = file not registered, the decoder shows raw words.
+#endif
+
+#ifndef LOG_ENABLE
+#define LOG_ENABLE 1					//!< 0 compiles every LOGn call away.
+#endif
+
+#define LOG_RING_WORDS 512U				//!< RAM ring size in words, a power of two.
+#define LOG_ITM_PORT 1U					//!< ITM stimulus port (port 0 is left to printf-style viewers).
+#define LOG_FLUSH_MAX 64U				//!< Words streamed to ITM per Log_Flush call.
+#define LOG_MAGIC 0x31474F4CU			//!< "LOG1", lets the host decoder find and check a dump.
+
+/* Header word: 1 | file id (7) | line (16) | sync (5) | argument count (3) */
+#define LOG_SYNC 0x15U					//!< Fixed pattern the decoder resynchronises on.
+#define LOG_NARGS_MASK 0x7U				//!< Argument count field of the header.
+#define LOG_ARGS_MAX 4U					//!< Arguments per call.
+#define LOG_HEADER(nargs) \
+    (0x80000000UL | ((uint32_t)(LOG_FILE_ID) << 24) | ((uint32_t)__LINE__ << 8) | (LOG_SYNC << 3) | (uint32_t)(nargs))
+
+/**
+ * @brief Log ring as laid out in RAM (dumped as-is for the host decoder).
+ */
+typedef struct {
+    uint32_t magic;					//!< LOG_MAGIC.
+    uint32_t words;					//!< Ring size (LOG_RING_WORDS).
+    uint32_t cpu_hz;				//!< Cycle counter frequency.
+    volatile uint32_t head;			//!< Words written so far; next word goes to head % LOG_RING_WORDS.
+    volatile uint32_t tail;			//!< Start of the oldest message still in the ring.
+    uint32_t drain;					//!< Start of the next message to stream to ITM.
+    uint32_t lost;					//!< Messages overwritten before they were streamed.
+    uint32_t ring[LOG_RING_WORDS];
+} Log_Buffer_t;
+
+extern Log_Buffer_t g_log;
+
+/**
+ * @brief Initialise the log ring; the cycle counter must be running.
+ */
+void Log_Init(void);
+
+/**
+ * @brief Store one message; use the LOGn macros instead.
+ *
+ * Safe from any priority: the few words are written with interrupts masked.
+ * The ring overwrites the oldest messages when full.
+ *
+ * @param header LOG_HEADER(nargs) of the call site.
+ * @param a0 .. a3 Arguments; only the first nargs are stored.
+ */
+void Log_Write(uint32_t header, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+/**
+ * @brief Stream pending messages to the ITM stimulus port; call from thread mode.
+ *
+ * Does nothing unless a debugger has enabled ITM and LOG_ITM_PORT. Waits on
+ * the stimulus port, so never call it from an interrupt.
+ *
+ * @return Words sent.
+ */
+uint32_t Log_Flush(void);
+
+#if LOG_ENABLE
+// sizeof("" fmt) only checks that fmt is a string literal; nothing is emitted.
+#define LOG0(fmt) \
+    do { (void)sizeof("" fmt); Log_Write(LOG_HEADER(0U), 0U, 0U, 0U, 0U); } while (0)
+#define LOG1(fmt, a) \
+    do { (void)sizeof("" fmt); Log_Write(LOG_HEADER(1U), (uint32_t)(a), 0U, 0U, 0U); } while (0)
+#define LOG2(fmt, a, b) \
+    do { (void)sizeof("" fmt); Log_Write(LOG_HEADER(2U), (uint32_t)(a), (uint32_t)(b), 0U, 0U); } while (0)
+#define LOG3(fmt, a, b, c) \
+    do { (void)sizeof("" fmt); Log_Write(LOG_HEADER(3U), (uint32_t)(a), (uint32_t)(b), (uint32_t)(c), 0U); } while (0)
+#define LOG4(fmt, a, b, c, d) \
+    do { (void)sizeof("" fmt); Log_Write(LOG_HEADER(4U), (uint32_t)(a), (uint32_t)(b), (uint32_t)(c), (uint32_t)(d)); } while (0)
+#else
+#define LOG0(fmt) do { } while (0)
+#define LOG1(fmt, a) do { (void)(a); } while (0)
+#define LOG2(fmt, a, b) do { (void)(a); (void)(b); } while (0)
+#define LOG3(fmt, a, b, c) do { (void)(a); (void)(b); (void)(c); } while (0)
+#define LOG4(fmt, a, b, c, d) do { (void)(a); (void)(b); (void)(c); (void)(d); } while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // _LOG_H_
@@ -11,6 +11,8 @@ extern "C" {
 #include "stm32l4xx.h"
 #endif
 
+#include <stdint.h>
+
 /**
  * @brief Enable both half-bridges to drive the motor.
  *
@@ -67,6 +69,285 @@ void Peripheral_PWM_ActuateMotor(int32_t control);
  */
 int32_t Peripheral_Encoder_CalculateVelocity(uint32_t millisec);
 
+/**
+ * @brief Resolve the axis descriptor table into the per-axis register arrays.
+ *
+ * Must be called once after the timers have been initialised and before any
+ * of the *Axis functions below are used. The single-axis API above maps to
+ * axis 0 and calls this lazily, so existing callers need no change.
+ */
+void Peripheral_Axis_Init(void);
+
+/**
+ * @brief Enable both half-bridges of one axis.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ */
+void Peripheral_GPIO_EnableMotorAxis(uint8_t axis);
+
+/**
+ * @brief Disable both half-bridges of one axis.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ */
+void Peripheral_GPIO_DisableMotorAxis(uint8_t axis);
+
+/**
+ * @brief Drive the enable pins of every axis low, straight out of reset.
+ *
+ * Enables the GPIO clocks and makes the enable pins push-pull outputs, so it
+ * works before MX_GPIO_Init (pins come out of reset in analog mode).
+ */
+void Peripheral_GPIO_DisableMotorAll(void);
+
+/**
+ * @brief Drive one axis in both directions (same Q30 semantics as above).
+ *
+ * The duty is shaped by the linearisation table of the axis' drive mode.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @param control The control signal for driving the motor.
+ */
+void Peripheral_PWM_ActuateMotorAxis(uint8_t axis, int32_t control);
+
+/*
+ * Drive modes: how the two bridge inputs (CW/CCW PWM channels) carry the
+ * duty. The enable pins stay high while driving; a mode change drops them for
+ * one control tick so the bridge never sees a half-switched channel pair.
+ *
+ * Which of the sign-magnitude modes decays fast depends on the bridge: a
+ * bridge that brakes with both inputs equal (L298-style) is slow decay in
+ * both, one that coasts with both inputs low (DRV8871-style) is fast decay
+ * in SM_LOW and slow decay in SM_HIGH.
+ *
+ * Each mode has its own duty linearisation table (g_drive_lin, Watch):
+ * PERIPHERAL_LIN_POINTS breakpoints, evenly spaced over |control|, giving the
+ * duty in Q15 of full scale. Tables start as the identity; calibrate them per
+ * bridge so the controller sees a linear actuator.
+ *
+ * Breakpoint 0 is the dead-band jump: any non-zero control starts from that
+ * duty, so the bridge's minimum effective duty does not show up as a dead
+ * zone in the loop. g_drive_hyst (Q30, 0 = off) adds hysteresis around it:
+ * the output engages at |control| >= g_drive_hyst and drops to zero below
+ * half of it, so noise around zero does not toggle the jump.
+ *
+ * The duty sweep learns the table of one axis' current mode: write axis + 1
+ * to g_lin_sweep (Watch). Peripheral_PWM_SweepControl then replaces the
+ * controller output of the axis: it raises the duty in small steps until the
+ * motor turns (breakaway, g_lin_sweep_breakaway), holds each breakpoint duty
+ * until the speed settles (g_lin_sweep_rpm), and inverts that curve into the
+ * table. The duty goes through the drive, the stall detector and the thermal
+ * limit like any control; if one of them changes it (drive not fully
+ * enabled, stall trip, derating), the sweep ends as failed. Run it unloaded;
+ * it takes about seven seconds plus the breakaway search, in the CW direction
+ * only, and the table serves both directions.
+ */
+#define PERIPHERAL_DRIVE_SM_LOW 0U		//!< Sign-magnitude, off phase both inputs low (default).
+#define PERIPHERAL_DRIVE_SM_HIGH 1U		//!< Sign-magnitude, off phase both inputs high.
+#define PERIPHERAL_DRIVE_ANTIPHASE 2U	//!< Locked antiphase: complementary inputs, 50 % = stop.
+#define PERIPHERAL_DRIVE_MODES 3U
+#define PERIPHERAL_LIN_POINTS 17U		//!< Breakpoints per linearisation table.
+
+/* Duty sweep status (g_lin_sweep_status) */
+#define PERIPHERAL_SWEEP_IDLE 0U		//!< No sweep run yet.
+#define PERIPHERAL_SWEEP_RUNNING 1U		//!< Sweep in progress.
+#define PERIPHERAL_SWEEP_DONE 2U		//!< Table learned from the last sweep.
+#define PERIPHERAL_SWEEP_FAILED 3U		//!< Motor never turned, or the sweep was cancelled; table unchanged.
+
+/**
+ * @brief Control of one axis for this tick, with a duty sweep in progress.
+ *
+ * Call before the drive, the stall detector and Peripheral_PWM_ActuateMotorAxis,
+ * which apply the result as usual and give the sweep its raw duty.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @param control Controller output, Q30.
+ * @return The sweep duty as a Q30 control while g_lin_sweep selects the axis,
+ *         else control.
+ */
+int32_t Peripheral_PWM_SweepControl(uint8_t axis, int32_t control);
+
+/**
+ * @brief Select the drive mode of one axis.
+ *
+ * Takes effect at the next Peripheral_PWM_ActuateMotorAxis, which holds the
+ * bridge disabled for that tick. Same as writing g_drive_mode[axis] in Watch.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @param mode PERIPHERAL_DRIVE_*; out-of-range values are ignored.
+ */
+void Peripheral_PWM_SetDriveMode(uint8_t axis, uint8_t mode);
+
+/**
+ * @brief Drive mode an axis is currently switching with.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @return PERIPHERAL_DRIVE_*.
+ */
+uint8_t Peripheral_PWM_DriveMode(uint8_t axis);
+
+/**
+ * @brief Pick the PWM carrier for the load; once per control tick, after the axes.
+ *
+ * With g_pwm_adapt set (Watch), the carrier runs at half the nominal period
+ * while every axis is below g_pwm_fast_duty (less current ripple), and at
+ * twice the nominal period while an axis is above g_pwm_slow_duty and faster
+ * than g_pwm_slow_rpm (less switching loss); a new carrier must be wanted for
+ * g_pwm_dwell_ms first. All PWM timers share the carrier.
+ *
+ * The switch is made by Peripheral_Sync_OnUpdate, one factor of two per
+ * period: the preloaded ARR of every timer and every compare value are
+ * scaled together, so the Q30 duty of each channel is unchanged. Slaved
+ * timers keep their delay in clocks, so their phase in degrees scales too.
+ * The control tick and Peripheral_Sync_TimeUs count the actual untrimmed
+ * period lengths, so time keeping does not depend on the carrier.
+ */
+void Peripheral_PWM_AdaptFrequency(void);
+
+/**
+ * @brief Velocity estimate in RPM for one axis (same rules as above).
+ *
+ * Each axis keeps its own estimator history, so the axes can be processed
+ * back-to-back within one control tick.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @param millisec The time elapsed in milliseconds.
+ * @return The calculated motor velocity in RPM.
+ */
+int32_t Peripheral_Encoder_CalculateVelocityAxis(uint8_t axis, uint32_t millisec);
+
+/**
+ * @brief Latch the encoder count of every axis at the same instant.
+ *
+ * Peripheral_Encoder_CalculateVelocityAxis works on the latched counts, so
+ * all axes of one control tick see time-coherent positions.
+ */
+void Peripheral_Encoder_LatchAll(void);
+
+/**
+ * @brief Encoder count of one axis as latched for the current tick.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @return Raw 16-bit counter value.
+ */
+int16_t Peripheral_Encoder_Latched(uint8_t axis);
+
+/**
+ * @brief Override the latched count of one axis (replay of recorded ticks).
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @param count Raw 16-bit counter value.
+ */
+void Peripheral_Encoder_SetLatched(uint8_t axis, int16_t count);
+
+/**
+ * @brief Copy the velocity estimator state of all axes.
+ *
+ * @param dst Destination buffer.
+ * @param size Size of dst in bytes.
+ * @return Bytes written, 0 if dst is too small.
+ */
+uint32_t Peripheral_Encoder_SaveState(void *dst, uint32_t size);
+
+/**
+ * @brief Restore estimator state saved by Peripheral_Encoder_SaveState.
+ *
+ * @param src State blob.
+ * @param size Size of the blob; must match this build (same AXIS_COUNT).
+ * @return 1 on success, 0 on a size mismatch.
+ */
+uint8_t Peripheral_Encoder_RestoreState(const void *src, uint32_t size);
+
+/**
+ * @brief Slave all PWM timers to the TIM3 master and start the control tick.
+ *
+ * Slaved PWM timers are armed in trigger mode with their phase offset
+ * preloaded and started together by TIM3, so the axes keep a fixed phase
+ * relation. The TIM3 update interrupt is enabled; see Peripheral_Sync_OnUpdate.
+ *
+ * @param tick_ms Control tick period in milliseconds.
+ */
+void Peripheral_Sync_Init(uint32_t tick_ms);
+
+/**
+ * @brief Handle one TIM3 update event (call from TIM3_IRQHandler).
+ *
+ * Accumulates master periods and, once a control tick is due, latches all
+ * encoders at that common instant. The tick period is exact on average and
+ * jitters by at most one PWM period.
+ *
+ * @return 1 when a control tick is due, 0 otherwise.
+ */
+uint8_t Peripheral_Sync_OnUpdate(void);
+
+/**
+ * @brief Align the control tick to an external SYNC event.
+ *
+ * If the next tick is more than half a period away, it is pulled in to the
+ * next PWM update; otherwise the tick that just ran is taken as the aligned
+ * one and the next follows one full period after the SYNC. The request is
+ * applied by the next master update, so it may be made from any priority.
+ */
+void Peripheral_Sync_Align(void);
+
+/**
+ * @brief Number of times the tick phase was moved (align or step).
+ *
+ * Ticks around such a move are deliberately early or late.
+ */
+uint32_t Peripheral_Sync_Rephases(void);
+
+/**
+ * @brief Disciplined local time.
+ *
+ * Counts untrimmed PWM periods plus the master counter, so it follows the trim
+ * and steps applied by Peripheral_Sync_Step/Peripheral_Sync_Trim. Safe to call
+ * from any priority (briefly masks interrupts).
+ *
+ * @return Microseconds since Peripheral_Sync_Init, offset by any steps.
+ */
+uint64_t Peripheral_Sync_TimeUs(void);
+
+/**
+ * @brief Step the disciplined time by a large offset.
+ *
+ * The step is rounded to whole PWM periods so carriers of all nodes stay on
+ * one lattice; the remainder is slewed. The tick phase is re-derived from
+ * the new time. Call from the tick layer or below (briefly masks interrupts).
+ *
+ * @param step_us Offset to add in microseconds.
+ */
+void Peripheral_Sync_Step(int64_t step_us);
+
+/**
+ * @brief Trim the PWM period, and with it the control tick.
+ *
+ * Each master period is lengthened or shortened by a fraction of a count
+ * (dithered through the preloaded ARR of every PWM timer), and a phase error
+ * is slewed in over the following periods. Call from the tick layer or
+ * below (briefly masks interrupts).
+ *
+ * @param ppb Frequency correction; positive makes the local time run faster.
+ * @param phase_us Phase to slew in; positive advances the local time.
+ */
+void Peripheral_Sync_Trim(int32_t ppb, int32_t phase_us);
+
+/**
+ * @brief Start the DWT cycle counter used for timing measurements.
+ */
+void Peripheral_Cycles_Init(void);
+
+#ifndef PERIPHERALS_ESTIMATOR_ONLY
+/**
+ * @brief Current value of the free-running CPU cycle counter.
+ *
+ * @return Core clock cycles since Peripheral_Cycles_Init (wraps at 2^32).
+ */
+static inline uint32_t Peripheral_Cycles_Now(void) {
+    return DWT->CYCCNT;
+}
+#endif
+
 #ifdef __cplusplus
 }
 #endif
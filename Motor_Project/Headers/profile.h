@@ -0,0 +1,168 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "axis.h"
+#include <stdint.h>
+
+/*
+ * Reference profiles and reference arbitration.
+ *
+ * A profile is a script of 8-byte instructions run by a small interpreter
+ * once per control tick:
+ *   STEP rpm             jump to rpm
+ *   RAMP rpm ms          straight line to rpm over ms
+ *   SINE rpm ms n        n periods of ms, amplitude rpm, around the reference
+ *                        it starts from (and ends on)
+ *   DWELL ms             hold
+ *   LOOP count ... NEXT  repeat count times (0 = forever), nested up to
+ *                        PROFILE_LOOP_DEPTH deep
+ *   END                  stop, holding the reference
+ * Timed instructions chain at exact times: each starts when the previous one
+ * was due, not at the tick that noticed, so a profile does not drift with
+ * the tick period or a late tick. A tick runs at most PROFILE_STEPS_MAX
+ * instructions; a script that would need more (a loop without a timed
+ * instruction) just carries on at the next tick, so the time per tick stays
+ * bounded whatever was uploaded.
+ *
+ * Scripts live in flash (the built-in table, script 0 is the classic
+ * +-2000 RPM flip every PERIOD_REF) or in RAM: the debugger writes a
+ * compiled image (Tools/host/profile_compile.c) to g_profile_upload and sets
+ * g_profile.cmd to PROFILE_CMD_UPLOAD. Commands are taken at the next tick;
+ * an upload is checked (magic, size, hash, opcodes, loop nesting, a final
+ * END) and copied before it runs, so the upload buffer is free again at
+ * once and a bad image leaves the running script alone.
+ *
+ * Arbitration picks the reference of each axis from, in order: the bus
+ * (a live RxPDO reference), then the script. The safety limits then apply
+ * to whatever won: a clamp to +-max_rpm and, when slew_rpm_s is non-zero, a
+ * rate limit.
+ */
+
+#define PROFILE_MAGIC 0x31465250U		//!< "PRF1", start of an uploaded image.
+#define PROFILE_INSNS_MAX 64U			//!< Instructions in a RAM script.
+#define PROFILE_LOOP_DEPTH 4U			//!< Nested LOOPs.
+#define PROFILE_STEPS_MAX 16U			//!< Instructions run per tick at most.
+
+/* Opcodes */
+#define PROFILE_END 0U
+#define PROFILE_STEP 1U
+#define PROFILE_RAMP 2U
+#define PROFILE_SINE 3U
+#define PROFILE_DWELL 4U
+#define PROFILE_LOOP 5U
+#define PROFILE_NEXT 6U
+
+/* Commands (g_profile.cmd) */
+#define PROFILE_CMD_NONE 0U				//!< Nothing pending.
+#define PROFILE_CMD_UPLOAD 1U			//!< Check and run g_profile_upload.
+#define PROFILE_CMD_FLASH 2U			//!< Run built-in script g_profile.arg.
+#define PROFILE_CMD_STOP 3U				//!< Stop and hold zero.
+
+/* Load results (g_profile.status) */
+#define PROFILE_OK 0U
+#define PROFILE_ERR_MAGIC 1U			//!< Not an image, or wrong format.
+#define PROFILE_ERR_SIZE 2U				//!< No instructions, or more than PROFILE_INSNS_MAX.
+#define PROFILE_ERR_HASH 3U				//!< Hash does not match: partial or corrupt upload.
+#define PROFILE_ERR_OPCODE 4U			//!< Unknown opcode, or a SINE/RAMP without time.
+#define PROFILE_ERR_LOOP 5U				//!< NEXT without LOOP, unclosed or too deep.
+#define PROFILE_ERR_END 6U				//!< Last instruction is not END.
+#define PROFILE_ERR_INDEX 7U			//!< No built-in script with that number.
+
+#define PROFILE_RUN_RAM 0xFFU			//!< g_profile.script of the uploaded script.
+
+/* Reference sources (g_profile.source) */
+#define PROFILE_SRC_SCRIPT 0U			//!< Profile script.
+#define PROFILE_SRC_REMOTE 1U			//!< Bus command.
+
+/**
+ * @brief One instruction.
+ */
+typedef struct {
+    uint8_t op;				//!< PROFILE_* opcode.
+    uint8_t n;				//!< SINE: periods.
+    int16_t rpm;			//!< STEP, RAMP: target; SINE: amplitude.
+    uint32_t arg;			//!< RAMP, SINE, DWELL: ms (SINE: per period); LOOP: count.
+} Profile_Insn_t;
+
+/**
+ * @brief Uploaded image: header, then count instructions.
+ */
+typedef struct {
+    uint32_t magic;			//!< PROFILE_MAGIC.
+    uint16_t count;			//!< Instructions used.
+    uint16_t reserved;		//!< 0.
+    uint32_t hash;			//!< FNV-1a over the count instructions.
+    Profile_Insn_t insn[PROFILE_INSNS_MAX];
+} Profile_Image_t;
+
+/**
+ * @brief Interpreter, arbitration and limits (Watch).
+ */
+typedef struct {
+    volatile uint8_t cmd;					//!< PROFILE_CMD_*; cleared once taken.
+    volatile uint8_t arg;					//!< Built-in script for PROFILE_CMD_FLASH.
+    volatile uint8_t status;				//!< Result of the last load, PROFILE_OK or PROFILE_ERR_*.
+    volatile uint8_t script;				//!< Script running: built-in number or PROFILE_RUN_RAM.
+    volatile uint8_t running;				//!< 0 once END is reached or the script stopped.
+    volatile uint8_t pc;					//!< Instruction in progress.
+    volatile uint8_t steps_max;				//!< Most instructions run in one tick.
+    volatile int32_t reference;				//!< Script reference, RPM.
+    volatile int32_t max_rpm;				//!< Safety clamp of every reference.
+    volatile int32_t slew_rpm_s;			//!< Safety rate limit, RPM/s; 0 = off.
+    volatile uint8_t source[AXIS_COUNT];	//!< PROFILE_SRC_* that won, per axis.
+    volatile uint32_t limited[AXIS_COUNT];	//!< Ticks a safety limit changed the reference.
+} Profile_t;
+
+extern Profile_t g_profile;
+extern Profile_Image_t g_profile_upload;
+
+/**
+ * @brief Start built-in script 0 at time millisec; call once at setup.
+ *
+ * @param millisec Time the script starts at (the tick time base).
+ */
+void Profile_Init(uint32_t millisec);
+
+/**
+ * @brief Check an image and run it from a RAM copy.
+ *
+ * @param image Compiled image.
+ * @param millisec Time the script starts at.
+ * @return PROFILE_OK, or the PROFILE_ERR_* that rejected it (the running script carries on).
+ */
+uint8_t Profile_Load(const Profile_Image_t *image, uint32_t millisec);
+
+/**
+ * @brief Take a pending command and advance the script to millisec; once per tick.
+ *
+ * @param millisec Control tick time in milliseconds.
+ */
+void Profile_Tick(uint32_t millisec);
+
+/**
+ * @brief Reference in effect for one axis; every tick, after Profile_Tick.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @param remote Bus reference, or NULL when the bus does not command the axis.
+ * @param millisec Control tick time in milliseconds.
+ * @return Reference in RPM, within the safety limits.
+ */
+int32_t Profile_Arbitrate(uint8_t axis, const int32_t *remote, uint32_t millisec);
+
+/**
+ * @brief FNV-1a hash of count instructions, as stored in an image.
+ *
+ * @param insn Instructions.
+ * @param count Number of instructions.
+ * @return Hash.
+ */
+uint32_t Profile_Hash(const Profile_Insn_t *insn, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // _PROFILE_H_
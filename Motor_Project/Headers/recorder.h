@@ -0,0 +1,140 @@
+#ifndef _RECORDER_H_
+#define _RECORDER_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "axis.h"
+
+#ifndef RECORDER_ENABLE
+#define RECORDER_ENABLE 1				//!< 0 compiles Recorder_Tick away.
+#endif
+
+#ifndef RECORDER_BYTES
+#define RECORDER_BYTES 8192U			//!< Stream buffer; about 3 bytes per axis and tick.
+#endif
+
+#define RECORDER_MAGIC 0x31434552U		//!< "REC1", lets the host replay find and check a dump.
+#define RECORDER_CHECK_TICKS 16U		//!< A control output checksum is stored this often.
+
+/* Stream records: type in the high nibble of the first byte, flags in the low one */
+#define RECORDER_KEYFRAME 0x10U			//!< Absolute inputs, tunables and estimator/controller state.
+#define RECORDER_TICK 0x20U				//!< One tick: count deltas, plus whatever the flags add.
+#define RECORDER_TICK_APPLIED 0x30U		//!< A tick whose applied output differs from the controller output: also the applied outputs.
+#define RECORDER_F_MS 0x01U				//!< Tick period differs from PERIOD_CTRL.
+#define RECORDER_F_REF 0x02U			//!< Reference deltas follow.
+#define RECORDER_F_PARAM 0x04U			//!< Tunables changed; they apply from the next tick.
+#define RECORDER_F_CHECK 0x08U			//!< Checksum of the control outputs so far follows.
+
+#define RECORDER_PARAMS 20U				//!< Tunables tracked (Kp, Ki, U_PER_RPM, ..., g_vel_window_ms, REV_*, THERM_*, MANUAL_*).
+
+/* Recorder state */
+#define RECORDER_IDLE 0U				//!< Not recording.
+#define RECORDER_RUNNING 1U				//!< Appending one record per tick.
+#define RECORDER_FULL 2U				//!< Buffer full, recording stopped.
+
+/**
+ * @brief Recording as laid out in RAM (dumped as-is for the host replay).
+ */
+typedef struct {
+    uint32_t magic;					//!< RECORDER_MAGIC.
+    uint32_t axis_count;			//!< AXIS_COUNT of the recording build.
+    uint32_t period_ms;				//!< Nominal tick period (PERIOD_CTRL).
+    uint32_t capacity;				//!< Size of data (RECORDER_BYTES).
+    volatile uint32_t used;			//!< Bytes of data filled.
+    volatile uint32_t ticks;		//!< Ticks recorded after the keyframe.
+    volatile uint32_t state;		//!< RECORDER_IDLE/RUNNING/FULL.
+    uint8_t data[RECORDER_BYTES];	//!< Keyframe, then one record per tick.
+} Recorder_Buffer_t;
+
+/**
+ * @brief Inputs of one recorded tick, as returned by the replay reader.
+ */
+typedef struct {
+    uint32_t millisec;					//!< Control tick time in milliseconds.
+    int16_t counts[AXIS_COUNT];			//!< Latched encoder counts.
+    int32_t reference[AXIS_COUNT];		//!< Reference in effect, RPM.
+    uint8_t has_applied;				//!< applied is valid; else the controller output was applied.
+    int32_t applied[AXIS_COUNT];		//!< Output that reached the bridge, Q30 (Controller_SetApplied).
+    uint8_t has_check;					//!< check is valid after this tick.
+    uint32_t check;						//!< Recorder_Hash over all outputs up to this tick.
+} Recorder_Tick_t;
+
+/**
+ * @brief Replay cursor over a recorded stream.
+ */
+typedef struct {
+    const uint8_t *p;					//!< Next record.
+    const uint8_t *end;					//!< End of the stream.
+    Recorder_Tick_t last;				//!< Previous tick, base of the deltas.
+    uint32_t period_ms;					//!< Nominal tick period.
+    int32_t params[RECORDER_PARAMS];	//!< Tunables to apply before the next tick.
+    uint8_t params_pending;
+} Recorder_Reader_t;
+
+extern Recorder_Buffer_t g_recorder;
+
+/**
+ * @brief Initialise the recording buffer and arm the first recording.
+ *
+ * @param period_ms Nominal control tick period.
+ */
+void Recorder_Init(uint32_t period_ms);
+
+/**
+ * @brief Start a new recording at the end of the next tick (any context).
+ *
+ * Any previous recording is discarded. Setting g_recorder_arm from Watch
+ * does the same.
+ */
+void Recorder_Arm(void);
+
+/**
+ * @brief Append the raw inputs of one control tick; call at its end.
+ *
+ * @param millisec Control tick time in milliseconds.
+ * @param counts Latched encoder count of every axis.
+ * @param reference Reference in effect for every axis, RPM.
+ * @param control Controller output of every axis, Q30 (checksummed only).
+ * @param applied Output that reached the bridge on every axis, Q30; stored
+ *        only on ticks where it differs from control.
+ */
+void Recorder_Tick(uint32_t millisec, const int16_t *counts, const int32_t *reference,
+                   const int32_t *control, const int32_t *applied);
+
+/**
+ * @brief Fold the control outputs of one tick into a running checksum.
+ *
+ * @param hash Checksum so far (start with 0).
+ * @param control Controller output of every axis.
+ * @return Updated checksum.
+ */
+uint32_t Recorder_Hash(uint32_t hash, const int32_t *control);
+
+/**
+ * @brief Open a recorded stream and restore the state it starts from.
+ *
+ * Restores the estimator and controller state and the tunables of the
+ * keyframe, so the following ticks replay exactly.
+ *
+ * @param reader Cursor to initialise.
+ * @param buffer Recording (g_recorder of the recording build).
+ * @return 1 on success, 0 if the stream is empty or does not match this build.
+ */
+uint8_t Recorder_ReaderInit(Recorder_Reader_t *reader, const Recorder_Buffer_t *buffer);
+
+/**
+ * @brief Decode the next tick, applying tunable changes from the previous one.
+ *
+ * @param reader Cursor.
+ * @param tick Receives the inputs of the tick.
+ * @return 1 if a tick was returned, 0 at the end, -1 on a corrupt stream.
+ */
+int8_t Recorder_ReaderNext(Recorder_Reader_t *reader, Recorder_Tick_t *tick);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // _RECORDER_H_
@@ -0,0 +1,107 @@
+#ifndef _STALL_H_
+#define _STALL_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "axis.h"
+#include <stdint.h>
+
+/*
+ * Stall and blocked-rotor detection, per axis, between the controller and
+ * the PWM stage. It checks the control after the drive ramp, i.e. what is
+ * actually applied.
+ *
+ * A tick is suspect when the drive pushes current (control minus back-EMF,
+ * the current estimate of controller.h) of at least effort in the direction
+ * of the control, the shaft turns slower than rpm, and it does not
+ * accelerate in that direction by at least accel. A free shaft under that
+ * much current speeds up within a tick or two, so only a blocked one stays
+ * suspect. Suspect time adds up tick by tick, twice as fast while the control
+ * is at its limit, and any plausible tick clears it; at trip_ms the axis
+ * trips.
+ *
+ * At a low reference the drive only pushes friction and the back-EMF of that
+ * speed, which may stay below effort even with the shaft blocked, and the
+ * trip would wait for the integrator to wind up. The current needed there is
+ * the mean of effort and the feedforward of the reference (U_PER_RPM times
+ * it): a blocked shaft gets the whole feedforward as current, a free one
+ * breaks away below effort / 2. So the trip comes trip_ms after the speed
+ * estimate has fallen below rpm, at any reference.
+ *
+ * A tripped axis goes to the safe state: output zero and a stall fault on
+ * the drive state machine (drive.h), which switches the bridge off at once
+ * (the motor coasts). After retry_ms the fault is cleared and the drive
+ * soft-starts the axis again, with the wait doubling on every retry; after
+ * retries retries in a row it locks out until Stall_Clear. healthy_ms of
+ * running without a suspect tick restores the retries. Trips, retries and
+ * lockouts are logged.
+ *
+ * The controller is not reset: the recorder keeps its output as computed,
+ * so replays stay exact; its anti-windup bounds the integrator meanwhile.
+ * Tools/host/stall_sim.c checks the detector against injected stalls.
+ */
+
+/* Axis states */
+#define STALL_RUNNING 0U				//!< Driving normally.
+#define STALL_SAFE 1U					//!< Tripped: bridge off, waiting to retry.
+#define STALL_LOCKED 2U					//!< Out of retries: bridge off until Stall_Clear.
+
+/**
+ * @brief Detector and retry settings (Watch), shared by all axes.
+ */
+typedef struct {
+    volatile uint32_t trip_ms;		//!< Suspect time that trips (half of it with the control at its limit).
+    volatile int32_t rpm;			//!< Speed below which the shaft counts as stopped.
+    volatile int32_t effort;		//!< Estimated current, Q30 of stall current, that must move a free shaft.
+    volatile int32_t accel;			//!< Speed rise in RPM/s that shows the shaft is free.
+    volatile uint32_t retry_ms;		//!< Safe-state time before the first retry; doubles per retry.
+    volatile uint8_t retries;		//!< Retries in a row before the axis locks out.
+    volatile uint32_t healthy_ms;	//!< Running this long without a suspect tick restores the retries.
+} Stall_Config_t;
+
+/**
+ * @brief Detector state of one axis (Watch).
+ */
+typedef struct {
+    volatile uint8_t state;			//!< STALL_RUNNING, STALL_SAFE or STALL_LOCKED.
+    volatile uint8_t attempt;		//!< Retries used since the last healthy run.
+    volatile uint32_t suspect_ms;	//!< Suspect time so far.
+    volatile uint32_t trips;		//!< Trips since Stall_Init.
+    volatile uint32_t last_trip_ms;	//!< Tick time of the last trip.
+} Stall_Axis_t;
+
+extern Stall_Config_t g_stall_cfg;
+extern Stall_Axis_t g_stall[AXIS_COUNT];
+
+/**
+ * @brief Reset every axis to running; call once the bridges are enabled.
+ */
+void Stall_Init(void);
+
+/**
+ * @brief Check one axis for a stall and return the control to apply; every tick.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ * @param reference Reference in effect, RPM.
+ * @param velocity Measured velocity, RPM.
+ * @param control Controller output, Q30.
+ * @param millisec Tick time in milliseconds.
+ * @return control while running, 0 in the safe and locked states.
+ */
+int32_t Stall_Check(uint8_t axis, int32_t reference, int32_t velocity, int32_t control, uint32_t millisec);
+
+/**
+ * @brief Leave the safe or locked state and drive again with a fresh set of retries.
+ *
+ * Call from the tick layer, like Stall_Check.
+ *
+ * @param axis Axis index [0, AXIS_COUNT).
+ */
+void Stall_Clear(uint8_t axis);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // _STALL_H_
@@ -0,0 +1,165 @@
+#ifndef _TIMDRV_H_
+#define _TIMDRV_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef STM32F103xB
+#include "stm32f1xx.h"
+#endif
+#ifdef STM32L476xx
+#include "stm32l4xx.h"
+#endif
+
+#include <stdint.h>
+
+/*
+ * Register-level driver for the encoder, PWM and tick timers.
+ *
+ * Channels are given as the HAL TIM_CHANNEL_1..4 values (0, 4, 8, 12), so the
+ * axis descriptors keep working unchanged.
+ *
+ * TIMDRV_HAL=1 builds the old HAL path instead (HAL_TIM_Encoder_Init,
+ * HAL_TIM_PWM_ConfigChannel, HAL_TIM_*_Start, and the TIM3 interrupt through
+ * HAL_TIM_IRQHandler) so both can be measured on the same board:
+ *  - init time: g_timdrv.init_cycles, CPU cycles spent in the timer init
+ *  - ISR latency: g_timdrv.isr_min/isr_max, TIM3 counts (= CPU cycles at
+ *    40 MHz, APB1 undivided) from the update event to the tick handler
+ *  - code size: "Image component sizes" in the linker map; compare
+ *    stm32l4xx_hal_tim.o + main.o + timdrv.o between the two builds
+ * The HAL interrupt path clears UIF before the callback, outside the
+ * Irq_Lock (BASEPRI) section of Peripheral_Sync_OnUpdate, so it is for
+ * measuring only.
+ */
+#ifndef TIMDRV_HAL
+#define TIMDRV_HAL 0					//!< 1 initialises and dispatches through HAL_TIM (for comparison).
+#endif
+
+#define TIMDRV_ENCODER_TOP 65535U		//!< Encoder counters wrap at 16 bits.
+
+/**
+ * @brief Timer driver measurements (Watch).
+ */
+typedef struct {
+    uint32_t init_cycles;			//!< CPU cycles spent in timer initialisation.
+    volatile uint32_t isr_last;		//!< Update-to-handler latency of the last tick interrupt, timer counts.
+    volatile uint32_t isr_min;		//!< Smallest latency seen (no preemption, no tail-chain).
+    volatile uint32_t isr_max;		//!< Largest latency seen.
+    volatile uint32_t isr_count;	//!< Tick timer interrupts measured.
+} TimDrv_Stats_t;
+
+extern TimDrv_Stats_t g_timdrv;
+
+/* ----------------- Inline accessors ----------------- */
+
+/**
+ * @brief Compare register of a channel.
+ */
+static inline volatile uint32_t *TimDrv_CCR(TIM_TypeDef *tim, uint32_t channel) {
+    return &tim->CCR1 + (channel >> 2U);
+}
+
+/**
+ * @brief Select the output compare mode of a channel (CCMR OCxM bits).
+ */
+static inline void TimDrv_SetOCMode(TIM_TypeDef *tim, uint32_t channel, uint32_t mode) {
+    volatile uint32_t *ccmr = (channel < 8U) ? &tim->CCMR1 : &tim->CCMR2;
+    const uint32_t shift = ((channel & 4U) != 0U) ? 8U : 0U;
+    *ccmr = (*ccmr & ~((uint32_t)TIM_CCMR1_OC1M << shift)) | (mode << shift);
+}
+
+/**
+ * @brief Current counter value.
+ */
+static inline uint32_t TimDrv_Count(const TIM_TypeDef *tim) {
+    return tim->CNT;
+}
+
+/**
+ * @brief Counter period in timer counts (ARR + 1).
+ */
+static inline uint32_t TimDrv_Top(const TIM_TypeDef *tim) {
+    return tim->ARR + 1U;
+}
+
+/**
+ * @brief Set the compare value of a channel.
+ */
+static inline void TimDrv_SetCompare(TIM_TypeDef *tim, uint32_t channel, uint32_t value) {
+    *TimDrv_CCR(tim, channel) = value;
+}
+
+/**
+ * @brief Record the update-to-handler latency; first thing in the tick handler.
+ *
+ * The tick timer counts up from 0 at its update event, so its counter on
+ * handler entry is the time the interrupt took to get there.
+ *
+ * @return The latency, in timer counts.
+ */
+static inline uint32_t TimDrv_IsrEntry(const TIM_TypeDef *tim) {
+    const uint32_t latency = tim->CNT;
+    g_timdrv.isr_last = latency;
+    if (latency < g_timdrv.isr_min)
+        g_timdrv.isr_min = latency;
+    if (latency > g_timdrv.isr_max)
+        g_timdrv.isr_max = latency;
+    g_timdrv.isr_count++;
+    return latency;
+}
+
+/* ----------------- Init ----------------- */
+
+/**
+ * @brief Quadrature encoder counter: TI1 and TI2, rising, no filter, 16-bit wrap.
+ *
+ * Clock and pins must already be enabled. Starts the counter.
+ *
+ * @param tim Timer to configure.
+ */
+void TimDrv_EncoderInit(TIM_TypeDef *tim);
+
+/**
+ * @brief Up-counting PWM time base, stopped, no ARR preload.
+ *
+ * Clock must already be enabled.
+ *
+ * @param tim Timer to configure.
+ * @param top Period in timer counts (ARR + 1).
+ */
+void TimDrv_PWMInit(TIM_TypeDef *tim, uint32_t top);
+
+/**
+ * @brief PWM mode 1 output on one channel, duty 0, preloaded compare; enabled.
+ *
+ * @param tim Timer configured by TimDrv_PWMInit.
+ * @param channel HAL TIM_CHANNEL_1..4 value.
+ */
+void TimDrv_PWMChannel(TIM_TypeDef *tim, uint32_t channel);
+
+/**
+ * @brief Enable the main output (break timers) and start the counter.
+ *
+ * @param tim Timer to start.
+ */
+void TimDrv_Start(TIM_TypeDef *tim);
+
+/**
+ * @brief Start an init time measurement (enables the cycle counter if needed).
+ *
+ * @return Cycle counter value to pass to TimDrv_MeasureEnd.
+ */
+uint32_t TimDrv_MeasureBegin(void);
+
+/**
+ * @brief Add the cycles since TimDrv_MeasureBegin to g_timdrv.init_cycles.
+ *
+ * @param start Value returned by TimDrv_MeasureBegin.
+ */
+void TimDrv_MeasureEnd(uint32_t start);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // _TIMDRV_H_
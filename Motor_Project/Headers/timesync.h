@@ -0,0 +1,119 @@
+#ifndef _TIMESYNC_H_
+#define _TIMESYNC_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#ifndef TIMESYNC_MASTER
+#define TIMESYNC_MASTER 0				//!< 1 if this drive is the time master (sends SYNC and TIME).
+#endif
+
+#define TIMESYNC_PERIOD_TICKS 10		//!< Control ticks between two SYNCs sent by the time master.
+#define TIMESYNC_STEP_US 1000			//!< Offsets beyond this are stepped instead of slewed.
+#define TIMESYNC_OUTLIER_US 50			//!< While tracking, larger offsets are treated as late timestamps.
+#define TIMESYNC_REJECT_MAX 3			//!< Consecutive outliers dropped before they are believed.
+#define TIMESYNC_KI_SHIFT 2				//!< Drift integrator gain 2^-n per sample.
+#define TIMESYNC_PPB_MAX 50000000		//!< Frequency correction limit (5%, covers the MSI tolerance).
+#define TIMESYNC_TIME_BITS 48			//!< Width of the master time in the TIME frame.
+
+/**
+ * @brief Servo state.
+ */
+typedef enum {
+    TIMESYNC_UNLOCKED = 0,	//!< No sample yet; the next one steps the clock.
+    TIMESYNC_ACQUIRING,		//!< Stepped; the next sample gives the first drift estimate.
+    TIMESYNC_TRACKING,		//!< Drift and phase are slewed continuously.
+} TimeSync_State_t;
+
+/**
+ * @brief Clock servo for one node.
+ *
+ * Kept as a plain struct so a host simulation can run several nodes.
+ */
+typedef struct {
+    int32_t drift_ppb;			//!< Estimated frequency error of the local clock.
+    uint64_t last_local_us;		//!< Local time of the previous sample, after correction.
+    TimeSync_State_t state;
+    uint8_t rejected;			//!< Consecutive rejected samples.
+} TimeSync_Servo_t;
+
+/**
+ * @brief Correction to apply to the local clock after a sample.
+ *
+ * Either step_us is non-zero (apply with Peripheral_Sync_Step) or ppb and
+ * phase_us hold the new trim (apply with Peripheral_Sync_Trim).
+ */
+typedef struct {
+    int64_t step_us;	//!< Offset to step by, 0 if none.
+    int32_t ppb;		//!< Frequency correction, positive runs the local clock faster.
+    int32_t phase_us;	//!< Phase to slew in, positive advances the local clock.
+} TimeSync_Correction_t;
+
+/**
+ * @brief Reset a servo to the unlocked state.
+ *
+ * @param servo Servo to reset.
+ */
+void TimeSync_ServoReset(TimeSync_Servo_t *servo);
+
+/**
+ * @brief Feed one (master, local) timestamp pair for the same SYNC.
+ *
+ * The first sample, and any persistent offset beyond TIMESYNC_STEP_US, steps
+ * the clock. After that each sample turns the remaining offset into a rate
+ * error over the sample interval, integrates it into the drift estimate and
+ * slews the offset out as phase. Times are compared modulo
+ * 2^TIMESYNC_TIME_BITS.
+ *
+ * @param servo Servo state.
+ * @param master_us Master time at the SYNC.
+ * @param local_us Local disciplined time at the same SYNC.
+ * @param out Receives the correction to apply.
+ * @return 1 if the sample was used, 0 if it was rejected.
+ */
+uint8_t TimeSync_ServoSample(TimeSync_Servo_t *servo, uint64_t master_us, uint64_t local_us,
+                             TimeSync_Correction_t *out);
+
+#ifndef TIMESYNC_SERVO_ONLY
+
+/**
+ * @brief Initialise the node servo; call after CanBus_Init and Peripheral_Sync_Init.
+ */
+void TimeSync_Init(void);
+
+/**
+ * @brief Once per control tick, after CanBus_Poll.
+ *
+ * Feeds a received TIME follow-up to the servo and applies the correction.
+ * On the time master, sends a SYNC every TIMESYNC_PERIOD_TICKS ticks and its
+ * TIME follow-up on the first tick after it went out.
+ */
+void TimeSync_Tick(void);
+
+/**
+ * @brief A SYNC was received (transport RX interrupt).
+ *
+ * @param counter SYNC counter byte.
+ * @param local_us Disciplined local time at reception.
+ * @return 1 if the servo owns the tick phase, 0 if the caller should fall
+ * back to Peripheral_Sync_Align.
+ */
+uint8_t TimeSync_OnSyncRx(uint8_t counter, uint64_t local_us);
+
+/**
+ * @brief Our SYNC left the controller (transport TX interrupt, time master).
+ *
+ * @param counter SYNC counter byte.
+ * @param local_us Disciplined local time at transmission.
+ */
+void TimeSync_OnSyncTx(uint8_t counter, uint64_t local_us);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // _TIMESYNC_H_
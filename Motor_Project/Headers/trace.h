@@ -0,0 +1,105 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef STM32F103xB
+#include "stm32f1xx.h"
+#endif
+#ifdef STM32L476xx
+#include "stm32l4xx.h"
+#endif
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE 1					//!< 0 compiles every Trace_Event away.
+#endif
+
+#ifndef TRACE_EVENTRECORDER
+#define TRACE_EVENTRECORDER 0			//!< 1 also forwards events to the Keil Event Recorder (slow).
+#endif
+
+#define TRACE_N 256U					//!< Records in the RAM ring, a power of two.
+#define TRACE_MAGIC 0x31435254U			//!< "TRC1", lets the host decoder find and check a dump.
+#define TRACE_EVR_COMPONENT 0x0AU		//!< Event Recorder component number (see EventRecorderStub.scvd).
+
+#define TRACE_NO_AXIS 0xFFFFU			//!< Axis field of events that are not axis-specific.
+
+/* Event ids */
+#define TRACE_TICK_START 1U		//!< Control tick entered, payload = millisec.
+#define TRACE_EST_DONE 2U		//!< Velocity estimate ready, payload = RPM.
+#define TRACE_CTRL_DONE 3U		//!< Controller output ready, payload = control (Q30).
+#define TRACE_PWM_APPLIED 4U	//!< Compare registers written, payload = control (Q30).
+#define TRACE_SATURATION 5U		//!< Controller output clamped, payload = amount clipped (Q30, int32-saturated).
+#define TRACE_REVERSAL 6U		//!< Reference changed sign, payload = new reference (RPM).
+#define TRACE_TICK_END 7U		//!< Control tick finished, payload = tick sequence number.
+#define TRACE_REVERSAL_DONE 8U	//!< Reversal manager handed back to PI, payload = time it took (ms).
+
+/**
+ * @brief One trace record, 12 bytes.
+ */
+typedef struct {
+    uint32_t cycles;	//!< DWT cycle counter when the event was recorded.
+    uint16_t id;		//!< TRACE_* event id.
+    uint16_t axis;		//!< Axis index, 0xFFFF if not axis-specific.
+    uint32_t payload;	//!< Event-specific value.
+} Trace_Record_t;
+
+/**
+ * @brief Trace ring as laid out in RAM (dumped as-is for the host decoder).
+ */
+typedef struct {
+    uint32_t magic;					//!< TRACE_MAGIC.
+    uint32_t count;					//!< Ring size (TRACE_N).
+    uint32_t cpu_hz;				//!< Cycle counter frequency.
+    _Atomic uint32_t index;			//!< Records written so far; next slot is index % TRACE_N.
+    Trace_Record_t ring[TRACE_N];
+} Trace_Buffer_t;
+
+extern Trace_Buffer_t g_trace;
+
+/**
+ * @brief Initialise the trace ring; the cycle counter must be running.
+ */
+void Trace_Init(void);
+
+#if TRACE_EVENTRECORDER
+void Trace_Forward(uint16_t id, uint16_t axis, uint32_t payload);
+#endif
+
+/**
+ * @brief Record one event.
+ *
+ * The slot is claimed with an atomic increment, so events may come from any
+ * priority; the ring overwrites the oldest record. Costs a handful of cycles.
+ *
+ * @param id TRACE_* event id.
+ * @param axis Axis index, 0xFFFF if not axis-specific.
+ * @param payload Event-specific value.
+ */
+static inline void Trace_Event(uint16_t id, uint16_t axis, uint32_t payload) {
+#if TRACE_ENABLE
+    const uint32_t i = atomic_fetch_add_explicit(&g_trace.index, 1U, memory_order_relaxed);
+    Trace_Record_t *r = &g_trace.ring[i & (TRACE_N - 1U)];
+    r->cycles = DWT->CYCCNT;
+    r->id = id;
+    r->axis = axis;
+    r->payload = payload;
+#if TRACE_EVENTRECORDER
+    Trace_Forward(id, axis, payload);
+#endif
+#else
+    (void)id;
+    (void)axis;
+    (void)payload;
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // _TRACE_H_
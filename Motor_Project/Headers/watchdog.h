@@ -0,0 +1,120 @@
+#ifndef _WATCHDOG_H_
+#define _WATCHDOG_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef STM32F103xB
+#include "stm32f1xx.h"
+#endif
+#ifdef STM32L476xx
+#include "stm32l4xx.h"
+#endif
+
+#include <stdint.h>
+
+/*
+ * Deadline supervisor on two hardware watchdogs.
+ *
+ *  - WWDG, refreshed by every control tick. Its window resets the MCU when a
+ *    tick comes earlier than WATCHDOG_EARLY_PCT or later than WATCHDOG_LATE_PCT
+ *    of the tick period after the previous one. When the tick phase is moved
+ *    on purpose (SYNC align, time step) the fast layer keeps it alive at the
+ *    last moment until a tick lands inside the window again.
+ *  - IWDG (LSI, keeps running if the main clock fails), refreshed by the
+ *    background layer only while every task meets its deadline: each tick
+ *    finishes within WATCHDOG_DEADLINE_PCT of its period after being pended,
+ *    no tick is lost, and the thread-mode loop still runs.
+ *
+ * A missed deadline, a fault or Error_Handler disables the motors at once
+ * and stops feeding, so the reset follows. Both watchdogs stop while the
+ * core is halted by the debugger.
+ */
+
+#ifndef WATCHDOG_ENABLE
+#define WATCHDOG_ENABLE 1				//!< 0 only records the reset cause and checks deadlines.
+#endif
+
+#define WATCHDOG_IWDG_MS 50U			//!< IWDG timeout (LSI, roughly +-10 %).
+#define WATCHDOG_EARLY_PCT 50U			//!< A tick sooner than this after the last one is early.
+#define WATCHDOG_LATE_PCT 150U			//!< A tick later than this after the last one is late.
+#define WATCHDOG_DEADLINE_PCT 50U		//!< Tick must finish this far into its period after being pended.
+#define WATCHDOG_LOOP_TICKS 10U			//!< Thread-mode loop must run at least once every this many ticks.
+#define WATCHDOG_MARGIN 2U				//!< WWDG counts before timeout at which the fast layer keeps it alive.
+
+/* Reset cause, RCC_CSR bits 31..24 */
+#define WATCHDOG_RESET_FIREWALL 0x01U
+#define WATCHDOG_RESET_OPTIONS 0x02U
+#define WATCHDOG_RESET_PIN 0x04U
+#define WATCHDOG_RESET_BOR 0x08U
+#define WATCHDOG_RESET_SOFTWARE 0x10U
+#define WATCHDOG_RESET_IWDG 0x20U
+#define WATCHDOG_RESET_WWDG 0x40U
+#define WATCHDOG_RESET_LOWPOWER 0x80U
+
+/* Why the supervisor stopped feeding */
+#define WATCHDOG_FAULT_DEADLINE 0x01U	//!< A tick finished too late after being pended.
+#define WATCHDOG_FAULT_OVERRUN 0x02U	//!< A tick was due while the previous one was still pending.
+#define WATCHDOG_FAULT_LOOP 0x04U		//!< Thread-mode loop stalled.
+#define WATCHDOG_FAULT_HARDFAULT 0x08U	//!< Fault handler entered.
+#define WATCHDOG_FAULT_ERROR 0x10U		//!< Error_Handler called.
+
+/**
+ * @brief Supervisor state (Watch).
+ */
+typedef struct {
+    uint8_t reset_cause;			//!< WATCHDOG_RESET_* flags of the last reset.
+    volatile uint8_t fault;			//!< WATCHDOG_FAULT_* flags; non-zero stops the feeding.
+    volatile uint8_t grace;			//!< Tick phase moved, the fast layer keeps the WWDG alive.
+    volatile uint32_t loop_count;	//!< Thread-mode loop passes.
+    uint32_t worst_cycles;			//!< Longest pend-to-finish time of a tick, CPU cycles.
+} Watchdog_State_t;
+
+extern Watchdog_State_t g_watchdog;
+
+/**
+ * @brief Take the reset cause and force the motors off; first thing in main.
+ */
+void Watchdog_Boot(void);
+
+/**
+ * @brief Log the reset cause and start both watchdogs; once the tick runs.
+ *
+ * @param tick_ms Control tick period.
+ */
+void Watchdog_Start(uint32_t tick_ms);
+
+/**
+ * @brief Fast layer hook, every PWM period: grace keep-alive of the WWDG.
+ */
+void Watchdog_Fast(void);
+
+/**
+ * @brief Check the tick deadline and refresh the WWDG; last thing in a tick.
+ */
+void Watchdog_Tick(void);
+
+/**
+ * @brief Check every task and refresh the IWDG; background layer.
+ */
+void Watchdog_Background(void);
+
+/**
+ * @brief Thread-mode loop heartbeat.
+ */
+static inline void Watchdog_LoopAlive(void) {
+    g_watchdog.loop_count++;
+}
+
+/**
+ * @brief Disable the motors and stop feeding; safe from any context.
+ *
+ * @param fault WATCHDOG_FAULT_* reason.
+ */
+void Watchdog_Trip(uint8_t fault);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // _WATCHDOG_H_
@@ -32,6 +32,7 @@ extern "C" {
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "axis.h"
 
 /* USER CODE END Includes */
 
@@ -62,6 +63,17 @@ uint32_t Main_GetTickMillisec(void);
 /* These tell peripherals.c that the timers exist in main.c */
 extern TIM_HandleTypeDef htim1;
 extern TIM_HandleTypeDef htim3;
+#if AXIS_COUNT > 1
+extern TIM_HandleTypeDef htim4;
+#endif
+#if AXIS_COUNT > 2
+extern TIM_HandleTypeDef htim8;
+extern TIM_HandleTypeDef htim15;
+#endif
+#if AXIS_COUNT > 3
+extern TIM_HandleTypeDef htim5;
+extern TIM_HandleTypeDef htim2;
+#endif
 /* USER CODE END EFP */
 
 /* Private defines -----------------------------------------------------------*/
@@ -71,6 +83,20 @@ extern TIM_HandleTypeDef htim3;
 #define MOTOR_EN1_GPIO_Port GPIOA
 #define MOTOR_EN2_Pin GPIO_PIN_6
 #define MOTOR_EN2_GPIO_Port GPIOA
+
+/* Enable pins for the additional axes (see axis.h) */
+#define MOTOR1_EN1_Pin GPIO_PIN_0
+#define MOTOR1_EN1_GPIO_Port GPIOC
+#define MOTOR1_EN2_Pin GPIO_PIN_1
+#define MOTOR1_EN2_GPIO_Port GPIOC
+#define MOTOR2_EN1_Pin GPIO_PIN_2
+#define MOTOR2_EN1_GPIO_Port GPIOC
+#define MOTOR2_EN2_Pin GPIO_PIN_3
+#define MOTOR2_EN2_GPIO_Port GPIOC
+#define MOTOR3_EN1_Pin GPIO_PIN_4
+#define MOTOR3_EN1_GPIO_Port GPIOC
+#define MOTOR3_EN2_Pin GPIO_PIN_5
+#define MOTOR3_EN2_GPIO_Port GPIOC
 /* USER CODE END Private defines */
 
 #ifdef __cplusplus
@@ -195,7 +195,7 @@
   */     
   
 #define  VDD_VALUE					  ((uint32_t)3300U) /*!< Value of VDD in mv */           
-#define  TICK_INT_PRIORITY            ((uint32_t)0U)    /*!< tick interrupt priority */            
+#define  TICK_INT_PRIORITY            ((uint32_t)4U)    /*!< tick interrupt priority (IRQ_PRIO_SYSTICK, see irq.h) */            
 #define  USE_RTOS                     0U     
 #define  PREFETCH_ENABLE              0U
 #define  INSTRUCTION_CACHE_ENABLE     1U
@@ -25,6 +25,9 @@
 /* USER CODE BEGIN Includes */
 #include <stdio.h>
 #include "application.h"
+#include "boot.h"
+#include "timdrv.h"
+#include "watchdog.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -46,6 +49,17 @@ TIM_HandleTypeDef htim1;
 TIM_HandleTypeDef htim3;
 
 /* USER CODE BEGIN PV */
+#if AXIS_COUNT > 1
+TIM_HandleTypeDef htim4;
+#endif
+#if AXIS_COUNT > 2
+TIM_HandleTypeDef htim8;
+TIM_HandleTypeDef htim15;
+#endif
+#if AXIS_COUNT > 3
+TIM_HandleTypeDef htim5;
+TIM_HandleTypeDef htim2;
+#endif
 
 /* USER CODE END PV */
 
@@ -55,6 +69,9 @@ static void MX_GPIO_Init(void);
 static void MX_TIM1_Init(void);
 static void MX_TIM3_Init(void);
 /* USER CODE BEGIN PFP */
+#if AXIS_COUNT > 1
+static void MX_Axes_Init(void);
+#endif
 
 /* USER CODE END PFP */
 
@@ -71,7 +88,8 @@ uint32_t Main_GetTickMillisec(void) {return HAL_GetTick();}
 int main(void)
 {
   /* USER CODE BEGIN 1 */
-
+  Watchdog_Boot();
+  Boot_Start();
   /* USER CODE END 1 */
 
   /* MCU Configuration--------------------------------------------------------*/
@@ -80,14 +98,14 @@ int main(void)
   HAL_Init();
 
   /* USER CODE BEGIN Init */
-
+  Boot_Mark(BOOT_HAL);
   /* USER CODE END Init */
 
   /* Configure the system clock */
   SystemClock_Config();
 
   /* USER CODE BEGIN SysInit */
-
+  Boot_Mark(BOOT_CLOCK);
   /* USER CODE END SysInit */
 
   /* Initialize all configured peripherals */
@@ -95,7 +113,13 @@ int main(void)
   MX_TIM1_Init();
   MX_TIM3_Init();
 /* USER CODE BEGIN 2 */
+Boot_Mark(BOOT_PERIPH);
+#if AXIS_COUNT > 1
+MX_Axes_Init();
+#endif
+Boot_Mark(BOOT_AXES);
 Application_Setup();
+Boot_Mark(BOOT_SETUP);
 /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -166,7 +190,15 @@ static void MX_TIM1_Init(void)
 {
 
   /* USER CODE BEGIN TIM1_Init 0 */
-
+  const uint32_t t0 = TimDrv_MeasureBegin();
+#if !TIMDRV_HAL
+  /* Register-level path; the HAL configuration below is kept for TIMDRV_HAL=1 */
+  htim1.Instance = TIM1;
+  HAL_TIM_Encoder_MspInit(&htim1);
+  TimDrv_EncoderInit(TIM1);
+  TimDrv_MeasureEnd(t0);
+  return;
+#endif
   /* USER CODE END TIM1_Init 0 */
 
   TIM_Encoder_InitTypeDef sConfig = {0};
@@ -205,6 +237,7 @@ static void MX_TIM1_Init(void)
 /* USER CODE BEGIN TIM1_Init 2 */
 HAL_TIM_Encoder_Start(&htim1,TIM_CHANNEL_1);
 HAL_TIM_Encoder_Start(&htim1,TIM_CHANNEL_2);
+TimDrv_MeasureEnd(t0);
 /* USER CODE END TIM1_Init 2 */
 
 }
@@ -218,7 +251,19 @@ static void MX_TIM3_Init(void)
 {
 
   /* USER CODE BEGIN TIM3_Init 0 */
-
+  const uint32_t t0 = TimDrv_MeasureBegin();
+#if !TIMDRV_HAL
+  /* Register-level path; the HAL configuration below is kept for TIMDRV_HAL=1 */
+  htim3.Instance = TIM3;
+  HAL_TIM_PWM_MspInit(&htim3);
+  TimDrv_PWMInit(TIM3, 2048U);
+  TimDrv_PWMChannel(TIM3, TIM_CHANNEL_1);
+  TimDrv_PWMChannel(TIM3, TIM_CHANNEL_2);
+  TimDrv_Start(TIM3);
+  TimDrv_MeasureEnd(t0);
+  HAL_TIM_MspPostInit(&htim3);
+  return;
+#endif
   /* USER CODE END TIM3_Init 0 */
 
   TIM_MasterConfigTypeDef sMasterConfig = {0};
@@ -258,6 +303,7 @@ static void MX_TIM3_Init(void)
 /* USER CODE BEGIN TIM3_Init 2 */
 HAL_TIM_PWM_Start(&htim3, TIM_CHANNEL_1);
 HAL_TIM_PWM_Start(&htim3, TIM_CHANNEL_2);
+TimDrv_MeasureEnd(t0);
 /* USER CODE END TIM3_Init 2 */
   HAL_TIM_MspPostInit(&htim3);
 
@@ -290,6 +336,165 @@ static void MX_GPIO_Init(void)
 }
 
 /* USER CODE BEGIN 4 */
+#if AXIS_COUNT > 1
+/**
+  * @brief Encoder timer initialisation for an additional axis.
+  * Same quadrature configuration as TIM1 (TI12, 16-bit wrap).
+  * @param htim Handle to initialise
+  * @param instance Timer used as encoder counter
+  * @retval None
+  */
+static void MX_AxisEncoder_Init(TIM_HandleTypeDef *htim, TIM_TypeDef *instance)
+{
+  const uint32_t t0 = TimDrv_MeasureBegin();
+#if TIMDRV_HAL
+  TIM_Encoder_InitTypeDef sConfig = {0};
+
+  htim->Instance = instance;
+  htim->Init.Prescaler = 0;
+  htim->Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim->Init.Period = 65535;
+  htim->Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+  htim->Init.RepetitionCounter = 0;
+  htim->Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+  sConfig.EncoderMode = TIM_ENCODERMODE_TI12;
+  sConfig.IC1Polarity = TIM_ICPOLARITY_RISING;
+  sConfig.IC1Selection = TIM_ICSELECTION_DIRECTTI;
+  sConfig.IC1Prescaler = TIM_ICPSC_DIV1;
+  sConfig.IC1Filter = 0;
+  sConfig.IC2Polarity = TIM_ICPOLARITY_RISING;
+  sConfig.IC2Selection = TIM_ICSELECTION_DIRECTTI;
+  sConfig.IC2Prescaler = TIM_ICPSC_DIV1;
+  sConfig.IC2Filter = 0;
+  if (HAL_TIM_Encoder_Init(htim, &sConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  HAL_TIM_Encoder_Start(htim, TIM_CHANNEL_ALL);
+#else
+  htim->Instance = instance;
+  TimDrv_EncoderInit(instance);
+#endif
+  TimDrv_MeasureEnd(t0);
+}
+
+/**
+  * @brief PWM channel pair initialisation for an additional axis.
+  * Same period and mode as TIM3 so every axis sees the same Q30 duty scale.
+  * @param htim Handle to initialise (TIM3 is shared with axis 0 and kept as is)
+  * @param instance Timer producing the PWM
+  * @param ch_a First channel of the pair
+  * @param ch_b Second channel of the pair
+  * @retval None
+  */
+static void MX_AxisPWM_Init(TIM_HandleTypeDef *htim, TIM_TypeDef *instance, uint32_t ch_a, uint32_t ch_b)
+{
+  const uint32_t t0 = TimDrv_MeasureBegin();
+#if TIMDRV_HAL
+  TIM_OC_InitTypeDef sConfigOC = {0};
+
+  if (htim->Instance != instance)
+  {
+    htim->Instance = instance;
+    htim->Init.Prescaler = 0;
+    htim->Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim->Init.Period = 2047;
+    htim->Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim->Init.RepetitionCounter = 0;
+    htim->Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    if (HAL_TIM_PWM_Init(htim) != HAL_OK)
+    {
+      Error_Handler();
+    }
+  }
+  sConfigOC.OCMode = TIM_OCMODE_PWM1;
+  sConfigOC.Pulse = 0;
+  sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
+  sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+  if (HAL_TIM_PWM_ConfigChannel(htim, &sConfigOC, ch_a) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  if (HAL_TIM_PWM_ConfigChannel(htim, &sConfigOC, ch_b) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  HAL_TIM_PWM_Start(htim, ch_a);
+  HAL_TIM_PWM_Start(htim, ch_b);
+#else
+  if (htim->Instance != instance)
+  {
+    htim->Instance = instance;
+    TimDrv_PWMInit(instance, 2048U);
+  }
+  TimDrv_PWMChannel(instance, ch_a);
+  TimDrv_PWMChannel(instance, ch_b);
+  TimDrv_Start(instance);
+#endif
+  TimDrv_MeasureEnd(t0);
+}
+
+/**
+  * @brief Alternate-function pin setup for the additional axis timers.
+  * @retval None
+  */
+static void MX_AxisPins_Init(GPIO_TypeDef *port, uint32_t pins, uint32_t alternate)
+{
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  GPIO_InitStruct.Pin = pins;
+  GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+  GPIO_InitStruct.Alternate = alternate;
+  HAL_GPIO_Init(port, &GPIO_InitStruct);
+}
+
+/**
+  * @brief Timers and enable pins for axes 1..AXIS_COUNT-1.
+  *   Axis 1: encoder TIM4 (PB6/PB7),  PWM TIM3 CH3/CH4 (PB0/PB1),   enable PC0/PC1
+  *   Axis 2: encoder TIM8 (PC6/PC7),  PWM TIM15 CH1/CH2 (PB14/PB15), enable PC2/PC3
+  *   Axis 3: encoder TIM5 (PA0/PA1),  PWM TIM2 CH3/CH4 (PB10/PB11),  enable PC4/PC5
+  * @retval None
+  */
+static void MX_Axes_Init(void)
+{
+  GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+  /* GPIOA/GPIOB clocks are already on from MX_GPIO_Init */
+  __HAL_RCC_GPIOC_CLK_ENABLE();
+
+  /* Enable pins start low (half-bridges off) */
+  HAL_GPIO_WritePin(GPIOC, GPIO_PIN_0|GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3|GPIO_PIN_4|GPIO_PIN_5, GPIO_PIN_RESET);
+  GPIO_InitStruct.Pin = GPIO_PIN_0|GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3|GPIO_PIN_4|GPIO_PIN_5;
+  GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+  HAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
+
+  __HAL_RCC_TIM4_CLK_ENABLE();
+  MX_AxisPins_Init(GPIOB, GPIO_PIN_6|GPIO_PIN_7, GPIO_AF2_TIM4);
+  MX_AxisPins_Init(GPIOB, GPIO_PIN_0|GPIO_PIN_1, GPIO_AF2_TIM3);
+  MX_AxisEncoder_Init(&htim4, TIM4);
+  MX_AxisPWM_Init(&htim3, TIM3, TIM_CHANNEL_3, TIM_CHANNEL_4);
+#if AXIS_COUNT > 2
+  __HAL_RCC_TIM8_CLK_ENABLE();
+  __HAL_RCC_TIM15_CLK_ENABLE();
+  MX_AxisPins_Init(GPIOC, GPIO_PIN_6|GPIO_PIN_7, GPIO_AF3_TIM8);
+  MX_AxisPins_Init(GPIOB, GPIO_PIN_14|GPIO_PIN_15, GPIO_AF14_TIM15);
+  MX_AxisEncoder_Init(&htim8, TIM8);
+  MX_AxisPWM_Init(&htim15, TIM15, TIM_CHANNEL_1, TIM_CHANNEL_2);
+#endif
+#if AXIS_COUNT > 3
+  __HAL_RCC_TIM5_CLK_ENABLE();
+  __HAL_RCC_TIM2_CLK_ENABLE();
+  MX_AxisPins_Init(GPIOA, GPIO_PIN_0|GPIO_PIN_1, GPIO_AF2_TIM5);
+  MX_AxisPins_Init(GPIOB, GPIO_PIN_10|GPIO_PIN_11, GPIO_AF1_TIM2);
+  MX_AxisEncoder_Init(&htim5, TIM5);
+  MX_AxisPWM_Init(&htim2, TIM2, TIM_CHANNEL_3, TIM_CHANNEL_4);
+#endif
+}
+#endif
 
 /* USER CODE END 4 */
 
@@ -301,6 +506,11 @@ void Error_Handler(void)
 {
   /* USER CODE BEGIN Error_Handler_Debug */
   /* User can add his own implementation to report the HAL error return state */
+  /* Motors off; a running watchdog then resets the MCU */
+  Watchdog_Trip(WATCHDOG_FAULT_ERROR);
+  while (1)
+  {
+  }
 
   /* USER CODE END Error_Handler_Debug */
 }
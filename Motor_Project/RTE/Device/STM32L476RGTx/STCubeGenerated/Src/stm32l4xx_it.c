@@ -23,6 +23,13 @@
 #include "stm32l4xx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "application.h"
+#include "canbus.h"
+#include "cpuload.h"
+#include "irq.h"
+#include "peripherals.h"
+#include "timdrv.h"
+#include "watchdog.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -58,7 +65,9 @@
 /* External variables --------------------------------------------------------*/
 
 /* USER CODE BEGIN EV */
-
+#if TIMDRV_HAL
+extern TIM_HandleTypeDef htim3;
+#endif
 /* USER CODE END EV */
 
 /******************************************************************************/
@@ -83,7 +92,8 @@ void NMI_Handler(void)
 void HardFault_Handler(void)
 {
   /* USER CODE BEGIN HardFault_IRQn 0 */
-
+  /* Motors off; the watchdogs are no longer fed and reset the MCU */
+  Watchdog_Trip(WATCHDOG_FAULT_HARDFAULT);
   /* USER CODE END HardFault_IRQn 0 */
   while (1)
   {
@@ -169,7 +179,11 @@ void DebugMon_Handler(void)
 void PendSV_Handler(void)
 {
   /* USER CODE BEGIN PendSV_IRQn 0 */
-
+  const uint32_t token = Irq_Enter(IRQ_LAYER_BACKGROUND, UINT32_MAX);
+  const uint8_t cpu = CpuLoad_Enter(CPULOAD_BACKGROUND);
+  Application_Background();
+  CpuLoad_Exit(cpu);
+  Irq_Exit(IRQ_LAYER_BACKGROUND, token);
   /* USER CODE END PendSV_IRQn 0 */
   /* USER CODE BEGIN PendSV_IRQn 1 */
 
@@ -182,11 +196,11 @@ void PendSV_Handler(void)
 void SysTick_Handler(void)
 {
   /* USER CODE BEGIN SysTick_IRQn 0 */
-
+  const uint8_t cpu = CpuLoad_Enter(CPULOAD_SYSTICK);
   /* USER CODE END SysTick_IRQn 0 */
   HAL_IncTick();
   /* USER CODE BEGIN SysTick_IRQn 1 */
-
+  CpuLoad_Exit(cpu);
   /* USER CODE END SysTick_IRQn 1 */
 }
 
@@ -198,6 +212,85 @@ void SysTick_Handler(void)
 /******************************************************************************/
 
 /* USER CODE BEGIN 1 */
+#if TIMDRV_HAL
+/**
+  * @brief This function handles TIM3 global interrupt through the HAL dispatch.
+  * For latency comparison only (see timdrv.h).
+  */
+void TIM3_IRQHandler(void)
+{
+  HAL_TIM_IRQHandler(&htim3);
+}
+
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+  if (htim->Instance != TIM3)
+  {
+    return;
+  }
+  const uint32_t token = Irq_Enter(IRQ_LAYER_FAST, TimDrv_IsrEntry(TIM3));
+  const uint8_t cpu = CpuLoad_Enter(CPULOAD_FAST);
+  const uint8_t tick_due = Peripheral_Sync_OnUpdate();
+  Watchdog_Fast();
+  if (tick_due)
+  {
+    Irq_PendTick();
+  }
+  CpuLoad_Exit(cpu);
+  Irq_Exit(IRQ_LAYER_FAST, token);
+}
+#else
+/**
+  * @brief This function handles TIM3 global interrupt (PWM master update).
+  * Fast layer: PWM-synchronous bookkeeping, then pends the control tick.
+  */
+void TIM3_IRQHandler(void)
+{
+  const uint32_t token = Irq_Enter(IRQ_LAYER_FAST, TimDrv_IsrEntry(TIM3));
+  const uint8_t cpu = CpuLoad_Enter(CPULOAD_FAST);
+  const uint8_t tick_due = Peripheral_Sync_OnUpdate();
+  Watchdog_Fast();
+  if (tick_due)
+  {
+    Irq_PendTick();
+  }
+  CpuLoad_Exit(cpu);
+  Irq_Exit(IRQ_LAYER_FAST, token);
+}
+#endif
+
+/**
+  * @brief Control tick layer, on the unused TIM7 vector (see irq.h).
+  */
+void TIM7_IRQHandler(void)
+{
+  const uint32_t token = Irq_Enter(IRQ_LAYER_TICK, UINT32_MAX);
+  const uint8_t cpu = CpuLoad_Enter(CPULOAD_TICK);
+  Application_Tick();
+  Irq_PendBackground();
+  CpuLoad_Exit(cpu);
+  Irq_Exit(IRQ_LAYER_TICK, token);
+}
+
+/**
+  * @brief This function handles CAN1 TX interrupt.
+  */
+void CAN1_TX_IRQHandler(void)
+{
+  const uint8_t cpu = CpuLoad_Enter(CPULOAD_CAN);
+  CanBus_Port_TxIRQHandler();
+  CpuLoad_Exit(cpu);
+}
+
+/**
+  * @brief This function handles CAN1 RX0 interrupt.
+  */
+void CAN1_RX0_IRQHandler(void)
+{
+  const uint8_t cpu = CpuLoad_Enter(CPULOAD_CAN);
+  CanBus_Port_Rx0IRQHandler();
+  CpuLoad_Exit(cpu);
+}
 
 /* USER CODE END 1 */
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
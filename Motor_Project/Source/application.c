@@ -1,15 +1,82 @@
+#define LOG_FILE_ID 1
 #include "main.h"
 
 #include "application.h"
+#include "boot.h"
+#include "canbus.h"
 #include "controller.h"
+#include "cpuload.h"
+#include "drive.h"
+#include "irq.h"
+#include "log.h"
 #include "peripherals.h"
+#include "profile.h"
+#include "recorder.h"
+#include "stall.h"
+#include "timesync.h"
+#include "trace.h"
+#include "watchdog.h"
+#include <stdatomic.h>
 
 /* Global variables ----------------------------------------------------------*/
 int32_t reference, velocity, control;
 uint32_t millisec;
 
+// Per-axis signals; reference/velocity/control above mirror axis 0 for Watch.
+// axis_reference is the reference in effect, after arbitration and limits.
+int32_t axis_reference[AXIS_COUNT], axis_velocity[AXIS_COUNT], axis_control[AXIS_COUNT];
+
+// CPU cycles spent on each axis in the last control tick, and the worst seen.
+volatile uint32_t g_axis_cycles[AXIS_COUNT];
+volatile uint32_t g_axis_cycles_max[AXIS_COUNT];
+
+// Reference of the previous tick, to spot reversals for the trace.
+static int32_t last_reference[AXIS_COUNT];
+
+// Double-buffered process image; image_seq names the latest complete one.
+ProcessImage_t image_buf[2];
+static _Atomic uint32_t image_seq = 0;
+
+// Reader retries before giving up.
+#define IMAGE_READ_TRIES 3
+
 /* Functions -----------------------------------------------------------------*/
 
+/* Fill the buffer readers are not looking at, then flip */
+static void publish_image(const int32_t *active_reference, uint8_t flags) {
+    const uint32_t seq = atomic_load_explicit(&image_seq, memory_order_relaxed) + 1U;
+    ProcessImage_t *img = &image_buf[seq & 1U];
+
+    img->seq = seq;
+    img->millisec = millisec;
+    img->time_us = Peripheral_Sync_TimeUs();
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        img->reference[axis] = active_reference[axis];
+        img->velocity[axis] = axis_velocity[axis];
+        img->control[axis] = axis_control[axis];
+        img->thermal[axis] = Controller_Thermal(axis);
+    }
+    img->flags = flags;
+
+    // Release: the whole image is visible before its sequence number.
+    atomic_store_explicit(&image_seq, seq, memory_order_release);
+}
+
+uint8_t Application_ReadImage(ProcessImage_t *image) {
+    for (uint8_t tries = 0; tries < IMAGE_READ_TRIES; tries++) {
+        const uint32_t seq = atomic_load_explicit(&image_seq, memory_order_acquire);
+        if (seq == 0U)
+            return 0;
+        *image = image_buf[seq & 1U];
+        atomic_thread_fence(memory_order_acquire);
+        // One more publication wrote the other buffer; two would have
+        // overwritten ours.
+        if (atomic_load_explicit(&image_seq, memory_order_relaxed) - seq < 2U && image->seq == seq)
+            return 1;
+    }
+    return 0;
+}
+
 /* Run setup needed for all periodic tasks */
 void Application_Setup() {
     // Reset global variables
@@ -17,39 +84,158 @@ void Application_Setup() {
     velocity = 0;
     control = 0;
     millisec = 0;
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        axis_reference[axis] = reference;
+        axis_velocity[axis] = 0;
+        axis_control[axis] = 0;
+        g_axis_cycles[axis] = 0;
+        g_axis_cycles_max[axis] = 0;
+        last_reference[axis] = reference;
+    }
 
     // Initialise hardware
-    Peripheral_GPIO_EnableMotor();
+    Peripheral_Cycles_Init();
+    Irq_Init();
+    CpuLoad_Init(PERIOD_CTRL);
+    Trace_Init();
+    Log_Init();
+    Recorder_Init(PERIOD_CTRL);
+    Profile_Init(millisec);
+    Peripheral_Axis_Init();
+    Drive_Init();
+    Stall_Init();
 
     // Initialize controller
     Controller_Reset();
+
+    // Bring up the CAN interface (stays silent if the bus is not there)
+    const uint8_t can_up = CanBus_Init();
+
+    // Slave the PWM timers to TIM3 and start the synchronous control tick
+    Peripheral_Sync_Init(PERIOD_CTRL);
+
+    // Lock the tick to the bus time master (or be it)
+    TimeSync_Init();
+
+    // Supervise the tick from here on
+    Watchdog_Start(PERIOD_CTRL);
+
+    // Soft-start every axis from the first tick on
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        Drive_Enable(axis);
+    }
+
+    LOG2("setup: %u axes, CAN %u", AXIS_COUNT, can_up);
 }
 
 /* Define what to do in the infinite loop */
 void Application_Loop() {
-    // Wait for next sample -- also prevent from re-entering again
-    while ((Main_GetTickMillisec() % PERIOD_CTRL > 0) || (Main_GetTickMillisec() == millisec)) {
-        // Do nothing while waiting
-    }
+    // The control tick and background work run in interrupt layers (irq.h),
+    // so thread mode has nothing time-critical left to do: stream the log.
+    // A pass that streams nothing only polled, and counts as idle time.
+    Watchdog_LoopAlive();
+    CpuLoad_Thread(Log_Flush() != 0U);
+}
+
+/* Background layer, pended at the end of every tick */
+void Application_Background() {
+    Watchdog_Background();
+    Boot_Report();
+    Irq_Report();
+    CpuLoad_Report();
+}
+
+/* Control tick, pended by the PWM master interrupt every PERIOD_CTRL ms */
+void Application_Tick() {
+    // Advance time by exactly one control period; the tick is paced by the
+    // PWM master, so this stays aligned with the latched encoder counts.
+    millisec += PERIOD_CTRL;
+    Trace_Event(TRACE_TICK_START, TRACE_NO_AXIS, millisec);
+    CpuLoad_Tick();
+
+    // Take in bus commands; a SYNC this tick means the TxPDOs go out
+    const uint8_t synced = CanBus_Poll(millisec);
 
-    // Get time
-    millisec = Main_GetTickMillisec();
+    // Discipline the local clock, or send SYNC/TIME as the time master
+    TimeSync_Tick();
 
-    // Every 4 sec ...
-    if (millisec % PERIOD_REF == 0) {
-        // Flip the direction of the reference
-        reference = -reference;
+    // Advance the reference profile script (bounded work per tick)
+    Profile_Tick(millisec);
+
+    // A remote reference overrides the profile; the safety limits apply to both
+    int32_t active_reference[AXIS_COUNT];
+    uint8_t flags = (uint8_t)(synced ? IMAGE_FLAG_SYNC : 0U);
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        int32_t remote;
+        const uint8_t is_remote = CanBus_GetReference(axis, &remote);
+        if (is_remote)
+            flags |= IMAGE_FLAG_REMOTE;
+        active_reference[axis] = Profile_Arbitrate(axis, is_remote ? &remote : NULL, millisec);
+        axis_reference[axis] = active_reference[axis];
+        if ((active_reference[axis] ^ last_reference[axis]) < 0)
+            Trace_Event(TRACE_REVERSAL, axis, (uint32_t)active_reference[axis]);
+        last_reference[axis] = active_reference[axis];
     }
 
-    // Every 10 msec ...
-    if (millisec % PERIOD_CTRL == 0) {
+    // Every 10 msec: run every axis back-to-back, timing each one.
+    // Encoder counts were latched together at the start of this tick.
+    int32_t applied[AXIS_COUNT];
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        const uint32_t start = Peripheral_Cycles_Now();
+
         // Calculate motor velocity
-        velocity = Peripheral_Encoder_CalculateVelocity(millisec);
+        axis_velocity[axis] = Peripheral_Encoder_CalculateVelocityAxis(axis, millisec);
+        Trace_Event(TRACE_EST_DONE, axis, (uint32_t)axis_velocity[axis]);
 
         // Calculate control signal
-        control = Controller_PIController(&reference, &velocity, &millisec);
+        axis_control[axis] = Controller_PIControllerAxis(axis, &active_reference[axis],
+                                                         &axis_velocity[axis], &millisec);
+        Trace_Event(TRACE_CTRL_DONE, axis, (uint32_t)axis_control[axis]);
 
-        // Apply control signal to motor
-        Peripheral_PWM_ActuateMotor(control);
+        // A duty sweep (peripherals.h) stands in for the controller, within
+        // its thermal limit
+        applied[axis] = Controller_ThermalLimit(axis, Peripheral_PWM_SweepControl(axis, axis_control[axis]));
+
+        // Apply control signal to motor, through the enable sequence and
+        // unless the rotor is blocked
+        applied[axis] = Drive_Tick(axis, applied[axis], millisec);
+        applied[axis] = Stall_Check(axis, active_reference[axis], axis_velocity[axis], applied[axis], millisec);
+        Peripheral_PWM_ActuateMotorAxis(axis, applied[axis]);
+        Controller_SetApplied(axis, applied[axis]);
+        Trace_Event(TRACE_PWM_APPLIED, axis, (uint32_t)applied[axis]);
+
+        const uint32_t cycles = Peripheral_Cycles_Now() - start;
+        g_axis_cycles[axis] = cycles;
+        if (cycles > g_axis_cycles_max[axis])
+            g_axis_cycles_max[axis] = cycles;
+    }
+
+    // Carrier frequency for the load just applied
+    Peripheral_PWM_AdaptFrequency();
+
+    // Synchronous TxPDOs: every node reports the same tick
+    if (synced) {
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+            CanBus_PublishStatus(axis, axis_velocity[axis], axis_control[axis], Controller_Thermal(axis));
+        }
     }
+
+    // Raw inputs of this tick, for bit-exact replay on the host
+    int16_t counts[AXIS_COUNT];
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        counts[axis] = Peripheral_Encoder_Latched(axis);
+    }
+    Recorder_Tick(millisec, counts, active_reference, axis_control, applied);
+
+    // Axis 0 mirrors
+    reference = active_reference[0];
+    velocity = axis_velocity[0];
+    control = axis_control[0];
+
+    // Everything above belongs to this tick: publish it as one image
+    publish_image(active_reference, flags);
+    Trace_Event(TRACE_TICK_END, TRACE_NO_AXIS, millisec);
+    if (millisec == PERIOD_CTRL)
+        Boot_Mark(BOOT_TICK);
+    Watchdog_Tick();
 }
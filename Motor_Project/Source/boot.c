@@ -0,0 +1,51 @@
+// boot.c
+#define LOG_FILE_ID 3
+#include "boot.h"
+#include "log.h"
+#include "main.h"
+#include <stdint.h>
+
+// This file records how long start-up takes (see boot.h):
+//  - Boot_Start zeroes the DWT cycle counter at main entry and, with
+//    BOOT_FAST, starts the PLL early so its lock time overlaps HAL_Init
+//  - Boot_Mark converts each phase to microseconds at the clock it ran on
+//  - Boot_Report logs the profile once, after the first control tick
+// The cycle counter is left running for the trace, log and tick timing.
+
+Boot_Profile_t g_boot;
+
+void Boot_Start(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0U;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    g_boot.hz = SystemCoreClock;
+
+#if BOOT_FAST
+    // Same PLL settings as SystemClock_Config: HAL_RCC_OscConfig leaves an
+    // identically configured PLL running and only waits for PLLRDY. If the
+    // two ever differ, HAL reprograms it and only the overlap is lost.
+    __HAL_RCC_PLL_CONFIG(RCC_PLLSOURCE_MSI, 1U, 20U, RCC_PLLP_DIV7, RCC_PLLQ_DIV2, RCC_PLLR_DIV2);
+    __HAL_RCC_PLL_ENABLE();
+    __HAL_RCC_PLLCLKOUT_ENABLE(RCC_PLL_SYSCLK);
+#endif
+}
+
+void Boot_Mark(uint8_t phase) {
+    const uint32_t now = DWT->CYCCNT;
+    const uint8_t prev = (phase > 0U) ? (uint8_t)(phase - 1U) : 0U;
+
+    g_boot.cycles[phase] = now;
+    if (phase > 0U) {
+        const uint64_t dt = (uint64_t)(now - g_boot.cycles[prev]) * 1000000U / g_boot.hz;
+        g_boot.us[phase] = g_boot.us[prev] + (uint32_t)dt;
+    }
+    g_boot.hz = SystemCoreClock;
+}
+
+void Boot_Report(void) {
+    if (g_boot.reported || g_boot.cycles[BOOT_TICK] == 0U)
+        return;
+    g_boot.reported = 1U;
+    LOG4("boot: hal %u us, clock %u us, periph %u us, axes %u us", g_boot.us[BOOT_HAL], g_boot.us[BOOT_CLOCK], g_boot.us[BOOT_PERIPH], g_boot.us[BOOT_AXES]);
+    LOG2("boot: setup %u us, first tick %u us", g_boot.us[BOOT_SETUP], g_boot.us[BOOT_TICK]);
+}
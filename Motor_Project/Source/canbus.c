@@ -0,0 +1,284 @@
+// canbus.c
+#include "canbus.h"
+#include "axis.h"
+#include "lockfree.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// This file implements the CAN protocol layer:
+//  - fixed-layout PDOs (reference in, velocity/control/status out)
+//  - SYNC handling so all nodes tick and switch references together
+//  - SYNC/TIME frames for the clock sync in timesync.c
+//  - lock-free single-producer/single-consumer frame queues between the
+//    transport interrupts and the control tick
+// It has no hardware dependency; the transport is canbus_bxcan.c on target.
+
+/* ----------------- Config ----------------- */
+
+// Queue depths, must be powers of two (checked by RING_STORAGE).
+#define RX_QUEUE_N 16U
+#define TX_QUEUE_N 8U
+
+// Q30 control output is sent as Q15 in the TxPDO.
+#define CTRL_TX_SHIFT 15
+#define CTRL_MAX ((int32_t)0x3FFFFFFF)
+#define CTRL_MIN ((int32_t)0xC0000000)
+
+/* ----------------- Frame queues ----------------- */
+
+// Frames are built and parsed in place in the ring slots (lockfree.h).
+RING_STORAGE(rx_buf, CanBus_Frame_t, RX_QUEUE_N);
+RING_STORAGE(tx_buf, CanBus_Frame_t, TX_QUEUE_N);
+static Ring_t rx_queue;
+static Ring_t tx_queue;
+
+/* ----------------- PDO state ----------------- */
+
+static struct {
+    int32_t staged[AXIS_COUNT];  // Last RxPDO, applied at the next SYNC
+    int32_t active[AXIS_COUNT];  // Reference in effect
+    uint32_t last_rx_ms;         // Tick time of the last RxPDO
+    uint8_t have_staged;
+    uint8_t remote;              // Remote reference has been received
+    uint8_t timeout;             // ... but is stale
+    uint8_t sync_count;          // Counter byte of the last SYNC
+    uint8_t local_sync;          // We sent a SYNC ourselves ...
+    uint8_t local_count;         // ... with this counter
+    uint8_t up;                  // Transport initialised
+} pdo;
+
+// Last TIME follow-up, handed to timesync.c through CanBus_TakeTime.
+static struct {
+    uint64_t time_us;
+    uint8_t counter;
+    uint8_t fresh;
+} time_rx;
+
+// Dropped frames per direction, for debugging/Watch.
+volatile uint32_t g_can_rx_dropped = 0;
+volatile uint32_t g_can_tx_dropped = 0;
+
+/* ----------------- Helpers ----------------- */
+
+static inline int16_t get_i16(const uint8_t *p) {
+    return (int16_t)(uint16_t)((uint16_t)p[0] | (uint16_t)((uint16_t)p[1] << 8));
+}
+
+// Next TX slot to fill, or NULL (and counted) if the queue is full.
+static inline CanBus_Frame_t *tx_reserve(void) {
+    CanBus_Frame_t *frame = (CanBus_Frame_t *)Ring_Reserve(&tx_queue);
+    if (frame == NULL)
+        g_can_tx_dropped++;
+    return frame;
+}
+
+static inline void tx_commit(void) {
+    Ring_Commit(&tx_queue);
+    CanBus_Port_RequestTx();
+}
+
+static inline void put_i16(uint8_t *p, int32_t v) {
+    if (v > 32767)
+        v = 32767;
+    if (v < -32768)
+        v = -32768;
+    const uint16_t u = (uint16_t)(int16_t)v;
+    p[0] = (uint8_t)(u & 0xFFU);
+    p[1] = (uint8_t)(u >> 8);
+}
+
+// Synchronous RxPDO: staged references take effect on SYNC.
+static void on_sync(uint8_t counter) {
+    if (pdo.have_staged) {
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++)
+            pdo.active[axis] = pdo.staged[axis];
+        pdo.have_staged = 0;
+        pdo.remote = 1;
+        pdo.timeout = 0;
+    }
+    pdo.sync_count = counter;
+}
+
+/* ----------------- API ----------------- */
+
+uint8_t CanBus_Init(void) {
+    static const uint16_t accept[] = {CANBUS_ID_SYNC, CANBUS_ID_TIME, CANBUS_ID_RXPDO};
+
+    Ring_Init(&rx_queue, rx_buf, sizeof(rx_buf[0]), RX_QUEUE_N);
+    Ring_Init(&tx_queue, tx_buf, sizeof(tx_buf[0]), TX_QUEUE_N);
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        pdo.staged[axis] = 0;
+        pdo.active[axis] = 0;
+    }
+    pdo.last_rx_ms = 0U;
+    pdo.have_staged = 0;
+    pdo.remote = 0;
+    pdo.timeout = 0;
+    pdo.sync_count = 0;
+    pdo.local_sync = 0;
+    time_rx.fresh = 0;
+
+    pdo.up = CanBus_Port_Init(accept, (uint8_t)(sizeof(accept) / sizeof(accept[0])));
+    return pdo.up;
+}
+
+CanBus_Frame_t *CanBus_RxReserve(void) {
+    CanBus_Frame_t *frame = (CanBus_Frame_t *)Ring_Reserve(&rx_queue);
+    if (frame == NULL)
+        g_can_rx_dropped++;
+    return frame;
+}
+
+CanBus_Event_t CanBus_RxCommit(void) {
+    // Peek at the id before the slot becomes the consumer's.
+    const CanBus_Frame_t *frame = (const CanBus_Frame_t *)Ring_Reserve(&rx_queue);
+    const uint8_t sync = (uint8_t)(frame->id == CANBUS_ID_SYNC);
+    Ring_Commit(&rx_queue);
+    // SYNC is also queued so the tick sees it in order with the RxPDOs.
+    return sync ? CANBUS_EVENT_SYNC : CANBUS_EVENT_NONE;
+}
+
+CanBus_Event_t CanBus_OnFrame(const CanBus_Frame_t *frame) {
+    CanBus_Frame_t *slot = CanBus_RxReserve();
+    if (slot == NULL)
+        return CANBUS_EVENT_DROPPED;
+    *slot = *frame;
+    return CanBus_RxCommit();
+}
+
+const CanBus_Frame_t *CanBus_TxPeek(void) {
+    return (const CanBus_Frame_t *)Ring_Peek(&tx_queue);
+}
+
+void CanBus_TxRelease(void) {
+    Ring_Release(&tx_queue);
+}
+
+uint8_t CanBus_NextTx(CanBus_Frame_t *frame) {
+    const CanBus_Frame_t *slot = CanBus_TxPeek();
+    if (slot == NULL)
+        return 0;
+    *frame = *slot;
+    CanBus_TxRelease();
+    return 1;
+}
+
+uint8_t CanBus_Poll(uint32_t millisec) {
+    uint8_t synced = 0;
+    const CanBus_Frame_t *frame;
+
+    // Our own SYNC counts as received on the tick after it was sent.
+    if (pdo.local_sync) {
+        pdo.local_sync = 0;
+        on_sync(pdo.local_count);
+        synced = 1;
+    }
+
+    while ((frame = (const CanBus_Frame_t *)Ring_Peek(&rx_queue)) != NULL) {
+        if (frame->id == CANBUS_ID_RXPDO) {
+            // One int16 RPM per axis; short frames leave the other axes alone.
+            for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+                if (frame->dlc >= 2U * axis + 2U)
+                    pdo.staged[axis] = get_i16(&frame->data[2U * axis]);
+            }
+            pdo.have_staged = 1;
+            pdo.last_rx_ms = millisec;
+        } else if (frame->id == CANBUS_ID_SYNC) {
+            on_sync((frame->dlc > 0U) ? frame->data[0] : (uint8_t)(pdo.sync_count + 1U));
+            synced = 1;
+        } else if (frame->id == CANBUS_ID_TIME && frame->dlc >= 7U) {
+            time_rx.counter = frame->data[0];
+            time_rx.time_us = 0U;
+            for (uint8_t i = 0; i < 6U; i++)
+                time_rx.time_us |= (uint64_t)frame->data[1U + i] << (8U * i);
+            time_rx.fresh = 1;
+        }
+        Ring_Release(&rx_queue);
+    }
+
+    // A silent commander must not leave the motor running on an old command.
+    if (pdo.remote && (millisec - pdo.last_rx_ms) > CANBUS_RX_TIMEOUT_MS) {
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++)
+            pdo.active[axis] = 0;
+        pdo.timeout = 1;
+    }
+    return synced;
+}
+
+uint8_t CanBus_GetReference(uint8_t axis, int32_t *reference) {
+    if (!pdo.remote)
+        return 0;
+    *reference = pdo.active[axis];
+    return 1;
+}
+
+void CanBus_PublishStatus(uint8_t axis, int32_t velocity, int32_t control, uint16_t thermal) {
+    if (!pdo.up)
+        return;
+
+    uint8_t status = 0U;
+    if (pdo.remote)
+        status |= CANBUS_STATUS_REMOTE;
+    if (pdo.timeout)
+        status |= CANBUS_STATUS_TIMEOUT;
+    if (control >= CTRL_MAX || control <= CTRL_MIN)
+        status |= CANBUS_STATUS_SATURATED;
+    if (thermal >= 1000U)
+        status |= CANBUS_STATUS_HOT;
+
+    // Layout: int16 RPM, int16 control (Q15), status, SYNC counter echo,
+    // winding heat in percent of the limit (saturates at 255).
+    CanBus_Frame_t *frame = tx_reserve();
+    if (frame == NULL)
+        return;
+    frame->id = CANBUS_ID_TXPDO(axis);
+    frame->dlc = 7U;
+    put_i16(&frame->data[0], velocity);
+    put_i16(&frame->data[2], control >> CTRL_TX_SHIFT);
+    frame->data[4] = status;
+    frame->data[5] = pdo.sync_count;
+    frame->data[6] = (uint8_t)((thermal / 10U > 255U) ? 255U : thermal / 10U);
+    frame->data[7] = 0U;
+    tx_commit();
+}
+
+void CanBus_SendSync(uint8_t counter) {
+    if (!pdo.up)
+        return;
+    CanBus_Frame_t *frame = tx_reserve();
+    if (frame == NULL)
+        return;
+    frame->id = CANBUS_ID_SYNC;
+    frame->dlc = 1U;
+    for (uint8_t i = 0; i < 8U; i++)
+        frame->data[i] = 0U;
+    frame->data[0] = counter;
+    tx_commit();
+    pdo.local_count = counter;
+    pdo.local_sync = 1;
+}
+
+void CanBus_SendTime(uint8_t counter, uint64_t time_us) {
+    if (!pdo.up)
+        return;
+    // Layout: SYNC counter, 48-bit little-endian time.
+    CanBus_Frame_t *frame = tx_reserve();
+    if (frame == NULL)
+        return;
+    frame->id = CANBUS_ID_TIME;
+    frame->dlc = 7U;
+    frame->data[0] = counter;
+    for (uint8_t i = 0; i < 6U; i++)
+        frame->data[1U + i] = (uint8_t)(time_us >> (8U * i));
+    frame->data[7] = 0U;
+    tx_commit();
+}
+
+uint8_t CanBus_TakeTime(uint8_t *counter, uint64_t *time_us) {
+    if (!time_rx.fresh)
+        return 0;
+    time_rx.fresh = 0;
+    *counter = time_rx.counter;
+    *time_us = time_rx.time_us;
+    return 1;
+}
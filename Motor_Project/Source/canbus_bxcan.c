@@ -0,0 +1,204 @@
+// canbus_bxcan.c
+#include "canbus.h"
+#include "irq.h"
+#include "main.h"
+#include "peripherals.h"
+#include "timesync.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// This file is the on-target CAN transport for canbus.c, written directly
+// against the bxCAN registers (CAN1 on PB8/PB9):
+//  - identifier-list filter banks so only SYNC, TIME and our RxPDO reach FIFO0
+//  - FIFO0 message-pending interrupt pushes frames into the RX queue
+//  - mailbox-empty interrupt pulls frames from the TX queue
+// Both interrupts run above the TIM3 priority so SYNC timestamps are not
+// held off by a control tick; anything touching the tick pacing is deferred
+// to the next master update.
+
+/* ----------------- Config ----------------- */
+
+// 40 MHz APB1 / 5 = 8 MHz time quanta, 1 + 13 + 2 = 16 tq per bit -> 500 kbit/s,
+// sample point at 87.5%.
+#define CAN_BRP 5U
+#define CAN_TS1 13U
+#define CAN_TS2 2U
+#define CAN_SJW 1U
+
+// Polling budget for the init/normal mode handshakes.
+#define CAN_ACK_TIMEOUT_MS 10U
+
+// Above the fast and tick layers: SYNC timestamps must not wait for them.
+#define CAN_IRQ_PRIO IRQ_PRIO_CAN
+
+// Filter banks hold four 16-bit identifiers each in list mode.
+#define IDS_PER_BANK 4U
+#define FILTER_BANKS 14U
+
+/* ----------------- State ----------------- */
+
+// SYNC waiting in a mailbox, timestamped when its request completes.
+static struct {
+    uint32_t mailbox;
+    uint8_t counter;
+    uint8_t armed;
+} sync_tx;
+
+/* ----------------- Helpers ----------------- */
+
+// Wait until (MSR & mask) == want, bounded by CAN_ACK_TIMEOUT_MS.
+static uint8_t wait_msr(uint32_t mask, uint32_t want) {
+    const uint32_t start = HAL_GetTick();
+    while ((CAN1->MSR & mask) != want) {
+        if ((HAL_GetTick() - start) > CAN_ACK_TIMEOUT_MS)
+            return 0;
+    }
+    return 1;
+}
+
+// 16-bit filter register layout: STID[10:0] in bits 15:5, RTR and IDE clear.
+static inline uint32_t filter16(uint16_t id) {
+    return ((uint32_t)id & 0x7FFU) << 5U;
+}
+
+static void pins_init(void) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    // PB8 = CAN1_RX (pulled up so a missing transceiver reads recessive), PB9 = CAN1_TX
+    GPIO_InitStruct.Pin = GPIO_PIN_8 | GPIO_PIN_9;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+    GPIO_InitStruct.Alternate = GPIO_AF9_CAN1;
+    HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+}
+
+/* ----------------- Transport hooks ----------------- */
+
+uint8_t CanBus_Port_Init(const uint16_t *ids, uint8_t count) {
+    pins_init();
+    __HAL_RCC_CAN1_CLK_ENABLE();
+
+    // Leave sleep, enter initialisation mode.
+    CAN1->MCR &= ~CAN_MCR_SLEEP;
+    CAN1->MCR |= CAN_MCR_INRQ;
+    if (!wait_msr(CAN_MSR_INAK, CAN_MSR_INAK))
+        return 0;
+
+    // Automatic bus-off recovery, transmit in queue order.
+    CAN1->MCR |= CAN_MCR_ABOM | CAN_MCR_TXFP;
+    CAN1->BTR = ((CAN_SJW - 1U) << CAN_BTR_SJW_Pos) |
+                ((CAN_TS2 - 1U) << CAN_BTR_TS2_Pos) |
+                ((CAN_TS1 - 1U) << CAN_BTR_TS1_Pos) |
+                (CAN_BRP - 1U);
+
+    // Identifier-list filters, 16-bit scale, all into FIFO0.
+    CAN1->FMR |= CAN_FMR_FINIT;
+    CAN1->FA1R = 0U;
+    uint32_t banks = 0U;
+    for (uint32_t first = 0U; first < count && banks < FILTER_BANKS; first += IDS_PER_BANK) {
+        // Unused slots repeat the last identifier of the bank.
+        uint32_t slot[IDS_PER_BANK];
+        for (uint32_t i = 0U; i < IDS_PER_BANK; i++) {
+            const uint32_t n = (first + i < count) ? first + i : count - 1U;
+            slot[i] = filter16(ids[n]);
+        }
+        const uint32_t bit = 1UL << banks;
+        CAN1->FM1R |= bit;   // list mode
+        CAN1->FS1R &= ~bit;  // 16-bit scale
+        CAN1->FFA1R &= ~bit; // FIFO0
+        CAN1->sFilterRegister[banks].FR1 = slot[0] | (slot[1] << 16U);
+        CAN1->sFilterRegister[banks].FR2 = slot[2] | (slot[3] << 16U);
+        CAN1->FA1R |= bit;
+        banks++;
+    }
+    CAN1->FMR &= ~CAN_FMR_FINIT;
+
+    // Back to normal mode; needs 11 recessive bits on the bus.
+    CAN1->MCR &= ~CAN_MCR_INRQ;
+    if (!wait_msr(CAN_MSR_INAK, 0U))
+        return 0;
+
+    CAN1->IER |= CAN_IER_FMPIE0 | CAN_IER_TMEIE;
+    HAL_NVIC_SetPriority(CAN1_RX0_IRQn, CAN_IRQ_PRIO, 0);
+    HAL_NVIC_SetPriority(CAN1_TX_IRQn, CAN_IRQ_PRIO, 0);
+    HAL_NVIC_EnableIRQ(CAN1_RX0_IRQn);
+    HAL_NVIC_EnableIRQ(CAN1_TX_IRQn);
+    return 1;
+}
+
+void CanBus_Port_RequestTx(void) {
+    // The TX interrupt is the only consumer of the TX queue; pend it rather
+    // than touching the mailboxes from the caller's context.
+    NVIC_SetPendingIRQ(CAN1_TX_IRQn);
+}
+
+/* ----------------- Interrupts ----------------- */
+
+void CanBus_Port_TxIRQHandler(void) {
+    const uint32_t tsr = CAN1->TSR;
+    if (sync_tx.armed && (tsr & (CAN_TSR_RQCP0 << (8U * sync_tx.mailbox))) != 0U) {
+        // End of our SYNC on the wire, give or take interrupt latency.
+        if ((tsr & (CAN_TSR_TXOK0 << (8U * sync_tx.mailbox))) != 0U)
+            TimeSync_OnSyncTx(sync_tx.counter, Peripheral_Sync_TimeUs());
+        sync_tx.armed = 0U;
+    }
+    // Acknowledge completed requests (rc_w1); this also clears the interrupt.
+    CAN1->TSR = CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2;
+
+    const CanBus_Frame_t *frame;
+    while ((CAN1->TSR & CAN_TSR_TME) != 0U && (frame = CanBus_TxPeek()) != NULL) {
+        // CODE holds the number of the next free mailbox.
+        const uint32_t mb = (CAN1->TSR & CAN_TSR_CODE) >> CAN_TSR_CODE_Pos;
+        CAN_TxMailBox_TypeDef *box = &CAN1->sTxMailBox[mb];
+        box->TDTR = (uint32_t)frame->dlc & CAN_TDT0R_DLC;
+        box->TDLR = (uint32_t)frame->data[0] | ((uint32_t)frame->data[1] << 8U) |
+                    ((uint32_t)frame->data[2] << 16U) | ((uint32_t)frame->data[3] << 24U);
+        box->TDHR = (uint32_t)frame->data[4] | ((uint32_t)frame->data[5] << 8U) |
+                    ((uint32_t)frame->data[6] << 16U) | ((uint32_t)frame->data[7] << 24U);
+        if (frame->id == CANBUS_ID_SYNC) {
+            sync_tx.mailbox = mb;
+            sync_tx.counter = frame->data[0];
+            sync_tx.armed = 1U;
+        }
+        box->TIR = ((frame->id & 0x7FFU) << CAN_TI0R_STID_Pos) | CAN_TI0R_TXRQ;
+        CanBus_TxRelease();
+    }
+}
+
+void CanBus_Port_Rx0IRQHandler(void) {
+    // Timestamp first; a SYNC further down the FIFO gets a late stamp, which
+    // the servo rejects as an outlier.
+    const uint64_t now_us = Peripheral_Sync_TimeUs();
+    while ((CAN1->RF0R & CAN_RF0R_FMP0) != 0U) {
+        CAN_FIFOMailBox_TypeDef *box = &CAN1->sFIFOMailBox[0];
+        const uint32_t rir = box->RIR;
+        // Filters only pass standard ids; be defensive.
+        CanBus_Frame_t *frame = ((rir & CAN_RI0R_IDE) == 0U) ? CanBus_RxReserve() : NULL;
+        if (frame != NULL) {
+            // Unpack straight into the queue slot.
+            const uint32_t dlr = box->RDLR;
+            const uint32_t dhr = box->RDHR;
+            const uint32_t dlc = box->RDTR & CAN_RDT0R_DLC;
+            frame->id = (rir >> CAN_RI0R_STID_Pos) & 0x7FFU;
+            frame->dlc = (uint8_t)((dlc > 8U) ? 8U : dlc);
+            for (uint32_t i = 0U; i < 4U; i++) {
+                frame->data[i] = (uint8_t)(dlr >> (8U * i));
+                frame->data[i + 4U] = (uint8_t)(dhr >> (8U * i));
+            }
+        }
+        // Release the FIFO slot; a full queue drops the frame here.
+        CAN1->RF0R = CAN_RF0R_RFOM0;
+        if (frame == NULL)
+            continue;
+
+        const uint8_t counter = frame->data[0];
+        const uint8_t dlc = frame->dlc;
+        if (CanBus_RxCommit() == CANBUS_EVENT_SYNC) {
+            // Without TIME follow-ups fall back to snapping the tick to SYNC.
+            if (!TimeSync_OnSyncRx((dlc > 0U) ? counter : 0U, now_us))
+                Peripheral_Sync_Align();
+        }
+    }
+}
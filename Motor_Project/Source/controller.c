@@ -1,11 +1,18 @@
 #include "controller.h"
+#include "axis.h"
+#include "trace.h"
 #include <stdint.h>
+#include <string.h>
 
 // This file implements a PI controller using ONLY integer math.
 // The controller output is in Q30 fixed-point format:
 //   +2^30-1  => +100% duty (full clockwise)
 //   -2^30    => -100% duty (full counter-clockwise)
 // The application calls Controller_PIController() periodically and provides time.
+// Each motor axis has its own controller state; gains are shared.
+// Sign changes of the reference go through the reversal manager (controller.h).
+// A thermal model of each winding derates the output limit (controller.h).
+// Manual mode and live gain changes are tracked by the integrator (controller.h).
 
 /* ===================== Units & scaling ===================== */
 
@@ -40,14 +47,70 @@ volatile int32_t INT_WINDOW_RPM = 200;
 // Clamp integrator to prevent overflow / windup (Q30 units)
 volatile int32_t I_CLAMP = 300000000;
 
+// Reversal manager (CONTROLLER_REV_*, see controller.h)
+volatile int32_t REV_MODE = CONTROLLER_REV_PI;
+
+// Current limit of plugging and bang-bang drive: control minus back-EMF,
+// Q30 (2^30 = stall current at full duty)
+volatile int32_t REV_I_LIMIT = 536870912;
+
+// Bang-bang hands over to PI this close to the new reference
+volatile int32_t REV_HANDOFF_RPM = 150;
+
+// Braking hands over to PI below this speed
+volatile int32_t REV_BRAKE_RPM = 100;
+
+// Lag of the velocity estimate, about half its window (g_vel_window_ms)
+volatile int32_t REV_LEAD_MS = 20;
+
+// A reversal not done after this long is handed over anyway
+#define REV_TIMEOUT_MS 1000U
+
+// Thermal model: current the winding can carry forever, Q30 of stall current
+volatile int32_t THERM_I_CONT = 429496730;
+
+// Thermal time constant of the winding (ms)
+volatile int32_t THERM_TAU_MS = 60000;
+
+// Derating starts at this heat, Q30 of the limit
+volatile int32_t THERM_DERATE_AT = 858993459;
+
+// Heat input is capped here (Q30, 4x the limit) so the state stays in 32 bits
+#define THERM_HEAT_MAX 0xFFFFFFFFU
+
+// Manual mode: bit n puts axis n on MANUAL_DUTY[n] (Q30) instead of the PI law
+volatile int32_t MANUAL_AXES = 0;
+volatile int32_t MANUAL_DUTY[AXIS_MAX];
+
 /* ===================== Controller state ===================== */
 
-// Integrator state in Q30
-static int32_t integrator = 0;
-// Time of previous control update (ms)
-static uint32_t last_update_ms = 0;
-// Used to force "first call after reset returns 0"
-static uint8_t first_call = 1;
+// Per-axis state, laid out as structure-of-arrays.
+static struct {
+    // Integrator state in Q30
+    int32_t integrator[AXIS_COUNT];
+    // Time of previous control update (ms)
+    uint32_t last_update_ms[AXIS_COUNT];
+    // Cleared to force "first call after reset returns 0" (zero-init = reset)
+    uint8_t started[AXIS_COUNT];
+    // Reversal manager: strategy in progress, time spent in it (ms), last
+    // reference and measurement, settled integrator per direction (0 = CW)
+    uint8_t rev_state[AXIS_COUNT];
+    uint32_t rev_ms[AXIS_COUNT];
+    int32_t rev_ref[AXIS_COUNT];
+    int32_t rev_meas[AXIS_COUNT];
+    int32_t rev_settled[AXIS_COUNT][2];
+    uint8_t rev_seen[AXIS_COUNT][2];
+    // Thermal model: winding heat (Q30 of the limit) and the output applied
+    // since the last tick (Controller_SetApplied, else the controller's own)
+    uint32_t heat[AXIS_COUNT];
+    int32_t last_out[AXIS_COUNT];
+    // Output range the thermal limit allowed this tick (Controller_ThermalLimit)
+    int32_t out_lo[AXIS_COUNT];
+    int32_t out_hi[AXIS_COUNT];
+    // Kp and U_PER_RPM the integrator was last tracked against
+    int32_t track_kp[AXIS_COUNT];
+    int32_t track_ff[AXIS_COUNT];
+} pi;
 
 /* ===================== Helpers ===================== */
 
@@ -61,6 +124,15 @@ static inline int32_t sat_ctrl(int64_t x) {
     return (int32_t)x;
 }
 
+// Saturate to [lo, hi], a range within the controller output range.
+static inline int32_t sat_limit(int64_t x, int64_t lo, int64_t hi) {
+    if (x > hi)
+        return (int32_t)hi;
+    if (x < lo)
+        return (int32_t)lo;
+    return (int32_t)x;
+}
+
 // Clamp to signed 16-bit range used by Q15.
 static inline int32_t clamp_q15(int64_t x) {
     if (x > 32767)
@@ -87,30 +159,180 @@ static inline int32_t clamp_i32(int32_t x, int32_t lo, int32_t hi) {
     return x;
 }
 
+/* ===================== Reversal manager ===================== */
+
+static inline uint8_t rev_dir(int32_t rpm) {
+    return (uint8_t)(rpm < 0);
+}
+
+// Current-limited drive towards the sign of dir: back-EMF plus the limit.
+static inline int32_t rev_drive(int32_t speed_rpm, int32_t dir) {
+    const int64_t bemf = (int64_t)U_PER_RPM * (int64_t)speed_rpm;
+    return sat_ctrl(bemf + ((dir < 0) ? -(int64_t)REV_I_LIMIT : (int64_t)REV_I_LIMIT));
+}
+
+// Hand over to the PI law with the integrator at its settled value.
+static void rev_handoff(uint8_t axis, int32_t ref_rpm) {
+    const uint8_t dir = rev_dir(ref_rpm);
+    int32_t preload = 0;
+    if (pi.rev_seen[axis][dir])
+        preload = pi.rev_settled[axis][dir];
+    else if (pi.rev_seen[axis][dir ^ 1U])
+        preload = -pi.rev_settled[axis][dir ^ 1U];
+    pi.integrator[axis] = clamp_i32(preload, -I_CLAMP, I_CLAMP);
+    pi.rev_state[axis] = CONTROLLER_REV_PI;
+    Trace_Event(TRACE_REVERSAL_DONE, axis, pi.rev_ms[axis]);
+}
+
+// Start a reversal on a reference sign change, or advance one; stores the
+// output to apply and returns 1 while the manager drives the axis.
+static uint8_t rev_step(uint8_t axis, int32_t ref_rpm, int32_t meas_rpm, uint32_t delta_ms, int32_t *out) {
+    // Where the speed will be when the next output takes over: the lagging
+    // estimate extrapolated over its lag and one more tick.
+    const int64_t slope = (int64_t)meas_rpm - (int64_t)pi.rev_meas[axis];
+    const int64_t pred64 = (int64_t)meas_rpm + (slope * ((int64_t)REV_LEAD_MS + (int64_t)delta_ms)) / (int64_t)delta_ms;
+    const int32_t pred = (int32_t)((pred64 > INT32_MAX) ? INT32_MAX : (pred64 < -INT32_MAX) ? -INT32_MAX : pred64);
+    pi.rev_meas[axis] = meas_rpm;
+
+    const int32_t last_ref = pi.rev_ref[axis];
+    pi.rev_ref[axis] = ref_rpm;
+    if ((ref_rpm ^ last_ref) < 0 && ref_rpm != 0 && last_ref != 0) {
+        // Keep where the integrator settled, unless a reversal was cut short.
+        if (pi.rev_state[axis] == CONTROLLER_REV_PI) {
+            const uint8_t dir = rev_dir(last_ref);
+            pi.rev_settled[axis][dir] = pi.integrator[axis];
+            pi.rev_seen[axis][dir] = 1U;
+        }
+        const int32_t mode = REV_MODE;
+        pi.rev_state[axis] = (mode > CONTROLLER_REV_PI && mode <= CONTROLLER_REV_BANGBANG) ? (uint8_t)mode : CONTROLLER_REV_PI;
+        pi.rev_ms[axis] = 0U;
+        if (pi.rev_state[axis] == CONTROLLER_REV_PI)
+            return 0;
+    }
+    if (pi.rev_state[axis] == CONTROLLER_REV_PI)
+        return 0;
+
+    pi.rev_ms[axis] += delta_ms;
+    uint8_t done = pi.rev_ms[axis] >= REV_TIMEOUT_MS;
+    switch (pi.rev_state[axis]) {
+    case CONTROLLER_REV_BRAKE:
+        // Both low sides on: the motor shorts its own back-EMF.
+        done |= iabs32(pred) <= REV_BRAKE_RPM;
+        *out = 0;
+        break;
+    case CONTROLLER_REV_PLUG:
+        // Against the old rotation until it has turned.
+        done |= (pred ^ ref_rpm) >= 0;
+        *out = rev_drive(pred, ref_rpm);
+        break;
+    default:
+        // Full (current-limited) drive until just short of the new speed.
+        done |= ((ref_rpm > 0) ? (int64_t)ref_rpm - pred : (int64_t)pred - ref_rpm) <= (int64_t)REV_HANDOFF_RPM;
+        *out = rev_drive(pred, ref_rpm);
+        break;
+    }
+    if (done) {
+        rev_handoff(axis, ref_rpm);
+        return 0;
+    }
+    return 1;
+}
+
+/* ===================== Thermal model ===================== */
+
+// Advance the heat of one axis over delta_ms and return the current limit
+// it allows: control minus back-EMF, Q30, unlimited (2^31) below
+// THERM_DERATE_AT, falling linearly to THERM_I_CONT at the limit so the heat
+// settles there instead of rising further.
+static int64_t therm_step(uint8_t axis, int32_t meas_rpm, uint32_t delta_ms) {
+    // Current over the last tick: the duty that reached the bridge (after the
+    // drive ramp and the stall detector) minus the back-EMF.
+    const int64_t bemf = (int64_t)U_PER_RPM * (int64_t)meas_rpm;
+    int64_t current = (int64_t)pi.last_out[axis] - bemf;
+    if (current > ((int64_t)1 << (CTRL_Q + 1)))
+        current = (int64_t)1 << (CTRL_Q + 1);
+    if (current < -((int64_t)1 << (CTRL_Q + 1)))
+        current = -((int64_t)1 << (CTRL_Q + 1));
+
+    // Heat input (I / I_cont)^2 in Q30, first-order towards it.
+    const int64_t i_cont = (THERM_I_CONT > 0) ? (int64_t)THERM_I_CONT : 1;
+    const int64_t i2 = (current * current) >> CTRL_Q;
+    int64_t input = (i2 << CTRL_Q) / (((i_cont * i_cont) >> CTRL_Q) | 1);
+    if (input > (int64_t)THERM_HEAT_MAX)
+        input = (int64_t)THERM_HEAT_MAX;
+    const int64_t tau = (THERM_TAU_MS > (int32_t)delta_ms) ? (int64_t)THERM_TAU_MS : (int64_t)delta_ms;
+    const int64_t heat = (int64_t)pi.heat[axis];
+    pi.heat[axis] = (uint32_t)(heat + ((input - heat) * (int64_t)delta_ms) / tau);
+
+    const int64_t full = (int64_t)1 << (CTRL_Q + 1);
+    const int64_t start = (int64_t)THERM_DERATE_AT;
+    const int64_t limit = (int64_t)1 << CTRL_Q;
+    const int64_t now = (int64_t)pi.heat[axis];
+    if (now <= start)
+        return full;
+    if (now >= limit || start >= limit)
+        return i_cont;
+    return full - ((full - i_cont) * (now - start)) / (limit - start);
+}
+
 /* ===================== API ===================== */
 
 int32_t Controller_PIController(const int32_t *reference,
                                 const int32_t *measured,
                                 const uint32_t *millisec) {
+    return Controller_PIControllerAxis(0, reference, measured, millisec);
+}
+
+int32_t Controller_PIControllerAxis(uint8_t axis,
+                                    const int32_t *reference,
+                                    const int32_t *measured,
+                                    const uint32_t *millisec) {
     // First call after reset must return zero and initialize state.
-    if (first_call) {
-        first_call = 0;
-        last_update_ms = *millisec;
-        integrator = 0;
+    if (!pi.started[axis]) {
+        pi.started[axis] = 1;
+        pi.last_update_ms[axis] = *millisec;
+        pi.integrator[axis] = 0;
+        pi.rev_ref[axis] = *reference;
+        pi.rev_meas[axis] = *measured;
+        pi.last_out[axis] = 0;
+        pi.out_lo[axis] = 0;
+        pi.out_hi[axis] = 0;
+        pi.track_kp[axis] = Kp;
+        pi.track_ff[axis] = U_PER_RPM;
         return 0;
     }
 
     // Compute elapsed time (ms) since last controller update.
     // Unsigned subtraction handles timer wrap-around correctly.
     const uint32_t now_ms = *millisec;
-    const uint32_t delta_ms = now_ms - last_update_ms;
-    last_update_ms = now_ms;
-    if (delta_ms == 0U)
+    const uint32_t delta_ms = now_ms - pi.last_update_ms[axis];
+    pi.last_update_ms[axis] = now_ms;
+    if (delta_ms == 0U) {
+        pi.last_out[axis] = 0;
+        pi.out_lo[axis] = 0;
+        pi.out_hi[axis] = 0;
         return 0; // avoid divide-by-zero and double-update
+    }
 
     // Read inputs once (pass-by-reference in API).
     const int32_t ref_rpm = *reference;
     const int32_t meas_rpm = *measured;
+
+    // Thermal model: the output may not push more than i_limit through the
+    // winding, so it stays within i_limit of the back-EMF.
+    const int64_t i_limit = therm_step(axis, meas_rpm, delta_ms);
+    const int64_t bemf = (int64_t)U_PER_RPM * (int64_t)meas_rpm;
+    int64_t out_hi = bemf + i_limit;
+    int64_t out_lo = bemf - i_limit;
+    if (out_hi > (int64_t)CTRL_MAX)
+        out_hi = CTRL_MAX;
+    if (out_lo < (int64_t)CTRL_MIN)
+        out_lo = CTRL_MIN;
+    if (out_lo > out_hi)
+        out_lo = out_hi;
+    pi.out_lo[axis] = (int32_t)out_lo;
+    pi.out_hi[axis] = (int32_t)out_hi;
+
     int32_t err_rpm = ref_rpm - meas_rpm;
 
     // Deadband for noise
@@ -123,10 +345,44 @@ int32_t Controller_PIController(const int32_t *reference,
 
     // Feedforward (set U_PER_RPM = 0 to disable)
     // Units: (Q30 per RPM) * RPM = Q30
-    const int32_t ff = sat_ctrl((int64_t)U_PER_RPM * (int64_t)ref_rpm);
+    const int32_t u_per_rpm = U_PER_RPM;
+    const int32_t ff = sat_ctrl((int64_t)u_per_rpm * (int64_t)ref_rpm);
 
     // P term: Q15 * Q15 -> Q30
-    const int32_t p_term = sat_ctrl((int64_t)Kp * (int64_t)err_q15);
+    const int32_t kp = Kp;
+    const int32_t p_term = sat_ctrl((int64_t)kp * (int64_t)err_q15);
+
+    // Live gain change: the integrator takes up what the new Kp and U_PER_RPM
+    // change in the P and feedforward terms at this error, so the output
+    // carries on from where it was. (Ki needs nothing: it scales each
+    // increment, not the sum.)
+    if (kp != pi.track_kp[axis] || u_per_rpm != pi.track_ff[axis]) {
+        const int64_t ff_was = sat_ctrl((int64_t)pi.track_ff[axis] * (int64_t)ref_rpm);
+        const int64_t p_was = sat_ctrl((int64_t)pi.track_kp[axis] * (int64_t)err_q15);
+        const int64_t tracked = (int64_t)pi.integrator[axis] + ff_was + p_was - ff - p_term;
+        pi.integrator[axis] = clamp_i32(sat_ctrl(tracked), -I_CLAMP, I_CLAMP);
+        pi.track_kp[axis] = kp;
+        pi.track_ff[axis] = u_per_rpm;
+    }
+
+    // Manual mode: apply the operator's duty and back-calculate the
+    // integrator from it, so the PI law takes over without a jump.
+    if (((uint32_t)MANUAL_AXES >> axis) & 1U) {
+        const int32_t out = sat_limit(MANUAL_DUTY[axis], out_lo, out_hi);
+        pi.integrator[axis] = clamp_i32(sat_ctrl((int64_t)out - ff - p_term), -I_CLAMP, I_CLAMP);
+        // No reversal is pending when the PI law takes over.
+        pi.rev_state[axis] = CONTROLLER_REV_PI;
+        pi.rev_ref[axis] = ref_rpm;
+        pi.rev_meas[axis] = meas_rpm;
+        pi.last_out[axis] = out;
+        return out;
+    }
+
+    // Reversal manager: may preload the integrator, or drive the axis itself.
+    int32_t rev_out = 0;
+    const uint8_t reversing = rev_step(axis, ref_rpm, meas_rpm, delta_ms, &rev_out);
+
+    const int32_t integrator = pi.integrator[axis];
 
     // I update only when close enough (reduces windup on large steps)
     int32_t integrator_candidate = integrator;
@@ -140,26 +396,69 @@ int32_t Controller_PIController(const int32_t *reference,
 
     // Anti-windup: only commit I when output does not saturate further
     const int64_t ctrl_candidate = (int64_t)ff + (int64_t)p_term + (int64_t)integrator_candidate;
-    const int32_t ctrl_sat = sat_ctrl(ctrl_candidate);
+    const int32_t ctrl_sat = sat_limit(ctrl_candidate, out_lo, out_hi);
     if ((int64_t)ctrl_sat == ctrl_candidate) {
         // Not saturated -> accept integrator update.
-        integrator = integrator_candidate;
+        pi.integrator[axis] = integrator_candidate;
     } else {
+        Trace_Event(TRACE_SATURATION, axis, (uint32_t)sat_ctrl(ctrl_candidate - (int64_t)ctrl_sat));
         // Saturated: only accept I if it moves away from saturation.
         const uint8_t pushes_further =
-            (ctrl_candidate > (int64_t)CTRL_MAX && err_q15 > 0) ||
-            (ctrl_candidate < (int64_t)CTRL_MIN && err_q15 < 0);
+            (ctrl_candidate > out_hi && err_q15 > 0) ||
+            (ctrl_candidate < out_lo && err_q15 < 0);
         if (!pushes_further)
-            integrator = integrator_candidate;
+            pi.integrator[axis] = integrator_candidate;
     }
 
-    // Final control output (Q30).
-    return sat_ctrl((int64_t)ff + (int64_t)p_term + (int64_t)integrator);
+    // Final control output (Q30), within the thermal limit.
+    const int32_t out = reversing ? sat_limit(rev_out, out_lo, out_hi)
+                                  : sat_limit((int64_t)ff + (int64_t)p_term + (int64_t)pi.integrator[axis], out_lo, out_hi);
+    pi.last_out[axis] = out;
+    return out;
+}
+
+void Controller_SetApplied(uint8_t axis, int32_t applied) {
+    pi.last_out[axis] = applied;
+}
+
+int32_t Controller_ThermalLimit(uint8_t axis, int32_t out) {
+    return sat_limit(out, pi.out_lo[axis], pi.out_hi[axis]);
+}
+
+uint8_t Controller_Reversal(uint8_t axis) {
+    return pi.rev_state[axis];
+}
+
+uint16_t Controller_Thermal(uint8_t axis) {
+    const uint64_t permille = ((uint64_t)pi.heat[axis] * 1000U) >> CTRL_Q;
+    return (uint16_t)((permille > 0xFFFFU) ? 0xFFFFU : permille);
+}
+
+uint32_t Controller_SaveState(void *dst, uint32_t size) {
+    if (size < sizeof(pi))
+        return 0U;
+    memcpy(dst, &pi, sizeof(pi));
+    return (uint32_t)sizeof(pi);
+}
+
+uint8_t Controller_RestoreState(const void *src, uint32_t size) {
+    if (size != sizeof(pi))
+        return 0;
+    memcpy(&pi, src, sizeof(pi));
+    return 1;
 }
 
 void Controller_Reset(void) {
-    // Reset internal state so the next PI call returns 0 once.
-    integrator = 0;
-    last_update_ms = 0;
-    first_call = 1;
+    // Reset internal state so the next PI call returns 0 once. The winding
+    // heat is kept: a reset does not cool the motor.
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        pi.integrator[axis] = 0;
+        pi.last_update_ms[axis] = 0;
+        pi.started[axis] = 0;
+        pi.rev_state[axis] = CONTROLLER_REV_PI;
+        pi.rev_ms[axis] = 0U;
+        pi.rev_seen[axis][0] = 0U;
+        pi.rev_seen[axis][1] = 0U;
+        pi.last_out[axis] = 0;
+    }
 }
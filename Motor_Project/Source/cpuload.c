@@ -0,0 +1,141 @@
+// cpuload.c
+#define LOG_FILE_ID 6
+#include "cpuload.h"
+#include "irq.h"
+#include "log.h"
+#include "peripherals.h"
+#include <stdint.h>
+
+// This file implements the CPU load accounting of cpuload.h:
+//  - a context switch charges the cycles since the previous one to the
+//    context that ran, under Irq_Lock so a preempting handler cannot split
+//    the read-charge-update sequence
+//  - thread-mode cycles are held back until the main loop pass ends and then
+//    charged to thread or idle, depending on whether the pass did work
+//  - busy = elapsed - idle; cycles still held back count as busy, which
+//    overstates the load by at most one loop pass
+
+CpuLoad_t g_cpuload;
+
+static struct {
+    uint8_t current;						// Context being charged.
+    uint32_t last;							// Cycle counter at the last switch.
+    uint32_t thread;						// Cycles of the current main loop pass.
+    uint32_t tick_start;					// Cycle counter at the last tick.
+    uint32_t tick_idle;						// Idle cycles at the last tick.
+    uint32_t window_start;					// Cycle counter at the window start.
+    uint32_t window_cycles[CPULOAD_CONTEXTS];	// Cycles of each context at the window start.
+    uint32_t ticks;							// Ticks in the current window.
+    uint32_t ticks_per_window;
+    uint32_t peak;							// Worst tick load in the current window.
+    uint32_t reported;						// Windows logged.
+} cl;
+
+// Charge the cycles since the last switch to the running context.
+static inline void charge(uint32_t now) {
+    const uint32_t cycles = now - cl.last;
+    if (cl.current == CPULOAD_THREAD)
+        cl.thread += cycles;
+    else
+        g_cpuload.cycles[cl.current] += cycles;
+    cl.last = now;
+}
+
+// Share of part in whole, permille.
+static uint32_t permille(uint32_t part, uint32_t whole) {
+    if (whole == 0U)
+        return 0U;
+    if (part > whole)
+        part = whole;
+    return (uint32_t)(((uint64_t)part * 1000U) / whole);
+}
+
+void CpuLoad_Init(uint32_t tick_ms) {
+    const uint32_t basepri = Irq_Lock();
+    const uint32_t now = Peripheral_Cycles_Now();
+    g_cpuload = (CpuLoad_t){0};
+    cl.current = CPULOAD_THREAD;
+    cl.last = now;
+    cl.thread = 0U;
+    cl.tick_start = now;
+    cl.tick_idle = 0U;
+    cl.window_start = now;
+    for (uint8_t c = 0U; c < CPULOAD_CONTEXTS; c++)
+        cl.window_cycles[c] = 0U;
+    cl.ticks = 0U;
+    cl.ticks_per_window = (tick_ms != 0U && tick_ms < CPULOAD_WINDOW_MS) ? CPULOAD_WINDOW_MS / tick_ms : 1U;
+    cl.peak = 0U;
+    cl.reported = 0U;
+    Irq_Unlock(basepri);
+}
+
+uint8_t CpuLoad_Enter(uint8_t context) {
+    const uint32_t basepri = Irq_Lock();
+    charge(Peripheral_Cycles_Now());
+    const uint8_t previous = cl.current;
+    cl.current = context;
+    Irq_Unlock(basepri);
+    return previous;
+}
+
+void CpuLoad_Exit(uint8_t previous) {
+    const uint32_t basepri = Irq_Lock();
+    charge(Peripheral_Cycles_Now());
+    cl.current = previous;
+    Irq_Unlock(basepri);
+}
+
+void CpuLoad_Thread(uint8_t busy) {
+    const uint32_t basepri = Irq_Lock();
+    charge(Peripheral_Cycles_Now());
+    g_cpuload.cycles[busy ? CPULOAD_THREAD : CPULOAD_IDLE] += cl.thread;
+    cl.thread = 0U;
+    Irq_Unlock(basepri);
+}
+
+void CpuLoad_Tick(void) {
+    const uint32_t basepri = Irq_Lock();
+    const uint32_t now = Peripheral_Cycles_Now();
+    charge(now);
+
+    // Tick window
+    const uint32_t elapsed = now - cl.tick_start;
+    const uint32_t idle = g_cpuload.cycles[CPULOAD_IDLE] - cl.tick_idle;
+    const uint32_t tick_load = 1000U - permille(idle, elapsed);
+    cl.tick_start = now;
+    cl.tick_idle = g_cpuload.cycles[CPULOAD_IDLE];
+    g_cpuload.tick_load = tick_load;
+    if (tick_load > cl.peak)
+        cl.peak = tick_load;
+    if (tick_load > g_cpuload.tick_peak_max)
+        g_cpuload.tick_peak_max = tick_load;
+
+    // Utilisation window
+    if (++cl.ticks >= cl.ticks_per_window) {
+        const uint32_t window = now - cl.window_start;
+        for (uint8_t c = 0U; c < CPULOAD_CONTEXTS; c++) {
+            g_cpuload.share[c] = permille(g_cpuload.cycles[c] - cl.window_cycles[c], window);
+            cl.window_cycles[c] = g_cpuload.cycles[c];
+        }
+        g_cpuload.load = 1000U - g_cpuload.share[CPULOAD_IDLE];
+        g_cpuload.tick_peak = cl.peak;
+        g_cpuload.windows++;
+        cl.window_start = now;
+        cl.ticks = 0U;
+        cl.peak = 0U;
+    }
+    Irq_Unlock(basepri);
+}
+
+void CpuLoad_Report(void) {
+    if (g_cpuload.windows == cl.reported)
+        return;
+    // Copy under the lock so both lines describe the same window.
+    const uint32_t basepri = Irq_Lock();
+    const CpuLoad_t load = g_cpuload;
+    cl.reported = load.windows;
+    Irq_Unlock(basepri);
+
+    LOG4("cpu: load %u permille, tick peak %u, fast %u, tick %u", load.load, load.tick_peak, load.share[CPULOAD_FAST], load.share[CPULOAD_TICK]);
+    LOG4("cpu: background %u, CAN %u, SysTick %u, thread %u permille", load.share[CPULOAD_BACKGROUND], load.share[CPULOAD_CAN], load.share[CPULOAD_SYSTICK], load.share[CPULOAD_THREAD]);
+}
@@ -0,0 +1,123 @@
+// drive.c
+#define LOG_FILE_ID 8
+#include "drive.h"
+#include "log.h"
+#include "peripherals.h"
+#include "watchdog.h"
+#include <stdint.h>
+
+// This file implements the drive state machine of drive.h:
+//  - the bridge is switched only here, with the GPIO API of peripherals.h,
+//    on entering a state; the watchdog keeps its own direct path to it
+//  - the ramp gain moves by GAIN_ONE * delta / ramp time per tick, so a
+//    STOPPING entered halfway up the enable ramp only ramps out what it has
+//  - a ramp time of zero steps the gain in one tick
+
+Drive_Config_t g_drive_cfg = {
+    .precharge_ms = 20U,
+    .enable_ms = 200U,
+    .disable_ms = 200U,
+    .recover_ms = 100U,
+};
+Drive_Axis_t g_drive[AXIS_COUNT];
+
+static uint32_t last_ms[AXIS_COUNT];	// Tick time of the last Drive_Tick
+
+void Drive_Init(void) {
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        Peripheral_GPIO_DisableMotorAxis(axis);
+        g_drive[axis] = (Drive_Axis_t){0};
+        last_ms[axis] = 0U;
+    }
+}
+
+void Drive_Enable(uint8_t axis) {
+    g_drive[axis].enable = 1U;
+}
+
+void Drive_Disable(uint8_t axis) {
+    g_drive[axis].enable = 0U;
+}
+
+void Drive_Fault(uint8_t axis, uint8_t cause) {
+    Peripheral_GPIO_DisableMotorAxis(axis);
+    g_drive[axis].faults |= cause;
+}
+
+void Drive_ClearFault(uint8_t axis, uint8_t cause) {
+    g_drive[axis].faults &= (uint8_t)~cause;
+}
+
+// Take a transition: switch the bridge for the new state and log it.
+static void enter(uint8_t axis, uint8_t state, uint32_t millisec) {
+    Drive_Axis_t *d = &g_drive[axis];
+    LOG4("drive: axis %u state %u -> %u at %u ms", axis, d->state, state, millisec);
+    if (state == DRIVE_PRECHARGE)
+        Peripheral_GPIO_EnableMotorAxis(axis);
+    else if (state != DRIVE_READY && state != DRIVE_ENABLED && state != DRIVE_STOPPING)
+        Peripheral_GPIO_DisableMotorAxis(axis);
+    if (state != DRIVE_ENABLED && state != DRIVE_STOPPING)
+        d->gain = 0U;
+    d->state = state;
+    d->since_ms = millisec;
+    d->transitions++;
+}
+
+// Gain step of a ramp over ramp_ms for delta_ms.
+static uint32_t ramp_step(uint32_t delta_ms, uint32_t ramp_ms) {
+    if (ramp_ms <= delta_ms)
+        return DRIVE_GAIN_ONE;
+    return (DRIVE_GAIN_ONE * delta_ms + ramp_ms - 1U) / ramp_ms;
+}
+
+int32_t Drive_Tick(uint8_t axis, int32_t control, uint32_t millisec) {
+    Drive_Axis_t *d = &g_drive[axis];
+    const uint32_t delta_ms = millisec - last_ms[axis];
+    const uint32_t in_state = millisec - d->since_ms;
+    last_ms[axis] = millisec;
+
+    if (g_watchdog.fault != 0U)
+        d->faults |= DRIVE_FAULT_WATCHDOG;
+
+    // One transition per tick: fault, then disable, then enable, then timers.
+    const uint8_t state = d->state;
+    if (d->faults != 0U) {
+        if (state != DRIVE_FAULT)
+            enter(axis, DRIVE_FAULT, millisec);
+    } else if (state == DRIVE_FAULT) {
+        enter(axis, DRIVE_RECOVERING, millisec);
+    } else if (state == DRIVE_RECOVERING) {
+        if (in_state >= g_drive_cfg.recover_ms)
+            enter(axis, d->enable ? DRIVE_PRECHARGE : DRIVE_DISABLED, millisec);
+    } else if (!d->enable) {
+        if (state == DRIVE_ENABLED)
+            enter(axis, DRIVE_STOPPING, millisec);
+        else if (state == DRIVE_PRECHARGE || state == DRIVE_READY)
+            enter(axis, DRIVE_DISABLED, millisec);
+        else if (state == DRIVE_STOPPING && d->gain == 0U)
+            enter(axis, DRIVE_DISABLED, millisec);
+    } else {
+        if (state == DRIVE_DISABLED)
+            enter(axis, DRIVE_PRECHARGE, millisec);
+        else if (state == DRIVE_PRECHARGE && in_state >= g_drive_cfg.precharge_ms)
+            enter(axis, DRIVE_READY, millisec);
+        else if (state == DRIVE_READY || state == DRIVE_STOPPING)
+            enter(axis, DRIVE_ENABLED, millisec);
+    }
+
+    // Ramp the gain of the state the axis is in now.
+    uint32_t gain = d->gain;
+    if (d->state == DRIVE_ENABLED) {
+        gain += ramp_step(delta_ms, g_drive_cfg.enable_ms);
+        if (gain > DRIVE_GAIN_ONE)
+            gain = DRIVE_GAIN_ONE;
+    } else if (d->state == DRIVE_STOPPING) {
+        const uint32_t step = ramp_step(delta_ms, g_drive_cfg.disable_ms);
+        gain = (gain > step) ? gain - step : 0U;
+    }
+    d->gain = (uint16_t)gain;
+
+    if (gain >= DRIVE_GAIN_ONE)
+        return control;
+    return (int32_t)(((int64_t)control * (int64_t)gain) >> 15);
+}
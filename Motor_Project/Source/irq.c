@@ -0,0 +1,151 @@
+// irq.c
+#define LOG_FILE_ID 4
+#include "irq.h"
+#include "log.h"
+#include "main.h"
+#include <stdint.h>
+
+// This file implements the interrupt layers of irq.h:
+//  - priorities of the tick and background layers, and their pend calls
+//  - per-layer entry latency: the fast layer passes in its timer count, the
+//    pended layers use the cycle counter stamp taken when they were pended
+//  - sampled stack use: every IRQ_STACK_SAMPLE-th entry paints the free
+//    stack below the handler, and the exit finds the deepest word touched.
+//    Only one layer measures at a time, so a nested measurement cannot paint
+//    over the marks of the one it preempted. The fast layer never measures:
+//    a scan and repaint of up to the whole stack does not fit its PWM
+//    period, and its use still shows in the high-water mark below.
+//  - whole main stack high-water mark: painted once by Irq_Init, and every
+//    sampled repaint first folds the deepest word touched so far into it
+
+_Static_assert(TICK_INT_PRIORITY == IRQ_PRIO_SYSTICK, "SysTick priority is set in stm32l4xx_hal_conf.h");
+_Static_assert(IRQ_PRIO_BACKGROUND < (1U << __NVIC_PRIO_BITS), "priority out of range");
+
+Irq_Layer_t g_irq[IRQ_LAYERS];
+Irq_Stack_t g_irq_stack;
+
+// Stack use reported so far, to log only new worst cases.
+static uint32_t reported_latency[IRQ_LAYERS];
+static uint32_t reported_stack[IRQ_LAYERS];
+static uint32_t reported_used;
+
+// Deepest main stack word known to have been written, from earlier paints.
+static uint32_t deepest_seen;
+
+static volatile uint8_t probing;
+
+/* ----------------- Stack measurement ----------------- */
+
+// Lowest address of the main stack, from the initial SP in the vector table.
+static inline uint32_t *stack_base(void) {
+    return (uint32_t *)(*(const uint32_t *)SCB->VTOR - IRQ_STACK_BYTES);
+}
+
+// Lowest stack address written since stack_paint.
+static uint32_t stack_deepest(void) {
+    const uint32_t *p = stack_base();
+    while (*p == IRQ_STACK_PAINT)
+        p++;
+    return (uint32_t)p;
+}
+
+// Keep the marks of the last paint in deepest_seen before painting over them.
+static void stack_fold(void) {
+    const uint32_t deepest = stack_deepest();
+    if (deepest < deepest_seen)
+        deepest_seen = deepest;
+}
+
+// Paint everything below the current stack pointer; returns that pointer.
+static uint32_t stack_paint(void) {
+    const uint32_t sp = __get_MSP();
+    for (uint32_t *p = stack_base(); p < (uint32_t *)sp; p++)
+        *p = IRQ_STACK_PAINT;
+    return sp;
+}
+
+/* ----------------- Layers ----------------- */
+void Irq_Init(void) {
+    for (uint8_t layer = 0U; layer < IRQ_LAYERS; layer++) {
+        g_irq[layer] = (Irq_Layer_t){0};
+        reported_latency[layer] = 0U;
+        reported_stack[layer] = 0U;
+    }
+    reported_used = 0U;
+
+    g_irq_stack = (Irq_Stack_t){0};
+    // Everything above the caller counts as used from the start.
+    deepest_seen = stack_paint();
+    probing = 0U;
+
+    HAL_NVIC_SetPriority(PendSV_IRQn, IRQ_PRIO_BACKGROUND, 0);
+    HAL_NVIC_SetPriority(IRQ_TICK_IRQn, IRQ_PRIO_TICK, 0);
+    HAL_NVIC_EnableIRQ(IRQ_TICK_IRQn);
+}
+
+void Irq_PendTick(void) {
+    Irq_Layer_t *l = &g_irq[IRQ_LAYER_TICK];
+    // Still pending or still running from the last trigger: a tick is lost.
+    if (NVIC_GetPendingIRQ(IRQ_TICK_IRQn) != 0U || NVIC_GetActive(IRQ_TICK_IRQn) != 0U)
+        l->overruns++;
+    l->pended_at = DWT->CYCCNT;
+    NVIC_SetPendingIRQ(IRQ_TICK_IRQn);
+}
+
+void Irq_PendBackground(void) {
+    Irq_Layer_t *l = &g_irq[IRQ_LAYER_BACKGROUND];
+    if ((SCB->ICSR & SCB_ICSR_PENDSVSET_Msk) != 0U)
+        l->overruns++;
+    l->pended_at = DWT->CYCCNT;
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+uint32_t Irq_Enter(uint8_t layer, uint32_t latency) {
+    Irq_Layer_t *l = &g_irq[layer];
+    if (latency == UINT32_MAX)
+        latency = DWT->CYCCNT - l->pended_at;
+    l->latency = latency;
+    if (latency > l->latency_max)
+        l->latency_max = latency;
+    const uint32_t entries = l->entries + 1U;
+    l->entries = entries;
+
+    if (IRQ_STACK_SAMPLE == 0U || layer == IRQ_LAYER_FAST || (entries % IRQ_STACK_SAMPLE) != 0U || probing)
+        return 0U;
+    probing = 1U;
+    stack_fold();
+    return stack_paint();
+}
+
+void Irq_Exit(uint8_t layer, uint32_t token) {
+    if (token == 0U)
+        return;
+    const uint32_t used = token - stack_deepest();
+    if (used > g_irq[layer].stack_max)
+        g_irq[layer].stack_max = used;
+    probing = 0U;
+}
+
+void Irq_Report(void) {
+    // Probes may repaint meanwhile; they only ever lower deepest_seen.
+    uint32_t deepest = stack_deepest();
+    if (deepest_seen < deepest)
+        deepest = deepest_seen;
+    const uint32_t top = (uint32_t)stack_base() + IRQ_STACK_BYTES;
+    const uint32_t used = top - deepest;
+    g_irq_stack.used_max = used;
+    g_irq_stack.free_min = IRQ_STACK_BYTES - used;
+    if (used > reported_used) {
+        reported_used = used;
+        LOG2("irq: main stack high-water %u of %u bytes", used, IRQ_STACK_BYTES);
+    }
+
+    for (uint8_t layer = 0U; layer < IRQ_LAYERS; layer++) {
+        const Irq_Layer_t *l = &g_irq[layer];
+        if (l->latency_max == reported_latency[layer] && l->stack_max == reported_stack[layer])
+            continue;
+        reported_latency[layer] = l->latency_max;
+        reported_stack[layer] = l->stack_max;
+        LOG4("irq: layer %u worst latency %u cycles, stack %u bytes, overruns %u", layer, reported_latency[layer], reported_stack[layer], l->overruns);
+    }
+}
@@ -0,0 +1,105 @@
+// lockfree.c
+#include "lockfree.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// This file provides the lock-free exchange primitives:
+//  - an SPSC ring with in-place reserve/commit and peek/release
+//  - a sequence lock for snapshots larger than one word
+// Indices are free-running 32-bit counters; head - tail is the fill level
+// even across wrap-around.
+
+/* ----------------- Ring ----------------- */
+
+uint8_t Ring_Init(Ring_t *ring, void *storage, uint32_t size, uint32_t count) {
+    if (count == 0U || (count & (count - 1U)) != 0U)
+        return 0;
+    ring->buf = (uint8_t *)storage;
+    ring->size = size;
+    ring->mask = count - 1U;
+    atomic_store_explicit(&ring->head, 0U, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, 0U, memory_order_relaxed);
+    return 1;
+}
+
+void *Ring_Reserve(Ring_t *ring) {
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    // Acquire pairs with Ring_Release: the consumer is done with the slot.
+    const uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail > ring->mask)
+        return NULL; // full
+    return &ring->buf[(head & ring->mask) * ring->size];
+}
+
+void Ring_Commit(Ring_t *ring) {
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    // Release: the slot contents are visible before the new head.
+    atomic_store_explicit(&ring->head, head + 1U, memory_order_release);
+}
+
+const void *Ring_Peek(Ring_t *ring) {
+    const uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    // Acquire pairs with Ring_Commit.
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail)
+        return NULL; // empty
+    return &ring->buf[(tail & ring->mask) * ring->size];
+}
+
+void Ring_Release(Ring_t *ring) {
+    const uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + 1U, memory_order_release);
+}
+
+uint32_t Ring_Count(Ring_t *ring) {
+    const uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return head - tail;
+}
+
+void Ring_Flush(Ring_t *ring) {
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    atomic_store_explicit(&ring->tail, head, memory_order_release);
+}
+
+/* ----------------- Sequence lock ----------------- */
+
+// The payload is copied with relaxed byte atomics so a torn copy is a
+// detected retry, not undefined behaviour.
+static void copy_in(void *dst, const void *src, uint32_t size) {
+    _Atomic uint8_t *d = (_Atomic uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    for (uint32_t i = 0U; i < size; i++)
+        atomic_store_explicit(&d[i], s[i], memory_order_relaxed);
+}
+
+static void copy_out(void *dst, const void *src, uint32_t size) {
+    uint8_t *d = (uint8_t *)dst;
+    _Atomic const uint8_t *s = (_Atomic const uint8_t *)src;
+    for (uint32_t i = 0U; i < size; i++)
+        d[i] = atomic_load_explicit(&s[i], memory_order_relaxed);
+}
+
+void SeqLock_Write(SeqLock_t *lock, void *dst, const void *src, uint32_t size) {
+    const uint32_t seq = atomic_load_explicit(&lock->seq, memory_order_relaxed);
+    atomic_store_explicit(&lock->seq, seq + 1U, memory_order_relaxed);
+    // Odd sequence is visible before any payload byte changes.
+    atomic_thread_fence(memory_order_release);
+    copy_in(dst, src, size);
+    atomic_store_explicit(&lock->seq, seq + 2U, memory_order_release);
+}
+
+uint8_t SeqLock_Read(SeqLock_t *lock, void *dst, const void *src, uint32_t size, uint32_t tries) {
+    while (tries-- > 0U) {
+        const uint32_t before = atomic_load_explicit(&lock->seq, memory_order_acquire);
+        if ((before & 1U) != 0U)
+            continue; // write in progress
+        copy_out(dst, src, size);
+        // Payload loads complete before the sequence is checked again.
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&lock->seq, memory_order_relaxed) == before)
+            return 1;
+    }
+    return 0;
+}
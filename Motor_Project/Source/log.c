@@ -0,0 +1,103 @@
+// log.c
+#include "log.h"
+#include "irq.h"
+#include <stdint.h>
+
+// This file owns the deferred-format log (see log.h):
+//  - a RAM ring of 32-bit words; each message is a header, the DWT cycle
+//    count and up to four raw arguments, and the oldest messages are
+//    overwritten when it fills up
+//  - a header (magic, size, clock) so a raw memory dump is self-describing
+//    for the host decoder (Tools/host/log_decode.c)
+//  - a thread-mode drain that streams the same words to an ITM stimulus port
+//    when a debugger is capturing SWO
+// Formatting happens only on the host, so a call costs tens of cycles.
+
+_Static_assert((LOG_RING_WORDS & (LOG_RING_WORDS - 1U)) == 0U, "LOG_RING_WORDS must be a power of two");
+
+#define RING_MASK (LOG_RING_WORDS - 1U)
+#define MSG_WORDS_MAX (2U + LOG_ARGS_MAX)
+
+Log_Buffer_t g_log;
+
+/* ----------------- Helpers ----------------- */
+
+static inline uint32_t msg_words(uint32_t header) {
+    return 2U + (header & LOG_NARGS_MASK);
+}
+
+// ITM is only usable once the debugger has set it up for SWO capture.
+static uint8_t itm_ready(void) {
+    return (uint8_t)((CoreDebug->DEMCR & CoreDebug_DEMCR_TRCENA_Msk) != 0U &&
+                     (ITM->TCR & ITM_TCR_ITMENA_Msk) != 0U &&
+                     (ITM->TER & (1UL << LOG_ITM_PORT)) != 0U);
+}
+
+/* ----------------- API ----------------- */
+
+void Log_Init(void) {
+    g_log.magic = LOG_MAGIC;
+    g_log.words = LOG_RING_WORDS;
+    g_log.cpu_hz = SystemCoreClock;
+    g_log.head = 0U;
+    g_log.tail = 0U;
+    g_log.drain = 0U;
+    g_log.lost = 0U;
+}
+
+void Log_Write(uint32_t header, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+    const uint32_t n = msg_words(header);
+    const uint32_t args[LOG_ARGS_MAX] = {a0, a1, a2, a3};
+
+    const uint32_t basepri = Irq_Lock();
+    const uint32_t head = g_log.head;
+    // Make room by dropping whole messages from the old end.
+    uint32_t tail = g_log.tail;
+    while (head + n - tail > LOG_RING_WORDS)
+        tail += msg_words(g_log.ring[tail & RING_MASK]);
+    g_log.tail = tail;
+
+    g_log.ring[head & RING_MASK] = header;
+    g_log.ring[(head + 1U) & RING_MASK] = DWT->CYCCNT;
+    for (uint32_t i = 0U; i + 2U < n; i++)
+        g_log.ring[(head + 2U + i) & RING_MASK] = args[i];
+    g_log.head = head + n;
+    Irq_Unlock(basepri);
+}
+
+uint32_t Log_Flush(void) {
+    if (!itm_ready())
+        return 0U;
+
+    uint32_t sent = 0U;
+    while (sent < LOG_FLUSH_MAX) {
+        // Copy one message out with interrupts masked, then stream it
+        // without holding anything up.
+        uint32_t msg[MSG_WORDS_MAX];
+        uint32_t n = 0U;
+        const uint32_t basepri = Irq_Lock();
+        // Overwritten before we got to it: skip to the oldest survivor.
+        if ((int32_t)(g_log.tail - g_log.drain) > 0) {
+            g_log.lost++;
+            g_log.drain = g_log.tail;
+        }
+        if (g_log.drain != g_log.head) {
+            n = msg_words(g_log.ring[g_log.drain & RING_MASK]);
+            for (uint32_t i = 0U; i < n; i++)
+                msg[i] = g_log.ring[(g_log.drain + i) & RING_MASK];
+            g_log.drain += n;
+        }
+        Irq_Unlock(basepri);
+        if (n == 0U)
+            break;
+
+        for (uint32_t i = 0U; i < n; i++) {
+            // Bit 0 of the stimulus port reads 1 once its FIFO has room.
+            while (ITM->PORT[LOG_ITM_PORT].u32 == 0U) {
+            }
+            ITM->PORT[LOG_ITM_PORT].u32 = msg[i];
+        }
+        sent += n;
+    }
+    return sent;
+}
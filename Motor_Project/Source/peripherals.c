@@ -1,13 +1,30 @@
 // peripherals.c
 #include "peripherals.h"
-#include "main.h"
+#include "axis.h"
 #include <stdint.h>
+#include <string.h>
+#ifndef PERIPHERALS_ESTIMATOR_ONLY
+#include "irq.h"
+#include "main.h"
+#include "timdrv.h"
+#endif
 
 // This file provides hardware access for:
 //  - GPIO motor enable pins
-//  - PWM outputs (Timer 3)
-//  - Encoder counter and velocity estimation (Timer 1)
+//  - PWM outputs (Timer 3 for axis 0), in one of the drive modes of
+//    peripherals.h, with a per-mode duty linearisation table, a dead-band
+//    jump and hysteresis around zero, and a duty sweep that learns the table
+//  - Encoder counter and velocity estimation (Timer 1 for axis 0)
+// Each motor axis is described by a static descriptor (timers, channels, pins);
+// runtime state is kept as structure-of-arrays indexed by axis.
+// TIM3 is the PWM master: the other PWM timers are slaved to it with a phase
+// offset, and its update event paces the control tick (Peripheral_Sync_*).
+// The PWM period can be scaled with the load (Peripheral_PWM_AdaptFrequency);
+// the switch is made by the master update handler, so every timer's ARR and
+// compare values change together at one update.
 // Everything is done with integer math (no floating point).
+// PERIPHERALS_ESTIMATOR_ONLY builds just the velocity estimator, for the
+// host replay of recorded ticks (Tools/host/replay.c).
 
 /* ----------------- Units & scaling ----------------- */
 
@@ -27,14 +44,195 @@
 // Rolling window target (ms) for velocity estimation.
 volatile int32_t g_vel_window_ms = 40U;
 
-// Raw (unaveraged) velocity in RPM for debugging/Watch.
-volatile int32_t g_vel_raw_rpm = 0;
+// Raw (unaveraged) velocity in RPM per axis for debugging/Watch.
+volatile int32_t g_vel_raw_rpm[AXIS_COUNT];
+
+// History length of the rolling velocity window (samples per axis).
+#define VEL_BUF_N 32
+
+#ifndef PERIPHERALS_ESTIMATOR_ONLY
+// Requested drive mode per axis (PERIPHERAL_DRIVE_*).
+volatile uint8_t g_drive_mode[AXIS_COUNT];
+
+// Duty linearisation per drive mode: Q15 duty at |control| = 0, 1/16 .. 1.
+#define LIN_IDENTITY {0U, 2048U, 4096U, 6144U, 8192U, 10240U, 12288U, 14336U, 16384U, \
+                      18432U, 20480U, 22528U, 24576U, 26624U, 28672U, 30720U, 32768U}
+volatile uint16_t g_drive_lin[PERIPHERAL_DRIVE_MODES][PERIPHERAL_LIN_POINTS] = {
+    LIN_IDENTITY, LIN_IDENTITY, LIN_IDENTITY,
+};
+
+// Dead-band hysteresis (Q30 control): the bridge starts driving once
+// |control| reaches it and stops again below half of it. 0 = off.
+volatile int32_t g_drive_hyst = 0;
+
+// Duty sweep (PERIPHERAL_SWEEP_*): write axis + 1 to g_lin_sweep to learn the
+// table of that axis' current drive mode; it reads 0 again when done.
+volatile uint8_t g_lin_sweep = 0U;
+volatile uint8_t g_lin_sweep_status = PERIPHERAL_SWEEP_IDLE;
+// Speed at each grid duty of the last sweep (RPM) and the breakaway duty (Q15).
+volatile int32_t g_lin_sweep_rpm[PERIPHERAL_LIN_POINTS];
+volatile uint16_t g_lin_sweep_breakaway;
+
+// Adaptive PWM frequency: 1 = scale the carrier with the load, 0 = fixed.
+volatile uint8_t g_pwm_adapt = 0U;
+// Below this duty (Q15) on every axis the carrier runs at twice the nominal
+// frequency, for less current ripple.
+volatile uint16_t g_pwm_fast_duty = 6554U;
+// Above this duty (Q15) on an axis turning faster than g_pwm_slow_rpm, the
+// carrier runs at half the nominal frequency, for less switching loss.
+volatile uint16_t g_pwm_slow_duty = 22938U;
+volatile int32_t g_pwm_slow_rpm = 3000;
+// A new carrier must be wanted this long before it is switched to.
+volatile uint32_t g_pwm_dwell_ms = 200U;
+// Carrier period in use (timer counts, Watch).
+volatile uint32_t g_pwm_top;
+#endif
+
+#ifndef PERIPHERALS_ESTIMATOR_ONLY
+
+/* ----------------- Axis descriptors ----------------- */
+
+// Static wiring of one motor axis: which timers, channels and pins it uses.
+typedef struct {
+    TIM_HandleTypeDef *enc_timer; // Quadrature encoder counter
+    TIM_HandleTypeDef *pwm_timer; // PWM generator
+    uint32_t ch_cw;               // Channel driven for clockwise rotation
+    uint32_t ch_ccw;              // Channel driven for counter-clockwise rotation
+    GPIO_TypeDef *en1_port;
+    uint16_t en1_pin;
+    GPIO_TypeDef *en2_port;
+    uint16_t en2_pin;
+    // PWM phase relative to the master in degrees of the PWM period.
+    // Slaved timers accept any value; channels on the master itself can only
+    // be leading-edge (0) or trailing-edge (180) aligned.
+    uint16_t phase_deg;
+    // Slave trigger input selecting the master TRGO (unused on the master).
+    uint32_t sync_trigger;
+} axis_desc_t;
+
+// Axis 0 is the original TIM1/TIM3 wiring; extra axes are set up in main.c.
+// Default phases interleave the PWM pulses so the supply sees staggered edges.
+static const axis_desc_t axis_desc[AXIS_COUNT] = {
+    {&htim1, &htim3, TIM_CHANNEL_2, TIM_CHANNEL_1,
+     MOTOR_EN1_GPIO_Port, MOTOR_EN1_Pin, MOTOR_EN2_GPIO_Port, MOTOR_EN2_Pin,
+     0U, 0U},
+#if AXIS_COUNT > 1
+    {&htim4, &htim3, TIM_CHANNEL_4, TIM_CHANNEL_3,
+     MOTOR1_EN1_GPIO_Port, MOTOR1_EN1_Pin, MOTOR1_EN2_GPIO_Port, MOTOR1_EN2_Pin,
+     180U, 0U},
+#endif
+#if AXIS_COUNT > 2
+    // TIM15 ITR1 = TIM3 TRGO
+    {&htim8, &htim15, TIM_CHANNEL_2, TIM_CHANNEL_1,
+     MOTOR2_EN1_GPIO_Port, MOTOR2_EN1_Pin, MOTOR2_EN2_GPIO_Port, MOTOR2_EN2_Pin,
+     90U, TIM_TS_ITR1},
+#endif
+#if AXIS_COUNT > 3
+    // TIM2 ITR2 = TIM3 TRGO
+    {&htim5, &htim2, TIM_CHANNEL_4, TIM_CHANNEL_3,
+     MOTOR3_EN1_GPIO_Port, MOTOR3_EN1_Pin, MOTOR3_EN2_GPIO_Port, MOTOR3_EN2_Pin,
+     270U, TIM_TS_ITR2},
+#endif
+};
 
-/* ----------------- Aliases ----------------- */
+// Master PWM timer; its update event is the common trigger instant.
+#define SYNC_MASTER htim3
 
-// Aliases make the intent clearer at call sites.
-#define ENC_TIMER htim1
-#define PWM_TIMER htim3
+/* ----------------- Axis state (structure of arrays) ----------------- */
+
+// Register pointers resolved once from the descriptors, so the control tick
+// only does indexed loads instead of walking handles.
+static struct {
+    volatile uint32_t *enc_cnt[AXIS_COUNT];
+    volatile uint32_t *pwm_arr[AXIS_COUNT];
+    volatile uint32_t *ccr_cw[AXIS_COUNT];
+    volatile uint32_t *ccr_ccw[AXIS_COUNT];
+    // Trailing-edge aligned (PWM mode 2): CCR holds top - duty, idle = top.
+    uint8_t late_edge[AXIS_COUNT];
+    uint8_t drive_mode[AXIS_COUNT]; // Mode the channels are set up for
+    uint8_t drive_hold[AXIS_COUNT]; // Bridge held off for a mode change
+    uint8_t enabled[AXIS_COUNT];    // Enable state asked for by the GPIO API
+    uint8_t engaged[AXIS_COUNT];    // Past the dead-band hysteresis
+    uint16_t duty_q15[AXIS_COUNT];  // Last duty applied, after linearisation
+} hw;
+
+// Duty sweep in progress: a breakaway search in small steps, then one point
+// per table breakpoint, each held until the speed has settled.
+#define SWEEP_STEP_Q15 128U     // Breakaway search step (1/256 of full duty)
+#define SWEEP_STEP_MS 50U       // Hold per breakaway step
+#define SWEEP_SETTLE_MS 400U    // Hold per grid point (several mechanical time constants)
+#define SWEEP_MOVE_RPM 20       // Speed taken as "turning"
+static struct {
+    uint8_t axis;               // Axis + 1 being swept, 0 = none
+    uint8_t grid;               // 0 = breakaway search, else grid point being held
+    uint16_t duty_q15;
+    uint32_t held_ms;
+    int32_t out;                // Control asked for this tick (Q30)
+} sweep;
+
+// Control tick pacing derived from the master update rate.
+// Time is counted in untrimmed period lengths, so trimming the real period
+// length (Peripheral_Sync_Trim) disciplines both the carrier and the tick.
+// The untrimmed length is nominal_top, or a power-of-two multiple of it
+// while the carrier is scaled; top_now/top_next follow the preloaded ARR.
+static struct {
+    uint32_t clocks_per_tick; // Timer clocks per control tick
+    uint32_t tick_ms;
+    uint32_t acc;             // Disciplined clocks elapsed since the last tick
+    uint32_t nominal_top;     // Untrimmed PWM period from CubeMX (clocks)
+    uint32_t top_now;         // Untrimmed length of the running period
+    volatile uint32_t top_next; // Untrimmed length loaded for the next period
+    volatile uint32_t top_request; // Carrier wanted by the frequency manager
+    volatile uint32_t top_gen;  // Carrier switches so far
+    uint32_t clocks_per_us;
+    uint64_t elapsed;         // Untrimmed clocks up to the last update (Irq_Lock-protected)
+    int64_t offset;           // Stepped time offset, whole periods (clocks)
+    int32_t trim_q16;         // Frequency trim per nominal period (Q16 clocks)
+    int32_t phase_left;       // Phase still to be slewed in (clocks)
+    uint32_t frac_q16;        // Fractional period carry (Q16 clocks)
+    uint8_t trimming;         // ARR is dithered every period
+    volatile uint8_t align_request;
+    volatile uint32_t rephases; // Tick phase moves (align or step)
+    TIM_TypeDef *tims[AXIS_COUNT]; // Distinct PWM timers, master first
+    uint8_t tim_count;
+} sync;
+
+// Largest phase correction applied in one PWM period (clocks). 1/16 of the
+// 2048-count period keeps the carrier within about 6% of nominal.
+#define SYNC_SLEW_MAX 128
+
+// Frequency manager: carrier scaling steps, as shifts of the nominal period.
+#define PWM_SHIFT_FAST (-1)     // Half the period: 39 kHz at the 2048-count nominal
+#define PWM_SHIFT_SLOW 1        // Twice the period: 9.8 kHz
+static struct {
+    int8_t want;                // Scaling the load asks for
+    uint32_t wanted_ms;         // How long it has asked for it
+} adapt;
+static uint8_t hw_ready = 0;
+
+#endif
+
+// Velocity estimator history, one column per axis.
+static struct {
+    // Previous raw encoder count (16-bit hardware counter).
+    int16_t prev_count[AXIS_COUNT];
+    // Previous time (ms).
+    uint32_t prev_ms[AXIS_COUNT];
+    // Circular buffers for delta counts and delta time.
+    int16_t delta_count_buf[AXIS_COUNT][VEL_BUF_N];
+    uint16_t delta_ms_buf[AXIS_COUNT][VEL_BUF_N];
+    uint8_t buf_index[AXIS_COUNT];
+    uint8_t buf_count[AXIS_COUNT];
+    // Rolling sums for the active window.
+    int32_t sum_delta_count[AXIS_COUNT];
+    uint32_t sum_delta_ms[AXIS_COUNT];
+    // Last calculated velocity (RPM).
+    int32_t vel_rpm[AXIS_COUNT];
+    // Encoder counts latched at the common trigger instant.
+    int16_t count[AXIS_COUNT];
+} est;
+
+#ifndef PERIPHERALS_ESTIMATOR_ONLY
 
 /* ----------------- Helpers ----------------- */
 
@@ -48,6 +246,14 @@ static inline void gpio_clear(GPIO_TypeDef *port, uint16_t pin) {
     port->BSRR = (uint32_t)pin << 16U;
 }
 
+// Make a GPIO pin a general-purpose output (MODER = 01).
+static inline void gpio_output(GPIO_TypeDef *port, uint16_t pin) {
+    for (uint32_t n = 0U; n < 16U; n++) {
+        if ((pin & (1UL << n)) != 0U)
+            port->MODER = (port->MODER & ~(3UL << (2U * n))) | (1UL << (2U * n));
+    }
+}
+
 // Saturate controller input to the allowed Q30 range.
 static inline int32_t clamp_ctrl(int32_t x) {
     if (x > CTRL_MAX)
@@ -57,8 +263,24 @@ static inline int32_t clamp_ctrl(int32_t x) {
     return x;
 }
 
-// Convert Q30 control value to timer counts in range [0, ARR].
-static inline uint32_t ctrl_to_counts(int32_t ctrl, uint32_t top) {
+// Q15 duty to timer counts in range [0, ARR].
+static inline uint32_t q15_to_counts(uint32_t duty_q15, uint32_t top) {
+    uint32_t duty = (duty_q15 * top) >> 15U;
+    if (duty > (top - 1U))
+        duty = top - 1U;
+    return duty;
+}
+
+// Linearisation segments: the top 4 bits of |control| pick one of 16.
+#define LIN_SEG_SHIFT (CTRL_Q - 4)
+_Static_assert((1U << (CTRL_Q - LIN_SEG_SHIFT)) + 1U == PERIPHERAL_LIN_POINTS, "one breakpoint per segment edge");
+
+// Convert Q30 control value to timer counts in range [0, ARR], through the
+// linearisation table of the drive mode. Breakpoint 0 is the dead-band jump:
+// it applies to any engaged control, and only an exact 0 (or a control that
+// fell out of the hysteresis band) gives 0. No loops, so the cost is the
+// same for every input: one lookup and one interpolation.
+static inline uint32_t ctrl_to_counts(uint8_t axis, int32_t ctrl, uint32_t top) {
     const int32_t sat = clamp_ctrl(ctrl);
     // Handle CTRL_MIN specially to avoid overflow when negating.
     uint32_t mag = 0U;
@@ -71,98 +293,445 @@ static inline uint32_t ctrl_to_counts(int32_t ctrl, uint32_t top) {
             mag = (uint32_t)sat;
         }
     }
-    uint32_t duty = (uint32_t)(((uint64_t)mag * (uint64_t)top) >> CTRL_Q);
-    if (duty > (top - 1U))
-        duty = top - 1U;
-    return duty;
+
+    // Engage at the hysteresis threshold, release below half of it.
+    const uint32_t hyst = (g_drive_hyst > 0) ? (uint32_t)g_drive_hyst : 0U;
+    if (mag == 0U || mag < (hyst >> 1U))
+        hw.engaged[axis] = 0U;
+    else if (mag >= hyst)
+        hw.engaged[axis] = 1U;
+    if (!hw.engaged[axis]) {
+        hw.duty_q15[axis] = 0U;
+        return 0U;
+    }
+
+    const volatile uint16_t *lin = g_drive_lin[hw.drive_mode[axis]];
+    uint32_t lin_q15 = 0U;
+    if (mag >= CTRL_MAG_MAX) {
+        lin_q15 = lin[PERIPHERAL_LIN_POINTS - 1U];
+    } else {
+        const uint32_t seg = mag >> LIN_SEG_SHIFT;
+        const int32_t frac = (int32_t)(mag & ((1UL << LIN_SEG_SHIFT) - 1U));
+        const int32_t y0 = lin[seg];
+        const int32_t y1 = lin[seg + 1U];
+        lin_q15 = (uint32_t)(y0 + (int32_t)(((int64_t)(y1 - y0) * frac) >> LIN_SEG_SHIFT));
+    }
+    hw.duty_q15[axis] = (uint16_t)lin_q15;
+    return q15_to_counts(lin_q15, top);
+}
+
+/* ----------------- Axis setup ----------------- */
+void Peripheral_Axis_Init(void) {
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        const axis_desc_t *d = &axis_desc[axis];
+        hw.enc_cnt[axis] = &d->enc_timer->Instance->CNT;
+        hw.pwm_arr[axis] = &d->pwm_timer->Instance->ARR;
+        hw.ccr_cw[axis] = TimDrv_CCR(d->pwm_timer->Instance, d->ch_cw);
+        hw.ccr_ccw[axis] = TimDrv_CCR(d->pwm_timer->Instance, d->ch_ccw);
+        // Force the estimator through its first-call path.
+        est.prev_ms[axis] = 0U;
+    }
+    hw_ready = 1;
+}
+
+// Lazy init for the single-axis API, which predates Peripheral_Axis_Init.
+static inline void axis_ensure_init(void) {
+    if (!hw_ready)
+        Peripheral_Axis_Init();
 }
 
 /* ----------------- GPIO ----------------- */
 void Peripheral_GPIO_EnableMotor(void) {
-    // Enable both half-bridges on the motor driver.
-    gpio_set(MOTOR_EN1_GPIO_Port, MOTOR_EN1_Pin);
-    gpio_set(MOTOR_EN2_GPIO_Port, MOTOR_EN2_Pin);
+    Peripheral_GPIO_EnableMotorAxis(0);
 }
 
 void Peripheral_GPIO_DisableMotor(void) {
+    Peripheral_GPIO_DisableMotorAxis(0);
+}
+
+void Peripheral_GPIO_EnableMotorAxis(uint8_t axis) {
+    // Enable both half-bridges on the motor driver.
+    const axis_desc_t *d = &axis_desc[axis];
+    hw.enabled[axis] = 1U;
+    if (hw.drive_hold[axis])
+        return; // A drive mode change enables the bridge when it is done.
+    gpio_set(d->en1_port, d->en1_pin);
+    gpio_set(d->en2_port, d->en2_pin);
+}
+
+void Peripheral_GPIO_DisableMotorAxis(uint8_t axis) {
     // Disable both half-bridges (motor coasts).
-    gpio_clear(MOTOR_EN1_GPIO_Port, MOTOR_EN1_Pin);
-    gpio_clear(MOTOR_EN2_GPIO_Port, MOTOR_EN2_Pin);
+    const axis_desc_t *d = &axis_desc[axis];
+    hw.enabled[axis] = 0U;
+    gpio_clear(d->en1_port, d->en1_pin);
+    gpio_clear(d->en2_port, d->en2_pin);
+}
+
+void Peripheral_GPIO_DisableMotorAll(void) {
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_GPIOC_CLK_ENABLE();
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        const axis_desc_t *d = &axis_desc[axis];
+        // Output latch low first, so the pins never drive high.
+        Peripheral_GPIO_DisableMotorAxis(axis);
+        gpio_output(d->en1_port, d->en1_pin);
+        gpio_output(d->en2_port, d->en2_pin);
+    }
 }
 
 /* ----------------- PWM ----------------- */
 void Peripheral_PWM_ActuateMotor(int32_t control) {
-    // ARR is the timer period, so top = ARR + 1 counts.
-    const uint32_t pwm_arr = (uint32_t)PWM_TIMER.Instance->ARR;
-    const uint32_t pwm_top = pwm_arr + 1U;
-    const uint32_t duty_counts = ctrl_to_counts(control, pwm_top);
+    axis_ensure_init();
+    Peripheral_PWM_ActuateMotorAxis(0, control);
+}
+
+// Compare value that keeps a channel high for high_counts of the period.
+static inline uint32_t high_to_ccr(uint8_t axis, uint32_t high_counts, uint32_t top) {
+    // PWM mode 2 is active from CCR to the end of the period.
+    return hw.late_edge[axis] ? top - high_counts : high_counts;
+}
+
+// Set the channels up for a new drive mode with the bridge disabled. The
+// compare values are preloaded, so the idle pair only reaches the pins at
+// the next update; the bridge stays off until the following tick.
+static void drive_switch(uint8_t axis, uint8_t mode, uint32_t top) {
+    const axis_desc_t *d = &axis_desc[axis];
+    TIM_TypeDef *tim = d->pwm_timer->Instance;
+    gpio_clear(d->en1_port, d->en1_pin);
+    gpio_clear(d->en2_port, d->en2_pin);
+
+    // Antiphase runs the CCW channel in the opposite PWM mode at the same
+    // compare value, which makes it the exact complement of the CW channel.
+    const uint32_t base = hw.late_edge[axis] ? TIM_OCMODE_PWM2 : TIM_OCMODE_PWM1;
+    const uint32_t other = hw.late_edge[axis] ? TIM_OCMODE_PWM1 : TIM_OCMODE_PWM2;
+    TimDrv_SetOCMode(tim, d->ch_cw, base);
+    TimDrv_SetOCMode(tim, d->ch_ccw, (mode == PERIPHERAL_DRIVE_ANTIPHASE) ? other : base);
+
+    uint32_t idle = 0U;
+    if (mode == PERIPHERAL_DRIVE_SM_HIGH)
+        idle = top;
+    else if (mode == PERIPHERAL_DRIVE_ANTIPHASE)
+        idle = top / 2U;
+    *hw.ccr_cw[axis] = high_to_ccr(axis, idle, top);
+    *hw.ccr_ccw[axis] = high_to_ccr(axis, idle, top);
+
+    hw.drive_mode[axis] = mode;
+    hw.drive_hold[axis] = 1U;
+}
+
+// Put the bridge inputs of one axis at a duty in the direction of dir
+// (sign only), in the axis' drive mode.
+static void drive_output(uint8_t axis, int32_t dir, uint32_t duty_counts, uint32_t pwm_top) {
+    const uint8_t mode = hw.drive_mode[axis];
+    if (mode == PERIPHERAL_DRIVE_ANTIPHASE) {
+        // CW high for half the period plus half the duty; CCW is its
+        // complement, so the average bridge voltage is duty/top of supply.
+        const uint32_t half = duty_counts / 2U;
+        const uint32_t cw_high = (dir < 0) ? pwm_top / 2U - half : pwm_top / 2U + half;
+        const uint32_t ccr = high_to_ccr(axis, cw_high, pwm_top);
+        *hw.ccr_ccw[axis] = ccr;
+        *hw.ccr_cw[axis] = ccr;
+        return;
+    }
+
+    // Sign-magnitude: the driven input is high for the duty and the other one
+    // stays at the off level. SM_HIGH inverts both, so the off phase has both
+    // inputs high instead of low.
+    uint32_t drive_ccr = high_to_ccr(axis, duty_counts, pwm_top);
+    uint32_t off_ccr = high_to_ccr(axis, 0U, pwm_top);
+    if (mode == PERIPHERAL_DRIVE_SM_HIGH) {
+        drive_ccr = high_to_ccr(axis, pwm_top - duty_counts, pwm_top);
+        off_ccr = high_to_ccr(axis, pwm_top, pwm_top);
+    }
 
     // Direction is set by choosing which PWM channel is active.
-    if (control > 0) {
-        // Clockwise: use CCR2, keep CCR1 low.
-        PWM_TIMER.Instance->CCR1 = 0U;
-        PWM_TIMER.Instance->CCR2 = duty_counts;
-    } else if (control < 0) {
-        // Counter-clockwise: use CCR1, keep CCR2 low.
-        PWM_TIMER.Instance->CCR1 = duty_counts;
-        PWM_TIMER.Instance->CCR2 = 0U;
+    if (dir > 0) {
+        // Clockwise: drive the CW channel, hold the CCW channel at the off level.
+        *hw.ccr_ccw[axis] = (mode == PERIPHERAL_DRIVE_SM_HIGH) ? drive_ccr : off_ccr;
+        *hw.ccr_cw[axis] = (mode == PERIPHERAL_DRIVE_SM_HIGH) ? off_ccr : drive_ccr;
+    } else if (dir < 0) {
+        // Counter-clockwise: drive the CCW channel, hold the CW channel at the off level.
+        *hw.ccr_ccw[axis] = (mode == PERIPHERAL_DRIVE_SM_HIGH) ? off_ccr : drive_ccr;
+        *hw.ccr_cw[axis] = (mode == PERIPHERAL_DRIVE_SM_HIGH) ? drive_ccr : off_ccr;
     } else {
-        // Zero -> motor off.
-        PWM_TIMER.Instance->CCR1 = 0U;
-        PWM_TIMER.Instance->CCR2 = 0U;
+        // Zero -> both inputs at the off level (bridge brakes or coasts).
+        *hw.ccr_ccw[axis] = off_ccr;
+        *hw.ccr_cw[axis] = off_ccr;
+    }
+}
+
+
+// Invert the swept speed curve into the table of the axis' drive mode, so
+// equal control steps give equal speed steps. Points are (duty, speed), the
+// first one the breakaway duty at zero speed; speeds are made monotonic.
+static uint8_t sweep_learn(uint8_t axis) {
+    uint16_t duty[PERIPHERAL_LIN_POINTS + 1U];
+    int32_t rpm[PERIPHERAL_LIN_POINTS + 1U];
+    uint32_t n = 0U;
+    duty[n] = g_lin_sweep_breakaway;
+    rpm[n++] = 0;
+    for (uint32_t k = 1U; k < PERIPHERAL_LIN_POINTS; k++) {
+        const uint32_t d = k * (32768U / (PERIPHERAL_LIN_POINTS - 1U));
+        if (d <= duty[n - 1U])
+            continue;
+        duty[n] = (uint16_t)d;
+        rpm[n] = (g_lin_sweep_rpm[k] > rpm[n - 1U]) ? g_lin_sweep_rpm[k] : rpm[n - 1U];
+        n++;
+    }
+    const int32_t top_rpm = rpm[n - 1U];
+    if (n < 2U || top_rpm < SWEEP_MOVE_RPM)
+        return 0U;
+
+    volatile uint16_t *lin = g_drive_lin[hw.drive_mode[axis]];
+    uint32_t j = 0U;
+    for (uint32_t i = 0U; i < PERIPHERAL_LIN_POINTS; i++) {
+        const int32_t target = (int32_t)(((int64_t)top_rpm * (int32_t)i) / (int32_t)(PERIPHERAL_LIN_POINTS - 1U));
+        while (j + 2U < n && rpm[j + 1U] < target)
+            j++;
+        const int32_t span = rpm[j + 1U] - rpm[j];
+        int32_t d = duty[j];
+        if (span > 0) {
+            const int32_t into = (target > rpm[j]) ? target - rpm[j] : 0;
+            d += (int32_t)(((int64_t)(duty[j + 1U] - duty[j]) * into) / span);
+        }
+        lin[i] = (uint16_t)d;
+    }
+    lin[PERIPHERAL_LIN_POINTS - 1U] = 32768U;
+    return 1U;
+}
+
+// One tick of the duty sweep on an axis. The controller output is replaced
+// while it runs (the controller sees its output saturate and winds up to its
+// clamp). Returns the CW duty to hold this tick (Q15), 0 once the sweep is over.
+static uint32_t sweep_tick(uint8_t axis) {
+    const int32_t speed = est.vel_rpm[axis];
+    if (sweep.axis != axis + 1U) {
+        sweep.axis = (uint8_t)(axis + 1U);
+        sweep.grid = 0U;
+        sweep.duty_q15 = 0U;
+        sweep.held_ms = 0U;
+        g_lin_sweep_status = PERIPHERAL_SWEEP_RUNNING;
+    }
+    sweep.held_ms += sync.tick_ms;
+
+    uint8_t status = PERIPHERAL_SWEEP_RUNNING;
+    if (sweep.grid == 0U) {
+        // Breakaway: raise the duty until the motor turns.
+        if (sweep.held_ms >= SWEEP_STEP_MS) {
+            sweep.held_ms = 0U;
+            if (speed >= SWEEP_MOVE_RPM) {
+                g_lin_sweep_breakaway = sweep.duty_q15;
+                sweep.grid = 1U;
+                sweep.duty_q15 = 32768U / (PERIPHERAL_LIN_POINTS - 1U);
+            } else if (sweep.duty_q15 >= 32768U - SWEEP_STEP_Q15) {
+                status = PERIPHERAL_SWEEP_FAILED; // Never turned
+            } else {
+                sweep.duty_q15 = (uint16_t)(sweep.duty_q15 + SWEEP_STEP_Q15);
+            }
+        }
+    } else if (sweep.held_ms >= SWEEP_SETTLE_MS) {
+        // Grid point settled: record it and move up.
+        sweep.held_ms = 0U;
+        g_lin_sweep_rpm[sweep.grid] = speed;
+        sweep.grid++;
+        sweep.duty_q15 = (uint16_t)(sweep.grid * (32768U / (PERIPHERAL_LIN_POINTS - 1U)));
+        if (sweep.grid >= PERIPHERAL_LIN_POINTS) {
+            g_lin_sweep_rpm[0] = 0;
+            status = sweep_learn(axis) ? PERIPHERAL_SWEEP_DONE : PERIPHERAL_SWEEP_FAILED;
+        }
+    }
+
+    if (status != PERIPHERAL_SWEEP_RUNNING) {
+        g_lin_sweep_status = status;
+        g_lin_sweep = 0U;
+        sweep.axis = 0U;
+        return 0U;
+    }
+    return sweep.duty_q15;
+}
+
+// PWM period the compare values are written for: the one loaded for the
+// next update (ARR + 1 before Peripheral_Sync_Init).
+static inline uint32_t pwm_top_of(uint8_t axis) {
+    return (sync.top_next != 0U) ? sync.top_next : *hw.pwm_arr[axis] + 1U;
+}
+
+void Peripheral_PWM_ActuateMotorAxis(uint8_t axis, int32_t control) {
+    // Mode change: one tick with the bridge off, then enable if still wanted.
+    const uint8_t want = g_drive_mode[axis];
+    if (want != hw.drive_mode[axis] && want < PERIPHERAL_DRIVE_MODES) {
+        drive_switch(axis, want, pwm_top_of(axis));
+        return;
     }
+    if (hw.drive_hold[axis]) {
+        hw.drive_hold[axis] = 0U;
+        if (hw.enabled[axis])
+            Peripheral_GPIO_EnableMotorAxis(axis);
+    }
+
+    // A sweep duty arrives as control, as Peripheral_PWM_SweepControl made
+    // it; anything else means the drive, the stall detector or the thermal
+    // limit stepped in, and the speeds it records would be wrong.
+    uint8_t sweeping = (uint8_t)(sweep.axis == axis + 1U);
+    if (sweeping && control != sweep.out) {
+        sweep.axis = 0U;
+        g_lin_sweep = 0U;
+        g_lin_sweep_status = PERIPHERAL_SWEEP_FAILED;
+        sweeping = 0U;
+    }
+
+    // A carrier switch rescales the compare values in the fast layer; if one
+    // lands while this axis is being written, write it again for the new top.
+    uint32_t gen = 0U;
+    do {
+        gen = sync.top_gen;
+        const uint32_t pwm_top = pwm_top_of(axis);
+        const uint32_t counts = sweeping ? q15_to_counts(sweep.duty_q15, pwm_top)
+                                         : ctrl_to_counts(axis, control, pwm_top);
+        drive_output(axis, control, counts, pwm_top);
+    } while (gen != sync.top_gen);
+}
+
+int32_t Peripheral_PWM_SweepControl(uint8_t axis, int32_t control) {
+    if (g_lin_sweep != axis + 1U) {
+        if (sweep.axis == axis + 1U) {
+            // Sweep cancelled from Watch: the table is left as it was.
+            sweep.axis = 0U;
+            g_lin_sweep_status = PERIPHERAL_SWEEP_FAILED;
+        }
+        return control;
+    }
+    // Raw duty in Q30 (full duty saturates to CTRL_MAX); the actuator maps
+    // it back without the table being learned.
+    const int64_t out = (int64_t)sweep_tick(axis) << 15;
+    sweep.out = (out > (int64_t)CTRL_MAX) ? CTRL_MAX : (int32_t)out;
+    return sweep.out;
 }
 
+void Peripheral_PWM_AdaptFrequency(void) {
+    if (sync.nominal_top == 0U)
+        return;
+    int8_t want = 0;
+    if (g_pwm_adapt) {
+        uint8_t all_low = 1U;
+        uint8_t hot = 0U;
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+            const uint16_t duty = hw.duty_q15[axis];
+            const int32_t rpm = est.vel_rpm[axis];
+            all_low &= (uint8_t)(duty < g_pwm_fast_duty);
+            hot |= (uint8_t)(duty > g_pwm_slow_duty && (rpm > g_pwm_slow_rpm || rpm < -g_pwm_slow_rpm));
+        }
+        if (hot)
+            want = PWM_SHIFT_SLOW;
+        else if (all_low)
+            want = PWM_SHIFT_FAST;
+    }
+
+    // Switch once the same carrier has been wanted for the dwell time, so a
+    // load near a threshold does not toggle it every tick.
+    if (want != adapt.want) {
+        adapt.want = want;
+        adapt.wanted_ms = 0U;
+    }
+    if (adapt.wanted_ms < g_pwm_dwell_ms) {
+        adapt.wanted_ms += sync.tick_ms;
+        if (g_pwm_adapt && adapt.wanted_ms < g_pwm_dwell_ms)
+            return;
+    }
+    const uint32_t top = (want < 0) ? sync.nominal_top >> 1U
+                       : (want > 0) ? sync.nominal_top << 1U : sync.nominal_top;
+    sync.top_request = top;
+}
+
+void Peripheral_PWM_SetDriveMode(uint8_t axis, uint8_t mode) {
+    if (mode < PERIPHERAL_DRIVE_MODES)
+        g_drive_mode[axis] = mode;
+}
+
+uint8_t Peripheral_PWM_DriveMode(uint8_t axis) {
+    return hw.drive_mode[axis];
+}
+
+#endif
+
 /* ----------------- Encoder velocity ----------------- */
+#ifndef PERIPHERALS_ESTIMATOR_ONLY
 int32_t Peripheral_Encoder_CalculateVelocity(uint32_t ms) {
-    enum { BUF_N = 32 };
+    axis_ensure_init();
+    Peripheral_Encoder_LatchAll();
+    return Peripheral_Encoder_CalculateVelocityAxis(0, ms);
+}
 
-    // Previous raw encoder count (16-bit hardware counter).
-    static int16_t prev_count = 0;
-    // Previous time (ms).
-    static uint32_t prev_ms = 0;
+void Peripheral_Encoder_LatchAll(void) {
+    // Back-to-back reads with interrupts masked, so all axes are sampled
+    // within a few bus cycles of each other.
+    const uint32_t basepri = Irq_Lock();
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        // Encoder counter is 16-bit; cast preserves wrap-around behavior.
+        est.count[axis] = (int16_t)*hw.enc_cnt[axis];
+    }
+    Irq_Unlock(basepri);
+}
+#endif
 
-    // Circular buffers for delta counts and delta time.
-    static int16_t delta_count_buf[BUF_N];
-    static uint16_t delta_ms_buf[BUF_N];
-    static uint8_t buf_index = 0;
-    static uint8_t buf_count = 0;
+int16_t Peripheral_Encoder_Latched(uint8_t axis) {
+    return est.count[axis];
+}
 
-    // Rolling sums for the active window.
-    static int32_t sum_delta_count = 0;
-    static uint32_t sum_delta_ms = 0;
+void Peripheral_Encoder_SetLatched(uint8_t axis, int16_t count) {
+    est.count[axis] = count;
+}
 
-    // Last calculated velocity (RPM).
-    static int32_t vel_rpm = 0;
+uint32_t Peripheral_Encoder_SaveState(void *dst, uint32_t size) {
+    if (size < sizeof(est))
+        return 0U;
+    memcpy(dst, &est, sizeof(est));
+    return (uint32_t)sizeof(est);
+}
+
+uint8_t Peripheral_Encoder_RestoreState(const void *src, uint32_t size) {
+    if (size != sizeof(est))
+        return 0;
+    memcpy(&est, src, sizeof(est));
+    return 1;
+}
 
-    // Encoder counter is 16-bit; cast preserves wrap-around behavior.
-    const int16_t count = (int16_t)ENC_TIMER.Instance->CNT;
+int32_t Peripheral_Encoder_CalculateVelocityAxis(uint8_t axis, uint32_t ms) {
+    // Use the count latched by Peripheral_Encoder_LatchAll.
+    const int16_t count = est.count[axis];
 
-    if (prev_ms == 0U) {
+    int16_t *const delta_count_buf = est.delta_count_buf[axis];
+    uint16_t *const delta_ms_buf = est.delta_ms_buf[axis];
+    uint8_t buf_index = est.buf_index[axis];
+    uint8_t buf_count = est.buf_count[axis];
+    int32_t sum_delta_count = est.sum_delta_count[axis];
+    uint32_t sum_delta_ms = est.sum_delta_ms[axis];
+
+    if (est.prev_ms[axis] == 0U) {
         // First call initialization: zero history and return 0.
-        prev_count = count;
-        prev_ms = ms;
-        for (uint32_t i = 0; i < BUF_N; i++) {
+        est.prev_count[axis] = count;
+        est.prev_ms[axis] = ms;
+        for (uint32_t i = 0; i < VEL_BUF_N; i++) {
             delta_count_buf[i] = 0;
             delta_ms_buf[i] = 0;
         }
-        buf_index = 0;
-        buf_count = 0;
-        sum_delta_count = 0;
-        sum_delta_ms = 0;
-        vel_rpm = 0;
+        est.buf_index[axis] = 0;
+        est.buf_count[axis] = 0;
+        est.sum_delta_count[axis] = 0;
+        est.sum_delta_ms[axis] = 0;
+        est.vel_rpm[axis] = 0;
         return 0;
     }
 
     // Time delta; unsigned subtraction handles wrap-around of ms counter.
-    const uint32_t delta_ms = ms - prev_ms;
-    prev_ms = ms;
+    const uint32_t delta_ms = ms - est.prev_ms[axis];
+    est.prev_ms[axis] = ms;
     if (delta_ms == 0U)
-        return vel_rpm;
+        return est.vel_rpm[axis];
 
     // Signed subtraction handles counter wrap-around correctly.
-    const int16_t delta_count = (int16_t)(count - prev_count);
-    prev_count = count;
+    const int16_t delta_count = (int16_t)(count - est.prev_count[axis]);
+    est.prev_count[axis] = count;
 
     // Remove old sample
     sum_delta_count -= (int32_t)delta_count_buf[buf_index];
@@ -179,41 +748,284 @@ int32_t Peripheral_Encoder_CalculateVelocity(uint32_t ms) {
     sum_delta_ms += (uint32_t)delta_ms_buf[buf_index];
 
     buf_index++;
-    if (buf_index >= BUF_N)
+    if (buf_index >= VEL_BUF_N)
         buf_index = 0;
-    if (buf_count < BUF_N)
+    if (buf_count < VEL_BUF_N)
         buf_count++;
 
-    // Trim to approx g_vel_window_ms by removing oldest samples.
+    // Trim to approx g_vel_window_ms by removing oldest samples. The oldest
+    // sample sits buf_count slots behind the write index.
     while (sum_delta_ms > (uint32_t)g_vel_window_ms && buf_count > 1) {
-        sum_delta_count -= (int32_t)delta_count_buf[buf_index];
-        sum_delta_ms -= (uint32_t)delta_ms_buf[buf_index];
-        delta_count_buf[buf_index] = 0;
-        delta_ms_buf[buf_index] = 0;
-
-        buf_index++;
-        if (buf_index >= BUF_N)
-            buf_index = 0;
+        const uint8_t oldest = (uint8_t)((buf_index + VEL_BUF_N - buf_count) % VEL_BUF_N);
+        sum_delta_count -= (int32_t)delta_count_buf[oldest];
+        sum_delta_ms -= (uint32_t)delta_ms_buf[oldest];
+        delta_count_buf[oldest] = 0;
+        delta_ms_buf[oldest] = 0;
         buf_count--;
     }
 
+    est.buf_index[axis] = buf_index;
+    est.buf_count[axis] = buf_count;
+    est.sum_delta_count[axis] = sum_delta_count;
+    est.sum_delta_ms[axis] = sum_delta_ms;
+
     if (sum_delta_ms == 0U)
-        return vel_rpm;
+        return est.vel_rpm[axis];
 
     // RPM estimate:
     //   counts per window -> revolutions per minute
     const int64_t rpm_num = (int64_t)sum_delta_count * 60000LL;
     const int64_t rpm_den = (int64_t)ENCODER_COUNTS_PER_REV * (int64_t)sum_delta_ms;
     if (rpm_den == 0)
-        return vel_rpm;
+        return est.vel_rpm[axis];
 
     const int32_t rpm_est = (int32_t)(rpm_num / rpm_den);
 
     // Raw (unaveraged) velocity for debugging/Watch.
-    g_vel_raw_rpm = (int32_t)((int64_t)delta_count * 60000LL /
-                              ((int64_t)ENCODER_COUNTS_PER_REV * (int64_t)delta_ms));
+    g_vel_raw_rpm[axis] = (int32_t)((int64_t)delta_count * 60000LL /
+                                    ((int64_t)ENCODER_COUNTS_PER_REV * (int64_t)delta_ms));
 
     // Rolling average output (no extra IIR smoothing).
-    vel_rpm = rpm_est;
-    return vel_rpm;
+    est.vel_rpm[axis] = rpm_est;
+    return rpm_est;
 }
+
+#ifndef PERIPHERALS_ESTIMATOR_ONLY
+
+/* ----------------- Synchronisation ----------------- */
+void Peripheral_Sync_Init(uint32_t tick_ms) {
+    TIM_TypeDef *master = SYNC_MASTER.Instance;
+    axis_ensure_init();
+
+    // Stop everything so all counters can be armed from a known state.
+    master->CR1 &= ~TIM_CR1_CEN;
+    master->CNT = 0U;
+    const uint32_t top = master->ARR + 1U;
+
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        const axis_desc_t *d = &axis_desc[axis];
+        TIM_TypeDef *tim = d->pwm_timer->Instance;
+        if (d->pwm_timer == &SYNC_MASTER) {
+            if (d->phase_deg >= 180U) {
+                hw.late_edge[axis] = 1U;
+                // Redo the channel modes and idle levels for the new alignment.
+                drive_switch(axis, hw.drive_mode[axis], top);
+            }
+            continue;
+        }
+        // Slave in trigger mode: counter starts on the master TRGO, preloaded
+        // so its period begins phase_deg after the master's.
+        const uint32_t delay = (top * (uint32_t)d->phase_deg / 360U) % top;
+        tim->CR1 &= ~TIM_CR1_CEN;
+        tim->ARR = top - 1U;
+        tim->CNT = (top - delay) % top;
+        tim->SMCR = (tim->SMCR & ~(TIM_SMCR_SMS | TIM_SMCR_TS)) | d->sync_trigger | TIM_SLAVEMODE_TRIGGER;
+    }
+
+    // TRGO = counter enable, so setting CEN starts all slaves on the same clock.
+    master->CR2 = (master->CR2 & ~TIM_CR2_MMS) | TIM_TRGO_ENABLE;
+
+    // Every PWM timer gets the same period sequence; ARR is preloaded so a
+    // trimmed period takes effect at each timer's own next update.
+    sync.tim_count = 0U;
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        TIM_TypeDef *tim = axis_desc[axis].pwm_timer->Instance;
+        uint8_t seen = 0U;
+        for (uint8_t i = 0U; i < sync.tim_count; i++)
+            seen |= (uint8_t)(sync.tims[i] == tim);
+        if (!seen)
+            sync.tims[sync.tim_count++] = tim;
+        tim->CR1 |= TIM_CR1_ARPE;
+    }
+
+    // Pace the control tick from the master update rate (APB1 timer clock).
+    sync.clocks_per_us = HAL_RCC_GetPCLK1Freq() / 1000000U;
+    sync.clocks_per_tick = HAL_RCC_GetPCLK1Freq() / 1000U * tick_ms;
+    sync.tick_ms = tick_ms;
+    // Time starts one tick minus one period back, so the first update is
+    // already a tick (at tick_ms, on the tick grid) rather than a full tick
+    // period after start-up.
+    sync.acc = sync.clocks_per_tick - top;
+    sync.nominal_top = top;
+    sync.top_now = top;
+    sync.top_next = top;
+    sync.top_request = top;
+    g_pwm_top = top;
+    sync.elapsed = 0U;
+    sync.offset = (int64_t)(sync.clocks_per_tick - top);
+    sync.trim_q16 = 0;
+    sync.phase_left = 0;
+    sync.frac_q16 = 0U;
+    sync.trimming = 0U;
+    sync.align_request = 0U;
+
+    master->SR = ~TIM_SR_UIF;
+    master->DIER |= TIM_DIER_UIE;
+    HAL_NVIC_SetPriority(TIM3_IRQn, IRQ_PRIO_FAST, 0);
+    HAL_NVIC_EnableIRQ(TIM3_IRQn);
+    master->CR1 |= TIM_CR1_CEN;
+}
+
+// Length of the next PWM period: nominal, plus the frequency trim, minus a
+// slice of the outstanding phase error, with the fraction carried over.
+static void sync_next_period(void) {
+    int32_t slice = sync.phase_left;
+    if (slice > SYNC_SLEW_MAX)
+        slice = SYNC_SLEW_MAX;
+    if (slice < -SYNC_SLEW_MAX)
+        slice = -SYNC_SLEW_MAX;
+    sync.phase_left -= slice;
+
+    // The trim is per nominal period; a scaled carrier gets it in proportion.
+    const int64_t trim_q16 = (int64_t)sync.trim_q16 * sync.top_next / sync.nominal_top;
+    const int64_t len_q16 = ((int64_t)sync.top_next << 16) + trim_q16 - ((int64_t)slice << 16);
+    const uint64_t sum_q16 = (uint64_t)sync.frac_q16 + (uint64_t)len_q16;
+    sync.frac_q16 = (uint32_t)(sum_q16 & 0xFFFFU);
+    const uint32_t arr = (uint32_t)(sum_q16 >> 16) - 1U;
+    for (uint8_t i = 0U; i < sync.tim_count; i++)
+        sync.tims[i]->ARR = arr;
+}
+
+// Pull the next tick in to the next update, or take the last tick as the
+// aligned one, whichever is closer. ended is the period being accounted.
+static void sync_align(uint32_t ended) {
+    const uint32_t acc = sync.acc;
+    if (acc >= sync.clocks_per_tick / 2U) {
+        sync.acc = (sync.clocks_per_tick > ended) ? sync.clocks_per_tick - ended : 0U;
+    } else {
+        sync.acc = 0U;
+    }
+    if (sync.acc != acc)
+        sync.rephases++;
+}
+
+// Load a new carrier period for the next update: ARR of every PWM timer and
+// every compare value, scaled by the same power of two so each channel keeps
+// its duty. All of it is preloaded, so it takes effect together at the next
+// update of each timer. Slaves update phase_deg after the master, so this
+// must run early in the period (>= 256 clocks at 90 degrees of 1024).
+static void sync_retop(uint32_t top) {
+    const uint32_t old = sync.top_next;
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        if (top > old) {
+            *hw.ccr_cw[axis] <<= 1U;
+            *hw.ccr_ccw[axis] <<= 1U;
+        } else {
+            *hw.ccr_cw[axis] >>= 1U;
+            *hw.ccr_ccw[axis] >>= 1U;
+        }
+    }
+    sync.top_next = top;
+    sync.top_gen++;
+    g_pwm_top = top;
+    if (!sync.trimming) {
+        for (uint8_t i = 0U; i < sync.tim_count; i++)
+            sync.tims[i]->ARR = top - 1U;
+    }
+}
+
+uint8_t Peripheral_Sync_OnUpdate(void) {
+    TIM_TypeDef *master = SYNC_MASTER.Instance;
+
+    // Count the period and clear UIF (rc_w0) as one step, so a higher
+    // priority timestamp never sees one without the other.
+    const uint32_t basepri = Irq_Lock();
+    const uint32_t ended = sync.top_now;
+    sync.elapsed += ended;
+    sync.top_now = sync.top_next;
+    master->SR = ~TIM_SR_UIF;
+    Irq_Unlock(basepri);
+
+    // One scaling step per period, so the compare values stay exact.
+    const uint32_t request = sync.top_request;
+    if (request > sync.top_next)
+        sync_retop(sync.top_next << 1U);
+    else if (request < sync.top_next)
+        sync_retop(sync.top_next >> 1U);
+
+    if (sync.align_request) {
+        sync.align_request = 0U;
+        sync_align(ended);
+    }
+    if (sync.trimming)
+        sync_next_period();
+
+    sync.acc += ended;
+    if (sync.acc < sync.clocks_per_tick)
+        return 0;
+    sync.acc -= sync.clocks_per_tick;
+
+    // Common trigger instant: snapshot every encoder together.
+    Peripheral_Encoder_LatchAll();
+    return 1;
+}
+
+void Peripheral_Sync_Align(void) {
+    // Applied by the next update, so this is safe from any priority.
+    sync.align_request = 1U;
+}
+
+uint32_t Peripheral_Sync_Rephases(void) {
+    return sync.rephases;
+}
+
+uint64_t Peripheral_Sync_TimeUs(void) {
+    TIM_TypeDef *master = SYNC_MASTER.Instance;
+
+    const uint32_t basepri = Irq_Lock();
+    uint64_t elapsed = sync.elapsed;
+    uint32_t cnt = master->CNT;
+    if ((master->SR & TIM_SR_UIF) != 0U) {
+        // Update not serviced yet: it belongs to this reading, and CNT is
+        // re-read so it is certainly past the wrap.
+        elapsed += sync.top_now;
+        cnt = master->CNT;
+    }
+    const int64_t offset = sync.offset;
+    Irq_Unlock(basepri);
+
+    const int64_t clocks = (int64_t)(elapsed + cnt) + offset;
+    return (uint64_t)clocks / sync.clocks_per_us;
+}
+
+void Peripheral_Sync_Step(int64_t step_us) {
+    // Step by whole periods so every node's carrier stays on the same
+    // lattice; the remainder is slewed in like any other phase error.
+    const int64_t step = step_us * (int64_t)sync.clocks_per_us;
+    const int64_t top = (int64_t)sync.nominal_top;
+    const int64_t whole = ((step >= 0) ? (step + top / 2) : (step - top / 2)) / top * top;
+
+    // The fast layer updates these every period, and the tick layer that
+    // calls this can be preempted by it.
+    const uint32_t basepri = Irq_Lock();
+    sync.offset += whole;
+    sync.phase_left = (int32_t)(step - whole);
+    sync.trimming = 1U;
+
+    // Re-derive the tick phase from the new time so ticks land on the
+    // common grid of multiples of the tick period.
+    const uint64_t clocks = (uint64_t)((int64_t)sync.elapsed + sync.offset);
+    sync.acc = (uint32_t)(clocks % sync.clocks_per_tick);
+    sync.rephases++;
+    Irq_Unlock(basepri);
+}
+
+void Peripheral_Sync_Trim(int32_t ppb, int32_t phase_us) {
+    // Running fast by ppb means each nominal period takes ppb fewer clocks.
+    const int32_t trim_q16 = (int32_t)(-((int64_t)sync.nominal_top * 65536 * ppb) / 1000000000);
+    const uint32_t basepri = Irq_Lock();
+    sync.trim_q16 = trim_q16;
+    sync.phase_left = phase_us * (int32_t)sync.clocks_per_us;
+    sync.trimming = 1U;
+    Irq_Unlock(basepri);
+}
+
+/* ----------------- Cycle counter ----------------- */
+void Peripheral_Cycles_Init(void) {
+    // DWT needs the trace block enabled before CYCCNT starts counting.
+    // The count is not reset: the boot profile started it at main entry.
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+#endif
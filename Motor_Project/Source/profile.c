@@ -0,0 +1,357 @@
+// profile.c
+#define LOG_FILE_ID 9
+#include "profile.h"
+#include "application.h"
+#include "log.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// This file implements the profile interpreter and reference arbitration of
+// profile.h:
+//  - the interpreter keeps the start time of the instruction in progress
+//    and the reference it started from; a finished timed instruction moves
+//    the start on by exactly its duration
+//  - SINE uses a quarter-wave table with linear interpolation, no floating
+//    point
+//  - images are checked once, when loaded; the interpreter then trusts the
+//    script (every NEXT has its LOOP, the last instruction is END)
+
+/* ----------------- Built-in scripts ----------------- */
+
+static const Profile_Insn_t flip[] = {
+    {PROFILE_LOOP, 0U, 0, 0U},
+    {PROFILE_STEP, 0U, 2000, 0U},
+    {PROFILE_DWELL, 0U, 0, PERIOD_REF},
+    {PROFILE_STEP, 0U, -2000, 0U},
+    {PROFILE_DWELL, 0U, 0, PERIOD_REF},
+    {PROFILE_NEXT, 0U, 0, 0U},
+    {PROFILE_END, 0U, 0, 0U},
+};
+
+static const Profile_Insn_t ramps[] = {
+    {PROFILE_LOOP, 0U, 0, 0U},
+    {PROFILE_RAMP, 0U, 3000, 2000U},
+    {PROFILE_DWELL, 0U, 0, 1000U},
+    {PROFILE_RAMP, 0U, -3000, 4000U},
+    {PROFILE_DWELL, 0U, 0, 1000U},
+    {PROFILE_RAMP, 0U, 0, 2000U},
+    {PROFILE_DWELL, 0U, 0, 1000U},
+    {PROFILE_NEXT, 0U, 0, 0U},
+    {PROFILE_END, 0U, 0, 0U},
+};
+
+static const Profile_Insn_t sines[] = {
+    {PROFILE_RAMP, 0U, 1500, 1000U},
+    {PROFILE_LOOP, 0U, 0, 0U},
+    {PROFILE_SINE, 3U, 500, 2000U},
+    {PROFILE_SINE, 6U, 500, 500U},
+    {PROFILE_DWELL, 0U, 0, 1000U},
+    {PROFILE_NEXT, 0U, 0, 0U},
+    {PROFILE_END, 0U, 0, 0U},
+};
+
+static const struct {
+    const Profile_Insn_t *insn;
+    uint16_t count;
+} builtin[] = {
+    {flip, sizeof(flip) / sizeof(flip[0])},
+    {ramps, sizeof(ramps) / sizeof(ramps[0])},
+    {sines, sizeof(sines) / sizeof(sines[0])},
+};
+#define BUILTIN_COUNT (sizeof(builtin) / sizeof(builtin[0]))
+
+/* ----------------- State ----------------- */
+
+Profile_t g_profile = {
+    .max_rpm = 6000,
+    .slew_rpm_s = 0,
+};
+Profile_Image_t g_profile_upload;
+
+// Interpreter: script, instruction in progress, its start time and the
+// reference it started from, and the open loops.
+static struct {
+    const Profile_Insn_t *code;
+    uint32_t start_ms;
+    int32_t from;
+    uint8_t depth;
+    uint8_t loop_pc[PROFILE_LOOP_DEPTH];
+    uint32_t loop_left[PROFILE_LOOP_DEPTH];
+} it;
+
+// RAM copy of the uploaded script.
+static Profile_Insn_t ram_script[PROFILE_INSNS_MAX];
+
+// Arbitration: reference handed out last, per axis, for the rate limit.
+static struct {
+    int32_t last[AXIS_COUNT];
+    uint32_t last_ms[AXIS_COUNT];
+} arb;
+
+/* ----------------- Helpers ----------------- */
+
+// sin(pi/2 * x / 64) for x = 0..64, Q15: one quarter wave.
+static const int16_t sine_table[65] = {
+    0, 804, 1608, 2410, 3212, 4011, 4808, 5602,
+    6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+    12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+    18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+    23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+    27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+    30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+    32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+    32767,
+};
+
+// Sine of a phase in turns (2^32 = one turn), Q15.
+static int32_t sine_q15(uint32_t turn) {
+    uint32_t x = turn & 0x3FFFFFFFU;
+    if (turn & 0x40000000U)
+        x = 0x40000000U - x;
+    const uint32_t i = x >> 24;
+    int32_t v = sine_table[i];
+    if (i < 64U) {
+        const int32_t frac = (int32_t)((x >> 8) & 0xFFFFU);
+        v += ((sine_table[i + 1U] - v) * frac) >> 16;
+    }
+    return (turn & 0x80000000U) ? -v : v;
+}
+
+static inline int32_t clamp_rpm(int32_t x, int32_t limit) {
+    if (x > limit)
+        return limit;
+    if (x < -limit)
+        return -limit;
+    return x;
+}
+
+// Check a script; PROFILE_OK or the first error found.
+static uint8_t check(const Profile_Insn_t *insn, uint32_t count) {
+    if (count == 0U || count > PROFILE_INSNS_MAX)
+        return PROFILE_ERR_SIZE;
+    uint32_t depth = 0U;
+    for (uint32_t i = 0U; i < count; i++) {
+        const Profile_Insn_t *in = &insn[i];
+        switch (in->op) {
+        case PROFILE_END:
+        case PROFILE_STEP:
+        case PROFILE_RAMP:
+        case PROFILE_DWELL:
+            break;
+        case PROFILE_SINE:
+            if (in->arg == 0U || in->n == 0U || (uint64_t)in->arg * in->n > (uint64_t)INT32_MAX)
+                return PROFILE_ERR_OPCODE;
+            break;
+        case PROFILE_LOOP:
+            if (++depth > PROFILE_LOOP_DEPTH)
+                return PROFILE_ERR_LOOP;
+            break;
+        case PROFILE_NEXT:
+            if (depth == 0U)
+                return PROFILE_ERR_LOOP;
+            depth--;
+            break;
+        default:
+            return PROFILE_ERR_OPCODE;
+        }
+    }
+    if (depth != 0U)
+        return PROFILE_ERR_LOOP;
+    if (insn[count - 1U].op != PROFILE_END)
+        return PROFILE_ERR_END;
+    return PROFILE_OK;
+}
+
+// Start a checked script at millisec, from the reference in effect.
+static void start(const Profile_Insn_t *insn, uint8_t script, uint32_t millisec) {
+    it.code = insn;
+    it.start_ms = millisec;
+    it.from = g_profile.reference;
+    it.depth = 0U;
+    g_profile.script = script;
+    g_profile.pc = 0U;
+    g_profile.running = 1U;
+}
+
+// Move on to the next instruction, starting from the reference reached.
+static inline void next(void) {
+    g_profile.pc++;
+    it.from = g_profile.reference;
+}
+
+// Advance the script to millisec, running at most PROFILE_STEPS_MAX
+// instructions.
+static void run(uint32_t millisec) {
+    uint32_t steps = 0U;
+    while (g_profile.running && steps < PROFILE_STEPS_MAX) {
+        const Profile_Insn_t *in = &it.code[g_profile.pc];
+        const uint32_t elapsed = millisec - it.start_ms;
+        steps++;
+        switch (in->op) {
+        case PROFILE_STEP:
+            g_profile.reference = in->rpm;
+            next();
+            continue;
+        case PROFILE_RAMP:
+            if (elapsed < in->arg) {
+                const int64_t span = (int64_t)in->rpm - (int64_t)it.from;
+                g_profile.reference = (int32_t)((int64_t)it.from + span * (int64_t)elapsed / (int64_t)in->arg);
+                break;
+            }
+            g_profile.reference = in->rpm;
+            it.start_ms += in->arg;
+            next();
+            continue;
+        case PROFILE_SINE: {
+            const uint32_t total = in->arg * in->n;
+            if (elapsed < total) {
+                const uint32_t turn = (uint32_t)(((uint64_t)(elapsed % in->arg) << 32) / in->arg);
+                g_profile.reference = it.from + ((in->rpm * sine_q15(turn)) >> 15);
+                break;
+            }
+            g_profile.reference = it.from;
+            it.start_ms += total;
+            next();
+            continue;
+        }
+        case PROFILE_DWELL:
+            if (elapsed < in->arg)
+                break;
+            it.start_ms += in->arg;
+            next();
+            continue;
+        case PROFILE_LOOP:
+            it.loop_pc[it.depth] = (uint8_t)(g_profile.pc + 1U);
+            it.loop_left[it.depth] = in->arg;
+            it.depth++;
+            next();
+            continue;
+        case PROFILE_NEXT: {
+            const uint8_t top = (uint8_t)(it.depth - 1U);
+            // A count of 0 repeats forever; otherwise count passes in all.
+            if (it.loop_left[top] == 0U || --it.loop_left[top] != 0U) {
+                g_profile.pc = it.loop_pc[top];
+                it.from = g_profile.reference;
+            } else {
+                it.depth = top;
+                next();
+            }
+            continue;
+        }
+        default:
+            g_profile.running = 0U;
+            LOG2("profile: script %u ended at %u ms", g_profile.script, millisec);
+            break;
+        }
+        break;
+    }
+    if (steps > g_profile.steps_max)
+        g_profile.steps_max = (uint8_t)steps;
+}
+
+/* ----------------- API ----------------- */
+
+uint32_t Profile_Hash(const Profile_Insn_t *insn, uint32_t count) {
+    // FNV-1a over the bytes of each field, little-endian.
+    uint32_t hash = 2166136261U;
+    for (uint32_t i = 0U; i < count; i++) {
+        const uint32_t rpm = (uint32_t)(uint16_t)insn[i].rpm;
+        const uint8_t bytes[8] = {
+            insn[i].op, insn[i].n, (uint8_t)rpm, (uint8_t)(rpm >> 8),
+            (uint8_t)insn[i].arg, (uint8_t)(insn[i].arg >> 8), (uint8_t)(insn[i].arg >> 16), (uint8_t)(insn[i].arg >> 24),
+        };
+        for (uint32_t b = 0U; b < 8U; b++)
+            hash = (hash ^ bytes[b]) * 16777619U;
+    }
+    return hash;
+}
+
+void Profile_Init(uint32_t millisec) {
+    g_profile.cmd = PROFILE_CMD_NONE;
+    g_profile.status = PROFILE_OK;
+    g_profile.steps_max = 0U;
+    g_profile.reference = 0;
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        g_profile.source[axis] = PROFILE_SRC_SCRIPT;
+        g_profile.limited[axis] = 0U;
+        arb.last[axis] = 0;
+        arb.last_ms[axis] = millisec;
+    }
+    start(builtin[0].insn, 0U, millisec);
+    run(millisec);
+}
+
+uint8_t Profile_Load(const Profile_Image_t *image, uint32_t millisec) {
+    uint8_t status = PROFILE_OK;
+    if (image->magic != PROFILE_MAGIC)
+        status = PROFILE_ERR_MAGIC;
+    else if (image->count == 0U || image->count > PROFILE_INSNS_MAX)
+        status = PROFILE_ERR_SIZE;
+    else if (Profile_Hash(image->insn, image->count) != image->hash)
+        status = PROFILE_ERR_HASH;
+    else
+        status = check(image->insn, image->count);
+
+    g_profile.status = status;
+    if (status != PROFILE_OK) {
+        LOG1("profile: upload rejected, error %u", status);
+        return status;
+    }
+    for (uint32_t i = 0U; i < image->count; i++)
+        ram_script[i] = image->insn[i];
+    start(ram_script, PROFILE_RUN_RAM, millisec);
+    LOG2("profile: running upload of %u instructions from %u ms", image->count, millisec);
+    return PROFILE_OK;
+}
+
+void Profile_Tick(uint32_t millisec) {
+    const uint8_t cmd = g_profile.cmd;
+    if (cmd != PROFILE_CMD_NONE) {
+        g_profile.cmd = PROFILE_CMD_NONE;
+        if (cmd == PROFILE_CMD_UPLOAD) {
+            Profile_Load(&g_profile_upload, millisec);
+        } else if (cmd == PROFILE_CMD_FLASH) {
+            const uint8_t n = g_profile.arg;
+            g_profile.status = (n < BUILTIN_COUNT) ? check(builtin[n].insn, builtin[n].count) : PROFILE_ERR_INDEX;
+            if (g_profile.status == PROFILE_OK) {
+                start(builtin[n].insn, n, millisec);
+                LOG2("profile: running script %u from %u ms", n, millisec);
+            }
+        } else if (cmd == PROFILE_CMD_STOP) {
+            g_profile.running = 0U;
+            g_profile.reference = 0;
+            LOG1("profile: stopped at %u ms", millisec);
+        }
+    }
+    run(millisec);
+}
+
+int32_t Profile_Arbitrate(uint8_t axis, const int32_t *remote, uint32_t millisec) {
+    const uint32_t delta_ms = millisec - arb.last_ms[axis];
+    arb.last_ms[axis] = millisec;
+
+    // Bus command first, then the script.
+    int32_t want = g_profile.reference;
+    g_profile.source[axis] = PROFILE_SRC_SCRIPT;
+    if (remote != NULL) {
+        want = *remote;
+        g_profile.source[axis] = PROFILE_SRC_REMOTE;
+    }
+
+    // Safety limits on whatever won.
+    const int32_t max_rpm = (g_profile.max_rpm > 0) ? g_profile.max_rpm : 0;
+    int32_t ref = clamp_rpm(want, max_rpm);
+    const int32_t slew = g_profile.slew_rpm_s;
+    if (slew > 0) {
+        const int64_t step = ((int64_t)slew * (int64_t)delta_ms) / 1000;
+        const int64_t last = arb.last[axis];
+        if ((int64_t)ref > last + step)
+            ref = (int32_t)(last + step);
+        else if ((int64_t)ref < last - step)
+            ref = (int32_t)(last - step);
+    }
+    if (ref != want)
+        g_profile.limited[axis]++;
+    arb.last[axis] = ref;
+    return ref;
+}
@@ -0,0 +1,399 @@
+// recorder.c
+#include "recorder.h"
+#include "controller.h"
+#include "peripherals.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// This file records the raw inputs of the control loop so a field run can be
+// replayed bit-exactly on the host (Tools/host/replay.c):
+//  - a keyframe with the absolute inputs, the tunables and the estimator and
+//    controller state, so a recording may start on a running drive
+//  - then one record per tick: encoder count deltas as zigzag varints, plus
+//    the tick period, reference deltas and tunable changes only when they
+//    differ, and a checksum of the control outputs every few ticks
+//  - the outputs that reached the bridge, on the ticks where the drive ramp
+//    or the stall detector changed them; the thermal model heats with them
+// A steady tick costs one byte plus one or two per axis. The reader half is
+// hardware-free and shared with the replay tool, which links it against the
+// same controller.c and estimator code.
+
+/* ----------------- Tunables ----------------- */
+
+// Watch-tunable globals that change the control output (controller.c and
+// peripherals.c); the order is the parameter id in the stream.
+extern volatile int32_t Kp, Ki, U_PER_RPM, ERR_DEADBAND_RPM, INT_WINDOW_RPM, I_CLAMP;
+extern volatile int32_t REV_MODE, REV_I_LIMIT, REV_HANDOFF_RPM, REV_BRAKE_RPM, REV_LEAD_MS;
+extern volatile int32_t THERM_I_CONT, THERM_TAU_MS, THERM_DERATE_AT;
+extern volatile int32_t MANUAL_AXES, MANUAL_DUTY[AXIS_MAX];
+extern volatile int32_t g_vel_window_ms;
+
+static volatile int32_t *const tunables[RECORDER_PARAMS] = {
+    &Kp, &Ki, &U_PER_RPM, &ERR_DEADBAND_RPM, &INT_WINDOW_RPM, &I_CLAMP, &g_vel_window_ms,
+    &REV_MODE, &REV_I_LIMIT, &REV_HANDOFF_RPM, &REV_BRAKE_RPM, &REV_LEAD_MS,
+    &THERM_I_CONT, &THERM_TAU_MS, &THERM_DERATE_AT,
+    &MANUAL_AXES, &MANUAL_DUTY[0], &MANUAL_DUTY[1], &MANUAL_DUTY[2], &MANUAL_DUTY[3],
+};
+_Static_assert(AXIS_MAX == 4, "list every MANUAL_DUTY entry in tunables");
+
+/* ----------------- State ----------------- */
+
+// Worst-case tick record: type, period, counts, references, applied outputs,
+// tunables, checksum.
+#define TICK_MAX (1U + 5U + 3U * AXIS_COUNT + 10U * AXIS_COUNT + 1U + 6U * RECORDER_PARAMS + 4U)
+
+Recorder_Buffer_t g_recorder;
+
+// Set from Watch to start a new recording.
+volatile uint8_t g_recorder_arm = 0;
+
+// Writer side: the last values written, base of the next deltas.
+static struct {
+    uint32_t millisec;
+    int16_t counts[AXIS_COUNT];
+    int32_t reference[AXIS_COUNT];
+    int32_t params[RECORDER_PARAMS];
+    uint32_t hash;
+} rec;
+
+/* ----------------- Encoding ----------------- */
+
+static inline uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1U);
+}
+
+static uint8_t *put_varint(uint8_t *p, uint32_t v) {
+    while (v >= 0x80U) {
+        *p++ = (uint8_t)(v | 0x80U);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+    for (uint32_t i = 0U; i < 4U; i++)
+        *p++ = (uint8_t)(v >> (8U * i));
+    return p;
+}
+
+static uint8_t *put_u16(uint8_t *p, uint32_t v) {
+    *p++ = (uint8_t)v;
+    *p++ = (uint8_t)(v >> 8);
+    return p;
+}
+
+// Readers return NULL once they would run past end.
+static const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint32_t *v) {
+    uint32_t x = 0U;
+    for (uint32_t shift = 0U; shift < 35U; shift += 7U) {
+        if (p >= end)
+            return NULL;
+        const uint8_t b = *p++;
+        x |= (uint32_t)(b & 0x7FU) << shift;
+        if ((b & 0x80U) == 0U) {
+            *v = x;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static const uint8_t *get_u32(const uint8_t *p, const uint8_t *end, uint32_t *v) {
+    if (end - p < 4)
+        return NULL;
+    *v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    return p + 4;
+}
+
+static const uint8_t *get_u16(const uint8_t *p, const uint8_t *end, uint32_t *v) {
+    if (end - p < 2)
+        return NULL;
+    *v = (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+    return p + 2;
+}
+
+/* ----------------- Recording ----------------- */
+
+void Recorder_Init(uint32_t period_ms) {
+    g_recorder.magic = RECORDER_MAGIC;
+    g_recorder.axis_count = AXIS_COUNT;
+    g_recorder.period_ms = period_ms;
+    g_recorder.capacity = RECORDER_BYTES;
+    g_recorder.used = 0U;
+    g_recorder.ticks = 0U;
+    g_recorder.state = RECORDER_IDLE;
+    // Record from the first tick on.
+    Recorder_Arm();
+}
+
+void Recorder_Arm(void) {
+    g_recorder_arm = 1U;
+}
+
+uint32_t Recorder_Hash(uint32_t hash, const int32_t *control) {
+    // FNV-1a over whole words.
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++)
+        hash = (hash ^ (uint32_t)control[axis]) * 16777619U;
+    return hash;
+}
+
+// Keyframe: the state after this tick, which the next record builds on.
+static void start(uint32_t millisec, const int16_t *counts, const int32_t *reference) {
+    uint8_t *const data = g_recorder.data;
+    uint8_t *p = data;
+    g_recorder.used = 0U;
+    g_recorder.ticks = 0U;
+    g_recorder.state = RECORDER_FULL;
+
+    *p++ = RECORDER_KEYFRAME;
+    p = put_u32(p, millisec);
+    rec.millisec = millisec;
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        p = put_u16(p, (uint16_t)counts[axis]);
+        rec.counts[axis] = counts[axis];
+    }
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        p = put_u32(p, (uint32_t)reference[axis]);
+        rec.reference[axis] = reference[axis];
+    }
+    *p++ = RECORDER_PARAMS;
+    for (uint32_t i = 0U; i < RECORDER_PARAMS; i++) {
+        rec.params[i] = *tunables[i];
+        p = put_u32(p, (uint32_t)rec.params[i]);
+    }
+
+    // State blobs, each with its size; a buffer too small leaves us FULL.
+    uint32_t room = RECORDER_BYTES - (uint32_t)(p - data);
+    if (room < 2U)
+        return;
+    uint32_t n = Peripheral_Encoder_SaveState(p + 2, room - 2U);
+    if (n == 0U)
+        return;
+    p = put_u16(p, n) + n;
+    room -= 2U + n;
+    if (room < 2U)
+        return;
+    n = Controller_SaveState(p + 2, room - 2U);
+    if (n == 0U)
+        return;
+    p = put_u16(p, n) + n;
+
+    rec.hash = 0U;
+    g_recorder.used = (uint32_t)(p - data);
+    g_recorder.state = RECORDER_RUNNING;
+}
+
+void Recorder_Tick(uint32_t millisec, const int16_t *counts, const int32_t *reference,
+                   const int32_t *control, const int32_t *applied) {
+#if RECORDER_ENABLE
+    if (g_recorder_arm) {
+        g_recorder_arm = 0U;
+        start(millisec, counts, reference);
+        return;
+    }
+    if (g_recorder.state != RECORDER_RUNNING)
+        return;
+    if (RECORDER_BYTES - g_recorder.used < TICK_MAX) {
+        g_recorder.state = RECORDER_FULL;
+        return;
+    }
+
+    uint8_t *const head = &g_recorder.data[g_recorder.used];
+    uint8_t *p = head + 1;
+    uint8_t type = RECORDER_TICK;
+
+    const uint32_t dt = millisec - rec.millisec;
+    rec.millisec = millisec;
+    if (dt != g_recorder.period_ms) {
+        type |= RECORDER_F_MS;
+        p = put_varint(p, zigzag((int32_t)(dt - g_recorder.period_ms)));
+    }
+
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        // 16-bit wrap, same as the estimator.
+        const int16_t delta = (int16_t)(counts[axis] - rec.counts[axis]);
+        rec.counts[axis] = counts[axis];
+        p = put_varint(p, zigzag(delta));
+    }
+
+    uint8_t ref_changed = 0U;
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++)
+        ref_changed |= (uint8_t)(reference[axis] != rec.reference[axis]);
+    if (ref_changed) {
+        type |= RECORDER_F_REF;
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+            p = put_varint(p, zigzag((int32_t)((uint32_t)reference[axis] - (uint32_t)rec.reference[axis])));
+            rec.reference[axis] = reference[axis];
+        }
+    }
+
+    uint8_t gated = 0U;
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++)
+        gated |= (uint8_t)(applied[axis] != control[axis]);
+    if (gated) {
+        type = (uint8_t)(RECORDER_TICK_APPLIED | (type & 0x0FU));
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++)
+            p = put_varint(p, zigzag(applied[axis]));
+    }
+
+    // Tunables seen now take effect from the next tick on.
+    uint8_t *const changes = p;
+    uint8_t changed = 0U;
+    p++;
+    for (uint32_t i = 0U; i < RECORDER_PARAMS; i++) {
+        const int32_t value = *tunables[i];
+        if (value == rec.params[i])
+            continue;
+        rec.params[i] = value;
+        *p++ = (uint8_t)i;
+        p = put_varint(p, zigzag(value));
+        changed++;
+    }
+    if (changed) {
+        type |= RECORDER_F_PARAM;
+        *changes = changed;
+    } else {
+        p--;
+    }
+
+    rec.hash = Recorder_Hash(rec.hash, control);
+    g_recorder.ticks++;
+    if (g_recorder.ticks % RECORDER_CHECK_TICKS == 0U) {
+        type |= RECORDER_F_CHECK;
+        p = put_u32(p, rec.hash);
+    }
+
+    *head = type;
+    g_recorder.used = (uint32_t)(p - g_recorder.data);
+#else
+    (void)millisec;
+    (void)counts;
+    (void)reference;
+    (void)control;
+    (void)applied;
+#endif
+}
+
+/* ----------------- Replay ----------------- */
+
+static void apply_params(const int32_t *params) {
+    for (uint32_t i = 0U; i < RECORDER_PARAMS; i++)
+        *tunables[i] = params[i];
+}
+
+uint8_t Recorder_ReaderInit(Recorder_Reader_t *reader, const Recorder_Buffer_t *buffer) {
+    if (buffer->magic != RECORDER_MAGIC || buffer->axis_count != AXIS_COUNT ||
+        buffer->used == 0U || buffer->used > RECORDER_BYTES || buffer->data[0] != RECORDER_KEYFRAME)
+        return 0;
+    const uint8_t *p = &buffer->data[1];
+    const uint8_t *const end = &buffer->data[buffer->used];
+    uint32_t v;
+
+    if ((p = get_u32(p, end, &reader->last.millisec)) == NULL)
+        return 0;
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        if ((p = get_u16(p, end, &v)) == NULL)
+            return 0;
+        reader->last.counts[axis] = (int16_t)v;
+    }
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        if ((p = get_u32(p, end, &v)) == NULL)
+            return 0;
+        reader->last.reference[axis] = (int32_t)v;
+    }
+    if (p >= end || *p++ != RECORDER_PARAMS)
+        return 0;
+    for (uint32_t i = 0U; i < RECORDER_PARAMS; i++) {
+        if ((p = get_u32(p, end, &v)) == NULL)
+            return 0;
+        reader->params[i] = (int32_t)v;
+    }
+
+    if ((p = get_u16(p, end, &v)) == NULL || (uint32_t)(end - p) < v ||
+        !Peripheral_Encoder_RestoreState(p, v))
+        return 0;
+    p += v;
+    if ((p = get_u16(p, end, &v)) == NULL || (uint32_t)(end - p) < v ||
+        !Controller_RestoreState(p, v))
+        return 0;
+    p += v;
+
+    apply_params(reader->params);
+    reader->params_pending = 0U;
+    reader->last.has_check = 0U;
+    reader->period_ms = buffer->period_ms;
+    reader->p = p;
+    reader->end = end;
+    return 1;
+}
+
+int8_t Recorder_ReaderNext(Recorder_Reader_t *reader, Recorder_Tick_t *tick) {
+    if (reader->params_pending) {
+        apply_params(reader->params);
+        reader->params_pending = 0U;
+    }
+    const uint8_t *p = reader->p;
+    const uint8_t *const end = reader->end;
+    if (p == end)
+        return 0;
+    const uint8_t type = *p++;
+    if ((type & 0xF0U) != RECORDER_TICK && (type & 0xF0U) != RECORDER_TICK_APPLIED)
+        return -1;
+
+    Recorder_Tick_t *const last = &reader->last;
+    uint32_t v;
+    uint32_t dt = reader->period_ms;
+    if (type & RECORDER_F_MS) {
+        if ((p = get_varint(p, end, &v)) == NULL)
+            return -1;
+        dt += (uint32_t)unzigzag(v);
+    }
+    last->millisec += dt;
+
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        if ((p = get_varint(p, end, &v)) == NULL)
+            return -1;
+        last->counts[axis] = (int16_t)(last->counts[axis] + unzigzag(v));
+    }
+    if (type & RECORDER_F_REF) {
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+            if ((p = get_varint(p, end, &v)) == NULL)
+                return -1;
+            last->reference[axis] = (int32_t)((uint32_t)last->reference[axis] + (uint32_t)unzigzag(v));
+        }
+    }
+    last->has_applied = (uint8_t)((type & 0xF0U) == RECORDER_TICK_APPLIED);
+    if (last->has_applied) {
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+            if ((p = get_varint(p, end, &v)) == NULL)
+                return -1;
+            last->applied[axis] = unzigzag(v);
+        }
+    }
+    if (type & RECORDER_F_PARAM) {
+        if (p >= end)
+            return -1;
+        const uint8_t n = *p++;
+        for (uint8_t i = 0; i < n; i++) {
+            if (p >= end || *p >= RECORDER_PARAMS)
+                return -1;
+            const uint8_t id = *p++;
+            if ((p = get_varint(p, end, &v)) == NULL)
+                return -1;
+            reader->params[id] = unzigzag(v);
+        }
+        reader->params_pending = 1U;
+    }
+    last->has_check = (uint8_t)((type & RECORDER_F_CHECK) != 0U);
+    if (last->has_check && (p = get_u32(p, end, &last->check)) == NULL)
+        return -1;
+
+    reader->p = p;
+    *tick = *last;
+    return 1;
+}
@@ -0,0 +1,133 @@
+// stall.c
+#define LOG_FILE_ID 7
+#include "stall.h"
+#include "drive.h"
+#include "log.h"
+#include <stdint.h>
+
+// This file implements the stall detector of stall.h:
+//  - the current estimate is the controller's: control minus U_PER_RPM times
+//    the measured speed, in Q30 of stall current
+//  - acceleration is the speed change since the last tick, in RPM/s
+//  - the effort needed is min(effort, (effort + |U_PER_RPM * reference|) / 2)
+//  - suspect time restarts at zero on every plausible tick, so noise between
+//    suspect ticks cannot add up to a trip
+//  - a trip raises DRIVE_FAULT_STALL and a retry clears it; the drive state
+//    machine switches the bridge and soft-starts the axis again, and holds it
+//    off while any other fault is latched
+
+#define STALL_SAT ((int32_t)0x3F000000)	// |control| at or above this is at its limit
+#define RETRY_SHIFT_MAX 8U				// Longest retry wait: retry_ms << 8
+
+extern volatile int32_t U_PER_RPM;
+
+Stall_Config_t g_stall_cfg = {
+    .trip_ms = 300U,
+    .rpm = 60,
+    .effort = 53687091,	// 0.05 of stall current
+    .accel = 2000,
+    .retry_ms = 1000U,
+    .retries = 3U,
+    .healthy_ms = 5000U,
+};
+Stall_Axis_t g_stall[AXIS_COUNT];
+
+static struct {
+    uint32_t last_ms[AXIS_COUNT];		// Tick time of the last check
+    int32_t last_rpm[AXIS_COUNT];		// Velocity at the last check
+    uint32_t healthy_ms[AXIS_COUNT];	// Running time without a suspect tick
+} st;
+
+static inline int32_t abs32(int32_t x) {
+    return (x < 0) ? -x : x;
+}
+
+void Stall_Init(void) {
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        g_stall[axis] = (Stall_Axis_t){0};
+        st.last_ms[axis] = 0U;
+        st.last_rpm[axis] = 0;
+        st.healthy_ms[axis] = 0U;
+    }
+}
+
+// One tick of the detector while running; non-zero when the axis trips.
+static uint8_t detect(uint8_t axis, int32_t reference, int32_t velocity, int32_t control, uint32_t delta_ms) {
+    Stall_Axis_t *s = &g_stall[axis];
+    const int64_t dir = (control < 0) ? -1 : 1;
+    const int64_t current = (int64_t)control - (int64_t)U_PER_RPM * (int64_t)velocity;
+    const int64_t accel = ((int64_t)velocity - (int64_t)st.last_rpm[axis]) * 1000 / (int64_t)delta_ms;
+
+    // Low references cannot push effort through a blocked shaft.
+    int64_t ff = (int64_t)U_PER_RPM * (int64_t)reference;
+    if (ff < 0)
+        ff = -ff;
+    int64_t effort = ((int64_t)g_stall_cfg.effort + ff) / 2;
+    if (effort > (int64_t)g_stall_cfg.effort)
+        effort = (int64_t)g_stall_cfg.effort;
+
+    const uint8_t suspect = control != 0
+        && dir * current >= effort
+        && abs32(velocity) < g_stall_cfg.rpm
+        && dir * accel < (int64_t)g_stall_cfg.accel;
+    if (!suspect) {
+        s->suspect_ms = 0U;
+        if (st.healthy_ms[axis] < g_stall_cfg.healthy_ms)
+            st.healthy_ms[axis] += delta_ms;
+        else
+            s->attempt = 0U;
+        return 0U;
+    }
+
+    st.healthy_ms[axis] = 0U;
+    s->suspect_ms += (abs32(control) >= STALL_SAT) ? 2U * delta_ms : delta_ms;
+    return s->suspect_ms >= g_stall_cfg.trip_ms;
+}
+
+int32_t Stall_Check(uint8_t axis, int32_t reference, int32_t velocity, int32_t control, uint32_t millisec) {
+    Stall_Axis_t *s = &g_stall[axis];
+    const uint32_t delta_ms = millisec - st.last_ms[axis];
+    st.last_ms[axis] = millisec;
+
+    uint8_t tripped = 0U;
+    if (s->state == STALL_RUNNING && delta_ms != 0U)
+        tripped = detect(axis, reference, velocity, control, delta_ms);
+    st.last_rpm[axis] = velocity;
+
+    if (tripped) {
+        Drive_Fault(axis, DRIVE_FAULT_STALL);
+        s->trips++;
+        s->last_trip_ms = millisec;
+        s->state = (s->attempt >= g_stall_cfg.retries) ? STALL_LOCKED : STALL_SAFE;
+        LOG4("stall: axis %u tripped at %d rpm, control %d, attempt %u", axis, velocity, control, s->attempt);
+        if (s->state == STALL_LOCKED)
+            LOG2("stall: axis %u locked out after %u retries", axis, s->attempt);
+        return 0;
+    }
+
+    if (s->state == STALL_SAFE) {
+        const uint32_t shift = (s->attempt < RETRY_SHIFT_MAX) ? s->attempt : RETRY_SHIFT_MAX;
+        if (millisec - s->last_trip_ms < (g_stall_cfg.retry_ms << shift))
+            return 0;
+        s->attempt++;
+        s->suspect_ms = 0U;
+        st.healthy_ms[axis] = 0U;
+        s->state = STALL_RUNNING;
+        Drive_ClearFault(axis, DRIVE_FAULT_STALL);
+        LOG2("stall: axis %u retry %u", axis, s->attempt);
+    }
+
+    return (s->state == STALL_RUNNING) ? control : 0;
+}
+
+void Stall_Clear(uint8_t axis) {
+    Stall_Axis_t *s = &g_stall[axis];
+    if (s->state == STALL_RUNNING)
+        return;
+    s->attempt = 0U;
+    s->suspect_ms = 0U;
+    st.healthy_ms[axis] = 0U;
+    s->state = STALL_RUNNING;
+    Drive_ClearFault(axis, DRIVE_FAULT_STALL);
+    LOG1("stall: axis %u cleared", axis);
+}
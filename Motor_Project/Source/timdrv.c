@@ -0,0 +1,75 @@
+// timdrv.c
+#include "timdrv.h"
+#include <stdint.h>
+
+// This file provides the register-level timer setup used in place of the
+// HAL_TIM init/start calls:
+//  - encoder, PWM time base and PWM channel configuration, written straight
+//    to the registers (same end state as the CubeMX HAL configuration)
+//  - cycle-counter bracketing of the init code, and the tick interrupt
+//    latency record filled by TimDrv_IsrEntry
+// Runtime access (CNT, CCRx, OC mode) goes through the inline accessors in
+// timdrv.h, so the control path never calls into a driver function.
+
+TimDrv_Stats_t g_timdrv = {.isr_min = UINT32_MAX};
+
+/* ----------------- Init ----------------- */
+void TimDrv_EncoderInit(TIM_TypeDef *tim) {
+    tim->CR1 = 0U;
+    tim->PSC = 0U;
+    tim->ARR = TIMDRV_ENCODER_TOP;
+    tim->EGR = TIM_EGR_UG;
+    // Encoder mode 3: count on both edges of TI1 and TI2 (x4).
+    tim->SMCR = (tim->SMCR & ~(TIM_SMCR_SMS | TIM_SMCR_ECE)) | TIM_SMCR_SMS_0 | TIM_SMCR_SMS_1;
+    // CC1/CC2 as inputs mapped on TI1/TI2, no prescaler, no filter.
+    tim->CCMR1 = TIM_CCMR1_CC1S_0 | TIM_CCMR1_CC2S_0;
+    // Rising polarity on both inputs, captures enabled.
+    tim->CCER = TIM_CCER_CC1E | TIM_CCER_CC2E;
+    tim->CR1 = TIM_CR1_CEN;
+}
+
+void TimDrv_PWMInit(TIM_TypeDef *tim, uint32_t top) {
+    tim->CR1 = 0U;
+    tim->PSC = 0U;
+    tim->ARR = top - 1U;
+    if (IS_TIM_REPETITION_COUNTER_INSTANCE(tim))
+        tim->RCR = 0U;
+    tim->EGR = TIM_EGR_UG;
+    // The UG above must not look like a first PWM period to the tick ISR.
+    tim->SR = ~TIM_SR_UIF;
+}
+
+void TimDrv_PWMChannel(TIM_TypeDef *tim, uint32_t channel) {
+    volatile uint32_t *ccmr = (channel < 8U) ? &tim->CCMR1 : &tim->CCMR2;
+    const uint32_t shift = ((channel & 4U) != 0U) ? 8U : 0U;
+    const uint32_t ccer_shift = channel;
+
+    // Channel off while its mode changes.
+    tim->CCER &= ~(TIM_CCER_CC1E << ccer_shift);
+    // Output, PWM mode 1, compare preload, no fast mode.
+    *ccmr = (*ccmr & ~((uint32_t)(TIM_CCMR1_CC1S | TIM_CCMR1_OC1M | TIM_CCMR1_OC1FE) << shift)) |
+            ((uint32_t)(TIM_CCMR1_OC1M_1 | TIM_CCMR1_OC1M_2 | TIM_CCMR1_OC1PE) << shift);
+    *TimDrv_CCR(tim, channel) = 0U;
+    // Active high, complementary output unused.
+    tim->CCER = (tim->CCER & ~((TIM_CCER_CC1P | TIM_CCER_CC1NP | TIM_CCER_CC1NE) << ccer_shift)) |
+                (TIM_CCER_CC1E << ccer_shift);
+}
+
+void TimDrv_Start(TIM_TypeDef *tim) {
+    if (IS_TIM_BREAK_INSTANCE(tim))
+        tim->BDTR |= TIM_BDTR_MOE;
+    tim->CR1 |= TIM_CR1_CEN;
+}
+
+/* ----------------- Measurement ----------------- */
+uint32_t TimDrv_MeasureBegin(void) {
+    // May run before Peripheral_Cycles_Init; enabling twice is harmless and
+    // neither resets the count, so one free-running CYCCNT serves both.
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    return DWT->CYCCNT;
+}
+
+void TimDrv_MeasureEnd(uint32_t start) {
+    g_timdrv.init_cycles += DWT->CYCCNT - start;
+}
@@ -0,0 +1,185 @@
+// timesync.c
+#define LOG_FILE_ID 2
+#include "timesync.h"
+#include <stdint.h>
+#ifndef TIMESYNC_SERVO_ONLY
+#include "canbus.h"
+#include "lockfree.h"
+#include "log.h"
+#include "peripherals.h"
+#endif
+
+// This file keeps the drives on one time base over CAN, two-step style:
+//  - the time master sends SYNC and timestamps it when it leaves the mailbox
+//  - it then sends a TIME follow-up carrying that timestamp
+//  - every other node timestamps the SYNC on reception, pairs it with the
+//    follow-up and runs the servo below
+// The servo output trims the PWM master period (Peripheral_Sync_Trim), which
+// disciplines the carrier and the control tick together.
+// The servo itself is hardware-free (TIMESYNC_SERVO_ONLY builds just that
+// part, for the host simulation).
+
+/* ----------------- Servo ----------------- */
+
+#define TIME_MASK ((1ULL << TIMESYNC_TIME_BITS) - 1U)
+
+static inline int32_t clamp_ppb(int64_t v) {
+    if (v > TIMESYNC_PPB_MAX)
+        return TIMESYNC_PPB_MAX;
+    if (v < -TIMESYNC_PPB_MAX)
+        return -TIMESYNC_PPB_MAX;
+    return (int32_t)v;
+}
+
+void TimeSync_ServoReset(TimeSync_Servo_t *servo) {
+    servo->drift_ppb = 0;
+    servo->last_local_us = 0U;
+    servo->state = TIMESYNC_UNLOCKED;
+    servo->rejected = 0U;
+}
+
+uint8_t TimeSync_ServoSample(TimeSync_Servo_t *servo, uint64_t master_us, uint64_t local_us,
+                             TimeSync_Correction_t *out) {
+    // Signed difference modulo the master time width.
+    const uint64_t diff = (master_us - local_us) & TIME_MASK;
+    const int64_t offset = (int64_t)(diff << (64 - TIMESYNC_TIME_BITS)) >> (64 - TIMESYNC_TIME_BITS);
+
+    out->step_us = 0;
+    out->ppb = servo->drift_ppb;
+    out->phase_us = 0;
+
+    const uint8_t far = (offset > TIMESYNC_STEP_US) || (offset < -TIMESYNC_STEP_US);
+    const uint8_t odd = (offset > TIMESYNC_OUTLIER_US) || (offset < -TIMESYNC_OUTLIER_US);
+    if (odd && servo->state == TIMESYNC_TRACKING && servo->rejected < TIMESYNC_REJECT_MAX) {
+        // Likely a late timestamp (interrupt held off); keep the current trim.
+        servo->rejected++;
+        return 0;
+    }
+    servo->rejected = 0U;
+
+    if (far || servo->state == TIMESYNC_UNLOCKED) {
+        // Step; the drift estimate survives a step after a master change.
+        out->step_us = offset;
+        servo->last_local_us = local_us + (uint64_t)offset;
+        servo->state = TIMESYNC_ACQUIRING;
+        return 1;
+    }
+
+    const int64_t dt = (int64_t)(local_us - servo->last_local_us);
+    servo->last_local_us = local_us;
+    if (dt <= 0)
+        return 0;
+
+    // Offset built up over dt, as a frequency error.
+    const int64_t rate = offset * 1000000000LL / dt;
+    if (servo->state == TIMESYNC_ACQUIRING) {
+        // Phase was zero right after the step, so this is pure drift.
+        servo->drift_ppb = clamp_ppb((int64_t)servo->drift_ppb + rate);
+        servo->state = TIMESYNC_TRACKING;
+    } else {
+        servo->drift_ppb = clamp_ppb((int64_t)servo->drift_ppb + rate / (1 << TIMESYNC_KI_SHIFT));
+    }
+
+    out->ppb = servo->drift_ppb;
+    out->phase_us = (int32_t)offset;
+    return 1;
+}
+
+#ifndef TIMESYNC_SERVO_ONLY
+
+/* ----------------- Node ----------------- */
+
+// SYNC timestamp, written from the CAN interrupts and read by the tick.
+typedef struct {
+    uint64_t local_us;    // Local time of the SYNC (sent or received)
+    uint8_t counter;
+    uint8_t serial;       // Bumped on every SYNC
+} sync_stamp_t;
+
+static struct {
+    TimeSync_Servo_t servo;
+    SeqLock_t lock;
+    sync_stamp_t stamp;   // Guarded by lock
+    uint8_t serial;       // Writer side copy of stamp.serial
+    uint8_t sent_serial;  // Master: last SYNC already followed up
+    uint8_t counter;      // Master: counter of the next SYNC
+    uint8_t ticks;
+} node;
+
+// Servo status for debugging/Watch.
+volatile int32_t g_timesync_offset_us = 0;
+volatile int32_t g_timesync_drift_ppb = 0;
+volatile uint32_t g_timesync_rejected = 0;
+
+static void write_stamp(uint8_t counter, uint64_t local_us) {
+    const sync_stamp_t stamp = {local_us, counter, ++node.serial};
+    SeqLock_Write(&node.lock, &node.stamp, &stamp, sizeof(stamp));
+}
+
+// The writer preempts the tick and always finishes, so two tries suffice.
+static uint8_t read_stamp(sync_stamp_t *stamp) {
+    return SeqLock_Read(&node.lock, stamp, &node.stamp, sizeof(*stamp), 2U);
+}
+
+static void on_time(uint8_t counter, uint64_t master_us) {
+    sync_stamp_t stamp;
+    // A lost SYNC leaves nothing to pair with.
+    if (!read_stamp(&stamp) || stamp.counter != counter)
+        return;
+
+    TimeSync_Correction_t c;
+    if (!TimeSync_ServoSample(&node.servo, master_us, stamp.local_us, &c)) {
+        g_timesync_rejected++;
+        LOG1("timesync: sample rejected (%u in a row)", node.servo.rejected);
+        return;
+    }
+    if (c.step_us != 0) {
+        Peripheral_Sync_Step(c.step_us);
+        LOG2("timesync: step %d us, drift %d ppb", (int32_t)c.step_us, c.ppb);
+    } else
+        Peripheral_Sync_Trim(c.ppb, c.phase_us);
+
+    g_timesync_offset_us = (c.step_us != 0) ? (int32_t)c.step_us : c.phase_us;
+    g_timesync_drift_ppb = c.ppb;
+}
+
+void TimeSync_Init(void) {
+    TimeSync_ServoReset(&node.servo);
+    write_stamp(0U, 0U);
+    node.sent_serial = node.serial;
+    node.counter = 0U;
+    node.ticks = 0U;
+}
+
+void TimeSync_Tick(void) {
+    uint8_t counter;
+    uint64_t time_us;
+    if (CanBus_TakeTime(&counter, &time_us))
+        on_time(counter, time_us);
+
+#if TIMESYNC_MASTER
+    // Follow up the last SYNC as soon as its transmit time is known, so the
+    // correction lands well before the next SYNC is measured.
+    sync_stamp_t stamp;
+    if (read_stamp(&stamp) && stamp.serial != node.sent_serial) {
+        CanBus_SendTime(stamp.counter, stamp.local_us);
+        node.sent_serial = stamp.serial;
+    }
+
+    if (++node.ticks < TIMESYNC_PERIOD_TICKS)
+        return;
+    node.ticks = 0U;
+    CanBus_SendSync(node.counter++);
+#endif
+}
+
+uint8_t TimeSync_OnSyncRx(uint8_t counter, uint64_t local_us) {
+    write_stamp(counter, local_us);
+    return (uint8_t)(node.servo.state != TIMESYNC_UNLOCKED);
+}
+
+void TimeSync_OnSyncTx(uint8_t counter, uint64_t local_us) {
+    write_stamp(counter, local_us);
+}
+
+#endif
@@ -0,0 +1,34 @@
+// trace.c
+#include "trace.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#if TRACE_EVENTRECORDER
+#include "EventRecorder.h"
+#endif
+
+// This file owns the RAM trace ring used by Trace_Event:
+//  - fixed 12-byte records stamped with the DWT cycle counter
+//  - a header (magic, size, clock) so a raw memory dump is self-describing
+//    for the host decoder (Tools/host/trace_decode.c)
+//  - optional forwarding to the Keil Event Recorder, decoded by
+//    EventRecorderStub.scvd
+// The ring itself is also laid out for the Component Viewer (same SCVD).
+
+_Static_assert((TRACE_N & (TRACE_N - 1U)) == 0U, "TRACE_N must be a power of two");
+_Static_assert(sizeof(Trace_Record_t) == 12U, "record layout is shared with the SCVD and host decoder");
+
+Trace_Buffer_t g_trace;
+
+void Trace_Init(void) {
+    g_trace.magic = TRACE_MAGIC;
+    g_trace.count = TRACE_N;
+    g_trace.cpu_hz = SystemCoreClock;
+    atomic_store_explicit(&g_trace.index, 0U, memory_order_relaxed);
+}
+
+#if TRACE_EVENTRECORDER
+void Trace_Forward(uint16_t id, uint16_t axis, uint32_t payload) {
+    // Event id = component number : message number, as listed in the SCVD.
+    EventRecord2(EventID(EventLevelOp, TRACE_EVR_COMPONENT, id), payload, axis);
+}
+#endif
@@ -0,0 +1,171 @@
+// watchdog.c
+#define LOG_FILE_ID 5
+#include "watchdog.h"
+#include "axis.h"
+#include "irq.h"
+#include "log.h"
+#include "main.h"
+#include "peripherals.h"
+#include <stdint.h>
+
+// This file implements the deadline supervisor of watchdog.h:
+//  - reset cause capture and motor shutdown at the very start of main
+//  - WWDG window sized from the tick period and refreshed by the tick,
+//    with a last-moment keep-alive from the fast layer while the tick phase
+//    is being moved on purpose
+//  - IWDG refreshed from the background layer only while no deadline has
+//    been missed
+// Registers are written directly; the HAL watchdog modules stay disabled.
+
+#define IWDG_KEY_RELOAD 0xAAAAU
+#define IWDG_KEY_ACCESS 0x5555U
+#define IWDG_KEY_START 0xCCCCU
+#define IWDG_PR_DIV32 3U				// 32 kHz LSI / 32 = 1 ms per count
+#define WWDG_PRESCALER (4096U * 8U)		// PCLK1 / 4096 / 2^WDGTB, WDGTB = 3
+#define WWDG_T_MIN 0x3FU				// Reset when the counter drops to this
+
+Watchdog_State_t g_watchdog;
+
+static struct {
+    volatile uint8_t armed;		// Deadlines are checked
+    uint8_t started;			// Hardware watchdogs are running
+    uint32_t wwdg_reload;		// WDGA | T
+    uint32_t wwdg_window;		// Refresh is allowed at or below this count
+    uint32_t wwdg_keepalive;	// Grace refresh at or below this count
+    uint32_t deadline_cycles;
+    uint32_t seen_rephases;
+    uint32_t seen_overruns;
+    uint32_t seen_loop;
+    uint32_t stale_ticks;
+} wd;
+
+/* ----------------- Helpers ----------------- */
+
+static inline void wwdg_refresh(void) {
+    WWDG->CR = wd.wwdg_reload;
+}
+
+static inline uint32_t wwdg_count(void) {
+    return WWDG->CR & WWDG_CR_T;
+}
+
+// A tick phase move since the last look starts a grace period.
+static uint8_t note_rephase(void) {
+    const uint32_t rephases = Peripheral_Sync_Rephases();
+    if (rephases == wd.seen_rephases)
+        return 0U;
+    wd.seen_rephases = rephases;
+    g_watchdog.grace = 1U;
+    return 1U;
+}
+
+/* ----------------- Boot ----------------- */
+void Watchdog_Boot(void) {
+    // The enable pins float until MX_GPIO_Init; hold the motors off now.
+    Peripheral_GPIO_DisableMotorAll();
+    g_watchdog.reset_cause = (uint8_t)(RCC->CSR >> 24U);
+    RCC->CSR |= RCC_CSR_RMVF;
+}
+
+void Watchdog_Start(uint32_t tick_ms) {
+    LOG1("reset: cause 0x%02X", g_watchdog.reset_cause);
+
+    wd.deadline_cycles = SystemCoreClock / 1000U * tick_ms / 100U * WATCHDOG_DEADLINE_PCT;
+    wd.seen_overruns = g_irq[IRQ_LAYER_TICK].overruns;
+    wd.seen_rephases = Peripheral_Sync_Rephases();
+    wd.seen_loop = g_watchdog.loop_count;
+    wd.stale_ticks = 0U;
+    // The first tick comes one PWM period after start-up: early by design.
+    g_watchdog.grace = 1U;
+    wd.armed = 1U;
+
+#if WATCHDOG_ENABLE
+    // Window in WWDG counts: reset after `late` counts, refresh allowed
+    // after `early` counts.
+    const uint32_t hz = HAL_RCC_GetPCLK1Freq() / WWDG_PRESCALER;
+    uint32_t late = hz * tick_ms * WATCHDOG_LATE_PCT / 100000U;
+    if (late > 0x7FU - WWDG_T_MIN)
+        late = 0x7FU - WWDG_T_MIN;
+    const uint32_t early = hz * tick_ms * WATCHDOG_EARLY_PCT / 100000U;
+    wd.wwdg_reload = WWDG_CR_WDGA | (WWDG_T_MIN + late);
+    wd.wwdg_window = WWDG_T_MIN + late - early;
+    wd.wwdg_keepalive = WWDG_T_MIN + 1U + WATCHDOG_MARGIN;
+
+    // Both stop while the debugger halts the core.
+    DBGMCU->APB1FZR1 |= DBGMCU_APB1FZR1_DBG_WWDG_STOP | DBGMCU_APB1FZR1_DBG_IWDG_STOP;
+
+    __HAL_RCC_WWDG_CLK_ENABLE();
+    WWDG->CFR = WWDG_CFR_WDGTB | wd.wwdg_window;
+    wwdg_refresh();
+
+    IWDG->KR = IWDG_KEY_START;
+    IWDG->KR = IWDG_KEY_ACCESS;
+    IWDG->PR = IWDG_PR_DIV32;
+    IWDG->RLR = WATCHDOG_IWDG_MS;
+    // Prescaler and reload reach the LSI domain within a few LSI cycles.
+    while (IWDG->SR != 0U) {
+    }
+    IWDG->KR = IWDG_KEY_RELOAD;
+    wd.started = 1U;
+#endif
+}
+
+/* ----------------- Supervision ----------------- */
+void Watchdog_Fast(void) {
+    if (!wd.started)
+        return;
+    note_rephase();
+    if (g_watchdog.grace && !g_watchdog.fault && wwdg_count() <= wd.wwdg_keepalive)
+        wwdg_refresh();
+}
+
+void Watchdog_Tick(void) {
+    if (!wd.armed)
+        return;
+    const Irq_Layer_t *l = &g_irq[IRQ_LAYER_TICK];
+    const uint32_t took = DWT->CYCCNT - l->pended_at;
+    if (took > g_watchdog.worst_cycles)
+        g_watchdog.worst_cycles = took;
+    if (took > wd.deadline_cycles)
+        Watchdog_Trip(WATCHDOG_FAULT_DEADLINE);
+    if (l->overruns != wd.seen_overruns)
+        Watchdog_Trip(WATCHDOG_FAULT_OVERRUN);
+    if (!wd.started || g_watchdog.fault)
+        return;
+
+    // The fast layer also refreshes during grace; keep it out in between.
+    const uint32_t basepri = Irq_Lock();
+    const uint8_t moved = note_rephase();
+    if (!g_watchdog.grace) {
+        // Outside grace an early tick refreshes a closed window and the WWDG
+        // resets: that is the early-tick check.
+        wwdg_refresh();
+    } else if (wwdg_count() <= wd.wwdg_window) {
+        // Back inside the window; leave grace unless the phase just moved.
+        wwdg_refresh();
+        if (!moved)
+            g_watchdog.grace = 0U;
+    }
+    Irq_Unlock(basepri);
+}
+
+void Watchdog_Background(void) {
+    if (!wd.armed)
+        return;
+    const uint32_t loop = g_watchdog.loop_count;
+    if (loop != wd.seen_loop) {
+        wd.seen_loop = loop;
+        wd.stale_ticks = 0U;
+    } else if (++wd.stale_ticks > WATCHDOG_LOOP_TICKS) {
+        Watchdog_Trip(WATCHDOG_FAULT_LOOP);
+    }
+    if (wd.started && !g_watchdog.fault)
+        IWDG->KR = IWDG_KEY_RELOAD;
+}
+
+void Watchdog_Trip(uint8_t fault) {
+    g_watchdog.fault |= fault;
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        Peripheral_GPIO_DisableMotorAxis(axis);
+    }
+}
@@ -0,0 +1,228 @@
+// canbus_loopback.c
+//
+// Host stand-in for the CAN transport, so the protocol layer in canbus.c can
+// be exercised on Linux without hardware. It behaves like a vcan interface in
+// loopback: every transmitted frame is printed candump-style and offered back
+// to the node through the same identifier filter the bxCAN banks would apply.
+//
+// The main() below plays the bus master: it sends RxPDOs and SYNCs, and
+// runs the node's control tick between them. It checks that
+//   - a staged RxPDO takes effect only on the next SYNC
+//   - the TxPDOs published after a SYNC carry the tick's values
+//   - the filter drops identifiers the node does not consume
+//   - the reference falls back to 0 once the RxPDOs stop
+// and exits with status 1 if any check fails.
+//
+// Build and run (from Motor_Project):
+//   gcc -std=c11 -Wall -IHeaders -o canbus_loopback Tools/host/canbus_loopback.c Source/canbus.c Source/lockfree.c
+//   ./canbus_loopback
+#include "canbus.h"
+#include "axis.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/* ----------------- Transport stand-in ----------------- */
+
+#define MAX_IDS 16U
+
+static uint16_t accepted[MAX_IDS];
+static uint8_t accepted_n = 0;
+static uint32_t bus_time_ms = 0;
+static uint32_t filtered = 0;				// Frames the filter dropped
+static CanBus_Frame_t last_txpdo[AXIS_COUNT];	// Last TxPDO sent per axis
+static uint8_t txpdo_seen[AXIS_COUNT];
+
+static void dump(const char *dir, const CanBus_Frame_t *frame) {
+    printf("%8u ms  %s  %03X  [%u] ", (unsigned)bus_time_ms, dir, (unsigned)frame->id, (unsigned)frame->dlc);
+    for (uint8_t i = 0; i < frame->dlc; i++)
+        printf(" %02X", frame->data[i]);
+    printf("\n");
+}
+
+// What the hardware filter banks would do.
+static int filter_pass(uint32_t id) {
+    for (uint8_t i = 0; i < accepted_n; i++) {
+        if (accepted[i] == id)
+            return 1;
+    }
+    return 0;
+}
+
+// Put a frame on the bus as seen by this node.
+static void bus_deliver(const CanBus_Frame_t *frame) {
+    dump("rx", frame);
+    if (!filter_pass(frame->id)) {
+        filtered++;
+        return;
+    }
+    if (CanBus_OnFrame(frame) == CANBUS_EVENT_SYNC)
+        printf("            -> tick aligned to SYNC\n");
+}
+
+uint8_t CanBus_Port_Init(const uint16_t *ids, uint8_t count) {
+    accepted_n = (count > MAX_IDS) ? MAX_IDS : count;
+    for (uint8_t i = 0; i < accepted_n; i++)
+        accepted[i] = ids[i];
+    return 1;
+}
+
+void CanBus_Port_RequestTx(void) {
+    // Drain like the TX interrupt would, and loop every frame back.
+    CanBus_Frame_t frame;
+    while (CanBus_NextTx(&frame)) {
+        dump("tx", &frame);
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+            if (frame.id == CANBUS_ID_TXPDO(axis)) {
+                last_txpdo[axis] = frame;
+                txpdo_seen[axis] = 1;
+            }
+        }
+        bus_deliver(&frame);
+    }
+}
+
+void CanBus_Port_TxIRQHandler(void) {
+    CanBus_Port_RequestTx();
+}
+
+void CanBus_Port_Rx0IRQHandler(void) {
+}
+
+/* ----------------- Checks ----------------- */
+
+static int failures = 0;
+
+static void check(int ok, const char *what) {
+    printf("            %s  %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok)
+        failures++;
+}
+
+static int16_t frame_i16(const CanBus_Frame_t *frame, uint8_t at) {
+    return (int16_t)(uint16_t)((uint16_t)frame->data[at] | (uint16_t)((uint16_t)frame->data[at + 1U] << 8));
+}
+
+// Reference the node uses for axis 0, or INT32_MIN under local control.
+static int32_t remote_reference(void) {
+    int32_t ref = 0;
+    return CanBus_GetReference(0, &ref) ? ref : INT32_MIN;
+}
+
+/* ----------------- Scenario ----------------- */
+
+static void send_rxpdo(uint32_t id, int16_t rpm) {
+    CanBus_Frame_t frame = {id, (uint8_t)(2U * AXIS_COUNT), {0}};
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        frame.data[2U * axis] = (uint8_t)((uint16_t)rpm & 0xFFU);
+        frame.data[2U * axis + 1U] = (uint8_t)((uint16_t)rpm >> 8);
+    }
+    bus_deliver(&frame);
+}
+
+static void send_sync(uint8_t counter) {
+    CanBus_Frame_t frame = {CANBUS_ID_SYNC, 1U, {counter}};
+    bus_deliver(&frame);
+}
+
+// What the node published on its last tick.
+static struct {
+    int32_t velocity, control;
+    uint8_t published;
+} node;
+
+// One node control tick, as Application_Tick does it.
+static void node_tick(int32_t *velocity) {
+    const uint8_t synced = CanBus_Poll(bus_time_ms);
+    int32_t ref = 0;
+    const uint8_t remote = CanBus_GetReference(0, &ref);
+    // Crude first-order plant so the TxPDO shows something moving.
+    if (remote)
+        *velocity += (ref - *velocity) / 4;
+    node.published = synced;
+    if (synced) {
+        node.velocity = *velocity;
+        node.control = (ref - *velocity) * 65536;
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+            txpdo_seen[axis] = 0;
+            CanBus_PublishStatus(axis, node.velocity, node.control, 0U);
+        }
+    }
+}
+
+// The TxPDOs of this tick: one per axis, with its values and status.
+static void check_txpdo(uint8_t counter, uint8_t status) {
+    int ok = node.published;
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+        const CanBus_Frame_t *f = &last_txpdo[axis];
+        ok = ok && txpdo_seen[axis] && f->dlc == 7U && frame_i16(f, 0) == node.velocity
+             && frame_i16(f, 2) == node.control >> 15 && f->data[4] == status && f->data[5] == counter;
+    }
+    check(ok, "TxPDO after SYNC: velocity, control, status and counter echo");
+}
+
+int main(void) {
+    int32_t velocity = 0;
+
+    if (!CanBus_Init()) {
+        printf("transport init failed\n");
+        return 1;
+    }
+    check(accepted_n == 3U && filter_pass(CANBUS_ID_SYNC) && filter_pass(CANBUS_ID_TIME)
+              && filter_pass(CANBUS_ID_RXPDO),
+          "filter accepts exactly SYNC, TIME and our RxPDO");
+
+    // Commander: RxPDO ahead of each SYNC until 300 ms, then silent; the
+    // master keeps sending SYNC every 50 ms. The RxPDO of another node goes
+    // out at 120 ms.
+    uint8_t counter = 1;
+    for (bus_time_ms = 10; bus_time_ms <= 450; bus_time_ms += 10) {
+        const int32_t before = remote_reference();
+        if (bus_time_ms % 50U == 40U && bus_time_ms < 300)
+            send_rxpdo(CANBUS_ID_RXPDO, bus_time_ms < 200 ? 1500 : -800);
+        if (bus_time_ms == 120U) {
+            const uint32_t dropped = filtered;
+            send_rxpdo(CANBUS_ID_RXPDO + 1U, 3000);
+            check(filtered == dropped + 1U, "RxPDO of another node dropped by the filter");
+        }
+        const uint8_t sync = (bus_time_ms % 50U == 0U);
+        if (sync)
+            send_sync(counter);
+        node_tick(&velocity);
+
+        const int32_t ref = remote_reference();
+        switch (bus_time_ms) {
+        case 40:
+            check(ref == INT32_MIN, "first RxPDO staged, not applied before SYNC");
+            break;
+        case 50:
+            check(ref == 1500, "staged reference applied on SYNC");
+            check_txpdo(counter, CANBUS_STATUS_REMOTE);
+            break;
+        case 240:
+            check(ref == before && ref == 1500, "new RxPDO staged, old reference held until SYNC");
+            break;
+        case 250:
+            check(ref == -800, "new reference applied on SYNC");
+            check_txpdo(counter, CANBUS_STATUS_REMOTE);
+            break;
+        case 390:
+            check(ref == -800, "reference held up to the RxPDO timeout");
+            break;
+        case 400:
+            check(ref == 0, "reference dropped to 0 after the RxPDO timeout");
+            check_txpdo(counter, CANBUS_STATUS_REMOTE | CANBUS_STATUS_TIMEOUT);
+            break;
+        default:
+            if (!sync && node.published)
+                check(0, "TxPDO only on SYNC ticks");
+            break;
+        }
+        if (sync)
+            counter++;
+    }
+    // Our own TxPDOs came back through the loopback and were dropped too.
+    check(filtered > 1U, "own TxPDOs dropped by the filter");
+
+    printf("%s\n", failures ? "FAILED" : "all checks passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,614 @@
+// capture.c
+//
+// Columnar capture files for long soak-test telemetry, and the tools around
+// them:
+//   convert  raw process images -> .cap
+//   info     header and chunk statistics
+//   cat      rows of a time range as CSV, found through the chunk index
+//   demo     synthesise a raw stream, convert it, verify and time it
+//
+// Raw input is a byte stream of ProcessImage_t records (Headers/application.h)
+// back to back, as read with Application_ReadImage and streamed out over a
+// serial link or by a debugger script. Bytes may be missing or garbled; the
+// converter resynchronises on plausible seq/millisec steps.
+//
+// File layout (little-endian, all offsets from the start of the file):
+//   header   cap_header_t, rewritten with the totals when the file is closed
+//   chunks   up to CHUNK_ROWS rows each: cap_chunk_t, one byte count per
+//            column, then the columns one after another
+//   index    one cap_index_t per chunk, sorted by tick time
+// Columns are seq, tick time, bus time, flags, then reference, velocity,
+// control and winding heat per axis. Tick time is millisec unwrapped to 64
+// bits, so it only ever grows and serves as the seek key. Each column stores
+// deltas (counters and time stamps: deltas of deltas) as zigzag varints, with
+// runs of zeros collapsed into one varint, so a steady signal costs a few
+// bits per row.
+// Columns decode independently, so a reader only touches what it prints.
+//
+// Build and run (from Motor_Project, AXIS_COUNT as in the firmware):
+//   gcc -std=gnu11 -O2 -Wall -DAXIS_COUNT=1 -IHeaders -o capture Tools/host/capture.c
+//   ./capture convert images.raw soak.cap
+//   ./capture info soak.cap
+//   ./capture cat soak.cap 3600000 3601000     # tick time range in ms
+//   ./capture demo [rows]
+#include "application.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ----------------- Format ----------------- */
+
+#define CAP_MAGIC "MFCAP001"
+#define CAP_VERSION 2U
+#define CHUNK_ROWS 8192U
+
+enum { COL_SEQ = 0, COL_MS, COL_TIME, COL_FLAGS, COL_AXIS };   // COL_AXIS + 4 * axis + {ref, vel, ctrl, heat}
+#define AXIS_COLS 4U
+#define COLUMNS(axes) (COL_AXIS + AXIS_COLS * (axes))
+#define MAX_COLS COLUMNS(AXIS_MAX)
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t axis_count;
+    uint32_t columns;
+    uint32_t chunk_rows;
+    uint64_t rows;
+    uint64_t chunks;
+    uint64_t index_offset;		// 0 while the file is being written
+    uint64_t ms_first;			// Tick time range of the whole file
+    uint64_t ms_last;
+} cap_header_t;
+
+typedef struct {
+    uint32_t rows;
+    uint32_t columns;			// followed by uint32_t bytes[columns]
+} cap_chunk_t;
+
+typedef struct {
+    uint64_t ms_first;			// Tick time of the first and last row
+    uint64_t ms_last;
+    uint64_t offset;			// File offset of the cap_chunk_t
+    uint64_t row;				// Number of the first row in the file
+    uint32_t rows;
+    uint32_t bytes;				// Chunk size including its header
+} cap_index_t;
+
+_Static_assert(sizeof(cap_header_t) == 64, "header layout");
+_Static_assert(sizeof(cap_index_t) == 40, "index layout");
+
+// Counters and time stamps advance steadily: store deltas of deltas.
+static int column_order(uint32_t col) {
+    return (col == COL_SEQ || col == COL_MS || col == COL_TIME) ? 2 : 1;
+}
+
+static const char *column_name(uint32_t col, char *buf, size_t size) {
+    static const char *const fixed[] = {"seq", "ms", "time_us", "flags"};
+    static const char *const per_axis[] = {"ref", "vel", "ctrl", "heat"};
+    if (col < COL_AXIS)
+        return fixed[col];
+    snprintf(buf, size, "%s%u", per_axis[(col - COL_AXIS) % AXIS_COLS], (col - COL_AXIS) / AXIS_COLS);
+    return buf;
+}
+
+/* ----------------- Codec ----------------- */
+
+static inline uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1U);
+}
+
+static inline uint8_t *put_varint(uint8_t *p, uint64_t v) {
+    while (v >= 0x80U) {
+        *p++ = (uint8_t)(v | 0x80U);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static inline const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint64_t *v) {
+    uint64_t x = 0;
+    for (unsigned shift = 0; shift < 70U && p < end; shift += 7U) {
+        const uint8_t b = *p++;
+        x |= (uint64_t)(b & 0x7FU) << shift;
+        if ((b & 0x80U) == 0U) {
+            *v = x;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// Token = zigzag(value) << 1, or (run - 1) << 1 | 1 for a run of zeros.
+static size_t encode_column(const int64_t *v, uint32_t rows, int order, uint8_t *out) {
+    uint8_t *p = out;
+    int64_t prev = 0, prev_d = 0;
+    uint64_t run = 0;
+    for (uint32_t i = 0; i < rows; i++) {
+        const int64_t d = v[i] - prev;
+        const int64_t x = (order == 2) ? d - prev_d : d;
+        prev = v[i];
+        prev_d = (i == 0) ? 0 : d;
+        if (x == 0) {
+            run++;
+            continue;
+        }
+        if (run) {
+            p = put_varint(p, ((run - 1U) << 1) | 1U);
+            run = 0;
+        }
+        p = put_varint(p, zigzag(x) << 1);
+    }
+    if (run)
+        p = put_varint(p, ((run - 1U) << 1) | 1U);
+    return (size_t)(p - out);
+}
+
+static int decode_column(const uint8_t *p, const uint8_t *end, uint32_t rows, int order, int64_t *v) {
+    int64_t prev = 0, prev_d = 0;
+    uint32_t i = 0;
+    while (i < rows) {
+        uint64_t token;
+        if ((p = get_varint(p, end, &token)) == NULL)
+            return 0;
+        uint64_t n = 1;
+        int64_t x = 0;
+        if (token & 1U)
+            n = (token >> 1) + 1U;
+        else
+            x = unzigzag(token >> 1);
+        for (; n > 0 && i < rows; n--, i++, x = 0) {
+            const int64_t d = (order == 2) ? prev_d + x : x;
+            prev += d;
+            prev_d = (i == 0) ? 0 : d;
+            v[i] = prev;
+        }
+    }
+    return 1;
+}
+
+/* ----------------- Writer ----------------- */
+
+typedef struct {
+    FILE *f;
+    cap_header_t hdr;
+    uint64_t offset;
+    int64_t col[MAX_COLS][CHUNK_ROWS];
+    uint32_t rows;
+    cap_index_t *index;
+    uint64_t index_cap;
+    uint8_t buf[MAX_COLS * CHUNK_ROWS * 10U + 256U];
+} writer_t;
+
+static int writer_open(writer_t *w, const char *path, uint32_t axes) {
+    memset(&w->hdr, 0, sizeof(w->hdr));
+    if ((w->f = fopen(path, "wb")) == NULL) {
+        perror(path);
+        return 0;
+    }
+    setvbuf(w->f, NULL, _IOFBF, 1U << 20);
+    memcpy(w->hdr.magic, CAP_MAGIC, 8);
+    w->hdr.version = CAP_VERSION;
+    w->hdr.axis_count = axes;
+    w->hdr.columns = COLUMNS(axes);
+    w->hdr.chunk_rows = CHUNK_ROWS;
+    w->offset = sizeof(w->hdr);
+    w->rows = 0;
+    w->index = NULL;
+    w->index_cap = 0;
+    return fwrite(&w->hdr, sizeof(w->hdr), 1, w->f) == 1;
+}
+
+static int writer_flush(writer_t *w) {
+    if (w->rows == 0)
+        return 1;
+    const uint32_t cols = w->hdr.columns;
+    cap_chunk_t *ch = (cap_chunk_t *)w->buf;
+    uint32_t *bytes = (uint32_t *)(ch + 1);
+    uint8_t *p = (uint8_t *)(bytes + cols);
+    ch->rows = w->rows;
+    ch->columns = cols;
+    for (uint32_t c = 0; c < cols; c++) {
+        const size_t n = encode_column(w->col[c], w->rows, column_order(c), p);
+        bytes[c] = (uint32_t)n;
+        p += n;
+    }
+    const uint32_t size = (uint32_t)(p - w->buf);
+    if (fwrite(w->buf, size, 1, w->f) != 1)
+        return 0;
+
+    if (w->hdr.chunks == w->index_cap) {
+        w->index_cap = w->index_cap ? 2U * w->index_cap : 1024U;
+        w->index = realloc(w->index, w->index_cap * sizeof(cap_index_t));
+        if (w->index == NULL)
+            return 0;
+    }
+    w->index[w->hdr.chunks++] = (cap_index_t){(uint64_t)w->col[COL_MS][0],
+                                              (uint64_t)w->col[COL_MS][w->rows - 1U], w->offset,
+                                              w->hdr.rows, w->rows, size};
+    w->offset += size;
+    w->hdr.rows += w->rows;
+    w->rows = 0;
+    return 1;
+}
+
+static int writer_row(writer_t *w, const ProcessImage_t *img, uint64_t ms) {
+    const uint32_t r = w->rows;
+    w->col[COL_SEQ][r] = img->seq;
+    w->col[COL_MS][r] = (int64_t)ms;
+    w->col[COL_TIME][r] = (int64_t)img->time_us;
+    w->col[COL_FLAGS][r] = img->flags;
+    for (uint32_t a = 0; a < AXIS_COUNT; a++) {
+        w->col[COL_AXIS + AXIS_COLS * a][r] = img->reference[a];
+        w->col[COL_AXIS + AXIS_COLS * a + 1U][r] = img->velocity[a];
+        w->col[COL_AXIS + AXIS_COLS * a + 2U][r] = img->control[a];
+        w->col[COL_AXIS + AXIS_COLS * a + 3U][r] = img->thermal[a];
+    }
+    if (w->hdr.rows == 0 && r == 0)
+        w->hdr.ms_first = ms;
+    w->hdr.ms_last = ms;
+    return (++w->rows < CHUNK_ROWS) ? 1 : writer_flush(w);
+}
+
+static int writer_close(writer_t *w) {
+    int ok = writer_flush(w);
+    w->hdr.index_offset = w->offset;
+    ok = ok && fwrite(w->index, sizeof(cap_index_t), w->hdr.chunks, w->f) == w->hdr.chunks;
+    ok = ok && fseek(w->f, 0, SEEK_SET) == 0 && fwrite(&w->hdr, sizeof(w->hdr), 1, w->f) == 1;
+    ok = (fclose(w->f) == 0) && ok;
+    free(w->index);
+    return ok;
+}
+
+/* ----------------- Reader ----------------- */
+
+typedef struct {
+    const uint8_t *map;
+    size_t size;
+    const cap_header_t *hdr;
+    const cap_index_t *index;
+} cap_t;
+
+static const void *map_file(const char *path, size_t *size) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "%s: cannot map\n", path);
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+    return map;
+}
+
+static int cap_open(cap_t *cap, const char *path) {
+    if ((cap->map = map_file(path, &cap->size)) == NULL)
+        return 0;
+    cap->hdr = (const cap_header_t *)cap->map;
+    const cap_header_t *h = cap->hdr;
+    if (cap->size < sizeof(*h) || memcmp(h->magic, CAP_MAGIC, 8) != 0 || h->version != CAP_VERSION ||
+        h->axis_count < 1U || h->axis_count > AXIS_MAX || h->columns != COLUMNS(h->axis_count) ||
+        h->index_offset == 0 || h->index_offset + h->chunks * sizeof(cap_index_t) > cap->size) {
+        fprintf(stderr, "%s: not a complete capture file\n", path);
+        munmap((void *)cap->map, cap->size);
+        return 0;
+    }
+    cap->index = (const cap_index_t *)(cap->map + h->index_offset);
+    return 1;
+}
+
+static void cap_close(cap_t *cap) {
+    munmap((void *)cap->map, cap->size);
+}
+
+// First chunk that can hold tick time ms (binary search on the index).
+static uint64_t cap_find(const cap_t *cap, uint64_t ms) {
+    uint64_t lo = 0, hi = cap->hdr->chunks;
+    while (lo < hi) {
+        const uint64_t mid = lo + (hi - lo) / 2U;
+        if (cap->index[mid].ms_last < ms)
+            lo = mid + 1U;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Decode one column of one chunk; returns the row count, 0 on a damaged chunk.
+static uint32_t cap_column(const cap_t *cap, uint64_t chunk, uint32_t col, int64_t *out) {
+    const cap_index_t *e = &cap->index[chunk];
+    if (e->offset + e->bytes > cap->size)
+        return 0;
+    const uint8_t *base = cap->map + e->offset;
+    const cap_chunk_t *ch = (const cap_chunk_t *)base;
+    const uint32_t *bytes = (const uint32_t *)(ch + 1);
+    const uint8_t *p = (const uint8_t *)(bytes + ch->columns);
+    if (ch->columns != cap->hdr->columns || col >= ch->columns || ch->rows > CHUNK_ROWS)
+        return 0;
+    for (uint32_t c = 0; c < col; c++)
+        p += bytes[c];
+    if (p + bytes[col] > base + e->bytes)
+        return 0;
+    return decode_column(p, p + bytes[col], ch->rows, column_order(col), out) ? ch->rows : 0;
+}
+
+/* ----------------- Commands ----------------- */
+
+static double now_s(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+// Most images missed in a row that still continue the last record. A record
+// read whole bytes early has seq (and millisec, in step) scaled by 256 or
+// more, whatever the bytes in front of it hold, so it is never that close;
+// longer gaps resynchronise afresh.
+#define MAX_GAP 255U
+
+// Plausible successor of prev, at most max_gap images on (missed images are
+// fine, garbage is not). Every image is one tick, so millisec moves exactly
+// PERIOD_CTRL per seq step. Beyond that only each field's own range is
+// checked, so nothing depends on the order of the fields.
+static int plausible(const ProcessImage_t *prev, const ProcessImage_t *img, uint32_t max_gap) {
+    const uint32_t dseq = img->seq - prev->seq;
+    const uint32_t dms = img->millisec - prev->millisec;
+    return dseq >= 1U && dseq <= max_gap && dms == dseq * PERIOD_CTRL
+           && (img->flags & ~(IMAGE_FLAG_REMOTE | IMAGE_FLAG_SYNC)) == 0U;
+}
+
+static int cmd_convert(const char *in, const char *out) {
+    size_t size;
+    const uint8_t *raw = map_file(in, &size);
+    if (raw == NULL)
+        return 1;
+    static writer_t w;
+    if (!writer_open(&w, out, AXIS_COUNT))
+        return 1;
+
+    const double t0 = now_s();
+    const size_t rec = sizeof(ProcessImage_t);
+    ProcessImage_t prev = {0}, img, next;
+    int have_prev = 0;
+    uint64_t ms = 0, skipped = 0;
+    size_t off = 0;
+    while (off + rec <= size) {
+        memcpy(&img, raw + off, rec);
+        // Accept a record that follows the last one, or (after a gap) one
+        // that the record behind it follows directly.
+        int ok;
+        if (have_prev) {
+            ok = plausible(&prev, &img, MAX_GAP);
+        } else {
+            ok = off + 2U * rec <= size;
+            if (ok) {
+                memcpy(&next, raw + off + rec, rec);
+                ok = plausible(&img, &next, 1U);
+            }
+        }
+        if (!ok) {
+            if (have_prev) {
+                // Try the bytes after the last good record afresh.
+                have_prev = 0;
+                continue;
+            }
+            off++;
+            skipped++;
+            continue;
+        }
+        // Unwrapped tick time; across a resync trust millisec only if it fits.
+        if (w.hdr.rows + w.rows == 0U)
+            ms = img.millisec;
+        else if (have_prev || plausible(&prev, &img, UINT32_MAX / PERIOD_CTRL))
+            ms += (uint32_t)(img.millisec - prev.millisec);
+        else
+            ms += PERIOD_CTRL;
+        if (!writer_row(&w, &img, ms))
+            return 1;
+        prev = img;
+        have_prev = 1;
+        off += rec;
+    }
+    skipped += size - off;
+    if (!writer_close(&w))
+        return 1;
+    const double dt = now_s() - t0;
+
+    struct stat st;
+    stat(out, &st);
+    printf("%llu rows, %llu chunks, %llu bytes skipped while resynchronising\n",
+           (unsigned long long)w.hdr.rows, (unsigned long long)w.hdr.chunks, (unsigned long long)skipped);
+    printf("%.1f MB raw -> %.1f MB (%.1fx, %.2f bytes/row) in %.2f s, %.0f MB/s\n", size * 1e-6,
+           (double)st.st_size * 1e-6, (double)size / (double)st.st_size,
+           (double)st.st_size / (double)(w.hdr.rows ? w.hdr.rows : 1U), dt, size * 1e-6 / dt);
+    munmap((void *)raw, size);
+    return 0;
+}
+
+static int cmd_info(const char *path) {
+    cap_t cap;
+    if (!cap_open(&cap, path))
+        return 1;
+    const cap_header_t *h = cap.hdr;
+    printf("%u axes, %llu rows in %llu chunks of up to %u rows\n", h->axis_count,
+           (unsigned long long)h->rows, (unsigned long long)h->chunks, h->chunk_rows);
+    printf("tick time %llu .. %llu ms\n", (unsigned long long)h->ms_first, (unsigned long long)h->ms_last);
+
+    // Bytes per column across all chunks.
+    uint64_t col_bytes[MAX_COLS] = {0};
+    for (uint64_t c = 0; c < h->chunks; c++) {
+        const cap_chunk_t *ch = (const cap_chunk_t *)(cap.map + cap.index[c].offset);
+        const uint32_t *bytes = (const uint32_t *)(ch + 1);
+        for (uint32_t k = 0; k < h->columns; k++)
+            col_bytes[k] += bytes[k];
+    }
+    for (uint32_t k = 0; k < h->columns; k++) {
+        char name[16];
+        printf("  %-8s %12llu bytes  %6.3f bytes/row\n", column_name(k, name, sizeof(name)),
+               (unsigned long long)col_bytes[k], (double)col_bytes[k] / (double)(h->rows ? h->rows : 1U));
+    }
+    cap_close(&cap);
+    return 0;
+}
+
+static int cmd_cat(const char *path, uint64_t from, uint64_t to) {
+    cap_t cap;
+    if (!cap_open(&cap, path))
+        return 1;
+    const uint32_t cols = cap.hdr->columns;
+    static int64_t v[MAX_COLS][CHUNK_ROWS];
+    char name[16];
+    for (uint32_t k = 0; k < cols; k++)
+        printf("%s%s", k ? "," : "", column_name(k, name, sizeof(name)));
+    printf("\n");
+    for (uint64_t c = cap_find(&cap, from); c < cap.hdr->chunks && cap.index[c].ms_first <= to; c++) {
+        uint32_t rows = 0;
+        for (uint32_t k = 0; k < cols; k++)
+            rows = cap_column(&cap, c, k, v[k]);
+        if (rows == 0) {
+            fprintf(stderr, "chunk %llu damaged\n", (unsigned long long)c);
+            break;
+        }
+        for (uint32_t r = 0; r < rows; r++) {
+            if ((uint64_t)v[COL_MS][r] < from || (uint64_t)v[COL_MS][r] > to)
+                continue;
+            for (uint32_t k = 0; k < cols; k++)
+                printf("%s%lld", k ? "," : "", (long long)v[k][r]);
+            printf("\n");
+        }
+    }
+    cap_close(&cap);
+    return 0;
+}
+
+/* ----------------- Demo ----------------- */
+
+// Images shaped like a soak test: reference flips, a lagging velocity with
+// encoder noise, a PI-like control, bus time with a little trim, and the odd
+// missed image or garbled byte run on the link.
+static ProcessImage_t demo_image(uint32_t k) {
+    static double rpm[AXIS_COUNT];
+    if (k == 0U)
+        memset(rpm, 0, sizeof(rpm));
+    ProcessImage_t img;
+    memset(&img, 0, sizeof(img));
+    img.seq = k + 1U;
+    img.millisec = (k + 1U) * PERIOD_CTRL;
+    img.time_us = 1234567ULL + (uint64_t)img.millisec * 1000U + (k % 7U == 0U ? 1U : 0U);
+    img.flags = (uint8_t)((k % 10U == 0U) ? IMAGE_FLAG_SYNC : 0U);
+    for (uint32_t a = 0; a < AXIS_COUNT; a++) {
+        const int32_t ref = ((img.millisec / PERIOD_REF) % 2U) ? -2000 : 2000;
+        rpm[a] += (ref - rpm[a]) * 0.15;
+        img.reference[a] = ref;
+        img.velocity[a] = (int32_t)rpm[a] + (int32_t)((k * 2654435761U >> 28) & 7U) * 3 - 10;
+        img.control[a] = ref * 99000 + (ref - img.velocity[a]) * 5461;
+        img.thermal[a] = (uint16_t)(200U + (img.millisec / 1000U) % 600U);
+    }
+    return img;
+}
+
+static int cmd_demo(uint32_t rows) {
+    const char *raw_path = "capture_demo.raw", *cap_path = "capture_demo.cap";
+    FILE *f = fopen(raw_path, "wb");
+    if (!f) {
+        perror(raw_path);
+        return 1;
+    }
+    setvbuf(f, NULL, _IOFBF, 1U << 20);
+    uint32_t written = 0;
+    for (uint32_t k = 0; k < rows; k++) {
+        if (k % 100000U == 99999U)
+            continue;   // missed image
+        if (k % 250000U == 12345U)
+            fwrite("\x55\xAA\x01", 3, 1, f);   // line noise
+        const ProcessImage_t img = demo_image(k);
+        fwrite(&img, sizeof(img), 1, f);
+        written++;
+    }
+    fclose(f);
+    printf("demo: %u images (%zu bytes each) in %s; as CSV this would be about %.0f MB\n", written,
+           sizeof(ProcessImage_t), raw_path, written * (30.0 + 22.0 * AXIS_COUNT) * 1e-6);
+
+    if (cmd_convert(raw_path, cap_path) != 0)
+        return 1;
+
+    // Round trip: every row must come back exactly.
+    cap_t cap;
+    if (!cap_open(&cap, cap_path))
+        return 1;
+    static int64_t v[MAX_COLS][CHUNK_ROWS];
+    uint64_t row = 0, bad = 0;
+    uint32_t k = 0;
+    const double t0 = now_s();
+    for (uint64_t c = 0; c < cap.hdr->chunks; c++) {
+        uint32_t n = 0;
+        for (uint32_t col = 0; col < cap.hdr->columns; col++)
+            n = cap_column(&cap, c, col, v[col]);
+        for (uint32_t r = 0; r < n; r++, row++, k++) {
+            if (k % 100000U == 99999U)
+                k++;
+            const ProcessImage_t img = demo_image(k);
+            bad += (v[COL_SEQ][r] != img.seq) || ((uint64_t)v[COL_TIME][r] != img.time_us) ||
+                   (v[COL_FLAGS][r] != img.flags);
+            for (uint32_t a = 0; a < AXIS_COUNT; a++)
+                bad += (v[COL_AXIS + AXIS_COLS * a][r] != img.reference[a]) ||
+                       (v[COL_AXIS + AXIS_COLS * a + 1U][r] != img.velocity[a]) ||
+                       (v[COL_AXIS + AXIS_COLS * a + 2U][r] != img.control[a]) ||
+                       (v[COL_AXIS + AXIS_COLS * a + 3U][r] != img.thermal[a]);
+        }
+    }
+    const double t_scan = now_s() - t0;
+    printf("round trip: %llu rows, %llu differ; full decode %.0f M rows/s\n", (unsigned long long)row,
+           (unsigned long long)bad, (double)row / t_scan * 1e-6);
+
+    // Random seeks: index lookup plus one column of one chunk.
+    const uint32_t seeks = 100000U;
+    const double t1 = now_s();
+    uint64_t found = 0;
+    for (uint32_t i = 0; i < seeks; i++) {
+        const uint64_t ms = cap.hdr->ms_first + (uint64_t)(i * 2654435761U) % (cap.hdr->ms_last - cap.hdr->ms_first + 1U);
+        const uint64_t c = cap_find(&cap, ms);
+        found += (c < cap.hdr->chunks && cap_column(&cap, c, COL_MS, v[COL_MS]) != 0U);
+    }
+    printf("%u random seeks + chunk decode: %.1f us each (%llu hits)\n", seeks,
+           (now_s() - t1) / seeks * 1e6, (unsigned long long)found);
+    cap_close(&cap);
+    return (bad == 0U && row == written) ? 0 : 1;
+}
+
+/* ----------------- Main ----------------- */
+
+int main(int argc, char **argv) {
+    if (argc >= 4 && strcmp(argv[1], "convert") == 0)
+        return cmd_convert(argv[2], argv[3]);
+    if (argc == 3 && strcmp(argv[1], "info") == 0)
+        return cmd_info(argv[2]);
+    if (argc >= 3 && strcmp(argv[1], "cat") == 0)
+        return cmd_cat(argv[2], (argc > 3) ? strtoull(argv[3], NULL, 10) : 0U,
+                       (argc > 4) ? strtoull(argv[4], NULL, 10) : UINT64_MAX);
+    if (argc >= 2 && strcmp(argv[1], "demo") == 0)
+        return cmd_demo((argc > 2) ? (uint32_t)atoi(argv[2]) : 2000000U);
+
+    fprintf(stderr, "usage: capture convert <images.raw> <out.cap>\n"
+                    "       capture info <file.cap>\n"
+                    "       capture cat <file.cap> [from_ms [to_ms]]\n"
+                    "       capture demo [rows]\n");
+    return 2;
+}
@@ -0,0 +1,164 @@
+// lockfree_stress.c
+//
+// Host stress run for lockfree.c. Real threads on a multi-core host are a
+// harsher setting than ISR/thread mode on one Cortex-M core: any missing
+// acquire/release shows up as a reordered or torn element here.
+//
+//  - ring: one producer fills elements in place with a sequence number and a
+//    derived pattern, one consumer checks order and pattern in place
+//  - seqlock: one writer updates a multi-word record, several readers check
+//    every copy they accept is internally consistent; each reader must also
+//    accept more than one read per MIN_READS_PER writes, so a run where the
+//    readers never overlap the writer does not pass
+//
+// Build and run (from Motor_Project):
+//   gcc -std=gnu11 -O2 -Wall -pthread -IHeaders -o lockfree_stress Tools/host/lockfree_stress.c Source/lockfree.c
+//   ./lockfree_stress [iterations]
+// Exit code is non-zero on any violation.
+#include "lockfree.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* ----------------- Ring ----------------- */
+
+#define RING_N 64U
+#define WORDS 7U
+
+typedef struct {
+    uint32_t seq;
+    uint32_t pattern[WORDS];
+} item_t;
+
+RING_STORAGE(ring_buf, item_t, RING_N);
+static Ring_t ring;
+static uint32_t iterations = 10000000U;
+
+static uint32_t pattern_of(uint32_t seq, uint32_t word) {
+    return (seq * 2654435761U) ^ (word * 0x9E3779B9U);
+}
+
+static void *ring_producer(void *arg) {
+    (void)arg;
+    for (uint32_t seq = 0U; seq < iterations;) {
+        item_t *slot = (item_t *)Ring_Reserve(&ring);
+        if (slot == NULL) {
+            sched_yield(); // full
+            continue;
+        }
+        slot->seq = seq;
+        for (uint32_t w = 0U; w < WORDS; w++)
+            slot->pattern[w] = pattern_of(seq, w);
+        Ring_Commit(&ring);
+        seq++;
+    }
+    return NULL;
+}
+
+static void *ring_consumer(void *arg) {
+    uint32_t *errors = (uint32_t *)arg;
+    for (uint32_t seq = 0U; seq < iterations;) {
+        const item_t *slot = (const item_t *)Ring_Peek(&ring);
+        if (slot == NULL) {
+            sched_yield(); // empty
+            continue;
+        }
+        uint8_t bad = (uint8_t)(slot->seq != seq);
+        for (uint32_t w = 0U; w < WORDS; w++)
+            bad |= (uint8_t)(slot->pattern[w] != pattern_of(seq, w));
+        if (bad && (*errors)++ < 5U)
+            fprintf(stderr, "ring: expected %u, got %u\n", seq, slot->seq);
+        Ring_Release(&ring);
+        seq++;
+    }
+    return NULL;
+}
+
+/* ----------------- Seqlock ----------------- */
+
+#define READERS 3
+#define MIN_READS_PER 1000U	// writes per accepted read a reader must beat
+
+typedef struct {
+    uint32_t seq;
+    int32_t a;
+    int32_t b; // always -a
+    uint64_t sum; // seq + a
+} record_t;
+
+static SeqLock_t lock;
+static record_t shared;
+static _Atomic int writer_done = 0;
+
+typedef struct {
+    uint32_t errors;
+    uint32_t reads;
+    uint32_t failed;
+    uint32_t last_seq;
+} reader_t;
+
+static void *seq_writer(void *arg) {
+    (void)arg;
+    for (uint32_t seq = 1U; seq <= iterations; seq++) {
+        const int32_t a = (int32_t)(seq * 7U);
+        const record_t r = {seq, a, -a, (uint64_t)seq + (uint64_t)(uint32_t)a};
+        SeqLock_Write(&lock, &shared, &r, sizeof(r));
+    }
+    atomic_store(&writer_done, 1);
+    return NULL;
+}
+
+static void *seq_reader(void *arg) {
+    reader_t *me = (reader_t *)arg;
+    while (!atomic_load(&writer_done)) {
+        record_t r;
+        if (!SeqLock_Read(&lock, &r, &shared, sizeof(r), 4U)) {
+            me->failed++; // writer is mid-update
+            sched_yield();
+            continue;
+        }
+        me->reads++;
+        const uint8_t torn = (uint8_t)(r.b != -r.a || r.sum != (uint64_t)r.seq + (uint64_t)(uint32_t)r.a ||
+                                       r.a != (int32_t)(r.seq * 7U));
+        const uint8_t backwards = (uint8_t)(r.seq < me->last_seq);
+        if ((torn || backwards) && me->errors++ < 5U)
+            fprintf(stderr, "seqlock: %s record, seq %u\n", torn ? "torn" : "stale", r.seq);
+        me->last_seq = r.seq;
+    }
+    return NULL;
+}
+
+/* ----------------- Main ----------------- */
+
+int main(int argc, char **argv) {
+    if (argc > 1)
+        iterations = (uint32_t)strtoul(argv[1], NULL, 0);
+
+    uint32_t ring_errors = 0U;
+    Ring_Init(&ring, ring_buf, sizeof(ring_buf[0]), RING_N);
+    pthread_t prod, cons;
+    pthread_create(&cons, NULL, ring_consumer, &ring_errors);
+    pthread_create(&prod, NULL, ring_producer, NULL);
+    pthread_join(prod, NULL);
+    pthread_join(cons, NULL);
+    printf("ring:    %u items, %u errors\n", iterations, ring_errors);
+
+    reader_t readers[READERS] = {{0}};
+    pthread_t writer, rt[READERS];
+    for (int i = 0; i < READERS; i++)
+        pthread_create(&rt[i], NULL, seq_reader, &readers[i]);
+    pthread_create(&writer, NULL, seq_writer, NULL);
+    pthread_join(writer, NULL);
+    uint32_t seq_errors = 0U;
+    for (int i = 0; i < READERS; i++) {
+        pthread_join(rt[i], NULL);
+        const uint8_t starved = (uint8_t)(readers[i].reads <= iterations / MIN_READS_PER);
+        printf("seqlock: reader %d: %u reads, %u gave up, %u errors%s\n", i, readers[i].reads,
+               readers[i].failed, readers[i].errors, starved ? ", too few reads" : "");
+        seq_errors += readers[i].errors + starved;
+    }
+
+    return (ring_errors != 0U || seq_errors != 0U) ? 1 : 0;
+}
@@ -0,0 +1,400 @@
+// log_decode.c
+//
+// Host decoder for the deferred-format log (g_log, Headers/log.h). Messages
+// arrive as raw words; the dictionary written by log_dict supplies the format
+// string of each call site, and formatting happens here.
+//
+// Two inputs are understood:
+//  - a memory dump of g_log, e.g. from the uVision debugger command window
+//      SAVE log.hex g_log, (g_log + sizeof(g_log) - 1)
+//    (Intel HEX, or a raw binary dump of the same range)
+//  - a raw SWO capture of the ITM packet stream (-swo); only 32-bit writes to
+//    stimulus port LOG_ITM_PORT are used, everything else is skipped
+//
+// Besides printf conversions (%d %i %u %x %X %o %c, with flags and width),
+// formats may use %q<n> for a signed fixed-point argument with n fractional
+// bits, e.g. %q30 for a control output.
+//
+// Build and run (from Motor_Project):
+//   gcc -std=c11 -Wall -o log_dict Tools/host/log_dict.c
+//   gcc -std=c11 -Wall -o log_decode Tools/host/log_decode.c
+//   ./log_dict Source/*.c > log_dict.txt
+//   ./log_decode log_dict.txt log.hex        # RAM dump
+//   ./log_decode -swo log_dict.txt swo.bin   # SWO capture
+//   ./log_decode -demo                       # decode a synthetic log
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ----------------- Layout (must match Headers/log.h) ----------------- */
+
+#define LOG_MAGIC 0x31474F4CU
+#define HEADER_WORDS 7U
+#define LOG_SYNC 0x15U
+#define LOG_ARGS_MAX 4U
+#define LOG_ITM_PORT 1U
+#define MAX_WORDS 65536U
+
+#define DICT_MAX 4096
+#define TEXT_MAX 1024
+
+typedef struct {
+    uint32_t id;		// LOG_FILE_ID << 16 | line
+    uint32_t nargs;
+    char site[256];
+    char fmt[TEXT_MAX];
+} entry_t;
+
+static entry_t dict[DICT_MAX];
+static int dict_n = 0;
+
+static uint8_t image[(HEADER_WORDS + MAX_WORDS) * 4U];
+static size_t image_len = 0;
+static uint32_t words[MAX_WORDS];
+static size_t words_n = 0;
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* ----------------- Dictionary ----------------- */
+
+// Undo the C escapes kept by log_dict.
+static void unescape(char *s) {
+    char *o = s;
+    for (; *s; s++) {
+        if (*s != '\\' || s[1] == '\0') {
+            *o++ = *s;
+            continue;
+        }
+        switch (*++s) {
+        case 'n': *o++ = '\n'; break;
+        case 't': *o++ = '\t'; break;
+        case 'r': *o++ = '\r'; break;
+        default: *o++ = *s; break;
+        }
+    }
+    *o = '\0';
+}
+
+static int add_entry(uint32_t id, uint32_t nargs, const char *site, const char *fmt) {
+    if (dict_n >= DICT_MAX)
+        return 0;
+    entry_t *e = &dict[dict_n++];
+    e->id = id;
+    e->nargs = nargs;
+    snprintf(e->site, sizeof(e->site), "%s", site);
+    snprintf(e->fmt, sizeof(e->fmt), "%s", fmt);
+    unescape(e->fmt);
+    return 1;
+}
+
+static int load_dict(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    char line[TEXT_MAX + 300];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#')
+            continue;
+        unsigned id, nargs;
+        char site[256];
+        int pos = 0;
+        if (sscanf(line, "%x\t%u\t%255s\t%n", &id, &nargs, site, &pos) < 3 || line[pos] != '"')
+            continue;
+        char *fmt = line + pos + 1;
+        char *end = strrchr(fmt, '"');
+        if (end != NULL)
+            *end = '\0';
+        add_entry(id, nargs, site, fmt);
+    }
+    fclose(f);
+    return 1;
+}
+
+static const entry_t *lookup(uint32_t id) {
+    for (int i = 0; i < dict_n; i++)
+        if (dict[i].id == id)
+            return &dict[i];
+    return NULL;
+}
+
+/* ----------------- Formatting ----------------- */
+
+static void format(const char *fmt, const uint32_t *args, uint32_t nargs, char *out, size_t size) {
+    size_t n = 0;
+    uint32_t a = 0;
+    while (*fmt && n + 1 < size) {
+        if (*fmt != '%') {
+            out[n++] = *fmt++;
+            continue;
+        }
+        if (fmt[1] == '%') {
+            out[n++] = '%';
+            fmt += 2;
+            continue;
+        }
+        // Rebuild the conversion spec without length modifiers.
+        char spec[32] = "%";
+        size_t k = 1;
+        const char *p = fmt + 1;
+        while (*p && strchr("-+ #0123456789.", *p) && k < sizeof(spec) - 3)
+            spec[k++] = *p++;
+        while (*p == 'l' || *p == 'h' || *p == 'z')
+            p++;
+        const char conv = *p ? *p++ : '\0';
+        char buf[64];
+        if (a >= nargs) {
+            snprintf(buf, sizeof(buf), "<?>");
+        } else if (conv == 'q') {
+            // Fixed point: %q<fraction bits>
+            const int bits = (int)strtol(p, (char **)&p, 10);
+            snprintf(buf, sizeof(buf), "%.6f", (double)(int32_t)args[a++] / (double)(1ULL << (bits & 31)));
+        } else if (conv && strchr("diuxXoc", conv)) {
+            spec[k++] = conv;
+            spec[k] = '\0';
+            if (conv == 'd' || conv == 'i' || conv == 'c')
+                snprintf(buf, sizeof(buf), spec, (int)(int32_t)args[a++]);
+            else
+                snprintf(buf, sizeof(buf), spec, (unsigned)args[a++]);
+        } else {
+            snprintf(buf, sizeof(buf), "<%%%c?>", conv);
+        }
+        for (const char *b = buf; *b && n + 1 < size; b++)
+            out[n++] = *b;
+        fmt = p;
+    }
+    out[n] = '\0';
+}
+
+/* ----------------- Messages ----------------- */
+
+static int is_header(uint32_t w) {
+    return (w >> 31) != 0U && ((w >> 3) & 0x1FU) == LOG_SYNC && (w & 7U) <= LOG_ARGS_MAX;
+}
+
+// Print the messages in w[0..n); returns the number of words skipped to resync.
+static unsigned decode_words(const uint32_t *w, size_t n, uint32_t hz) {
+    unsigned skipped = 0;
+    uint64_t t = 0;
+    uint32_t last = 0;
+    int first = 1;
+    size_t i = 0;
+    while (i < n) {
+        const uint32_t nargs = w[i] & 7U;
+        if (!is_header(w[i]) || i + 2U + nargs > n) {
+            skipped++;
+            i++;
+            continue;
+        }
+        const uint32_t id = (w[i] >> 8) & 0x7FFFFFU;
+        const uint32_t cycles = w[i + 1];
+        // Unwrap the 32-bit cycle counter; messages are in time order.
+        t = first ? 0U : t + (uint32_t)(cycles - last);
+        last = cycles;
+        first = 0;
+
+        char text[TEXT_MAX];
+        const entry_t *e = lookup(id);
+        const char *site;
+        char raw_site[64];
+        if (e != NULL && e->nargs == nargs) {
+            format(e->fmt, &w[i + 2], nargs, text, sizeof(text));
+            site = e->site;
+        } else {
+            // Stale dictionary or an unregistered file: show the raw words.
+            snprintf(raw_site, sizeof(raw_site), "file%u:%u", id >> 16, id & 0xFFFFU);
+            int len = snprintf(text, sizeof(text), "(not in dictionary)");
+            for (uint32_t k = 0; k < nargs; k++)
+                len += snprintf(text + len, sizeof(text) - (size_t)len, " 0x%08X", w[i + 2 + k]);
+            site = raw_site;
+        }
+        const char *base = strrchr(site, '/');
+        printf("%12.6f ms  %-22s %s\n", (double)t * 1e3 / (double)hz, base ? base + 1 : site, text);
+        i += 2U + nargs;
+    }
+    return skipped;
+}
+
+/* ----------------- Input ----------------- */
+
+static int hex_byte(const char *s) {
+    unsigned v;
+    return (sscanf(s, "%2x", &v) == 1) ? (int)v : -1;
+}
+
+// Intel HEX: data records only, addresses relative to the first one.
+static int load_hex(FILE *f) {
+    char line[600];
+    long base = -1;
+    uint32_t upper = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] != ':')
+            continue;
+        const int len = hex_byte(line + 1);
+        const int addr = (hex_byte(line + 3) << 8) | hex_byte(line + 5);
+        const int type = hex_byte(line + 7);
+        if (len < 0 || type < 0)
+            return 0;
+        if (type == 4) {
+            upper = (uint32_t)((hex_byte(line + 9) << 8) | hex_byte(line + 11)) << 16;
+        } else if (type == 0) {
+            const long at = (long)(upper + (uint32_t)addr);
+            if (base < 0)
+                base = at;
+            for (int i = 0; i < len; i++) {
+                const long off = at - base + i;
+                if (off < 0 || (size_t)off >= sizeof(image))
+                    return 0;
+                image[off] = (uint8_t)hex_byte(line + 9 + 2 * i);
+                if ((size_t)off + 1U > image_len)
+                    image_len = (size_t)off + 1U;
+            }
+        }
+    }
+    return 1;
+}
+
+static int load(const char *path, int raw) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    const int c = fgetc(f);
+    rewind(f);
+    int ok;
+    if (!raw && c == ':') {
+        ok = load_hex(f);
+    } else {
+        image_len = fread(image, 1, sizeof(image), f);
+        ok = 1;
+    }
+    fclose(f);
+    return ok;
+}
+
+// ITM packets: keep 32-bit software writes to LOG_ITM_PORT.
+static void parse_swo(void) {
+    size_t i = 0;
+    while (i < image_len && words_n < MAX_WORDS) {
+        const uint8_t b = image[i++];
+        if (b == 0x00U || b == 0x80U || b == 0x70U)
+            continue;   // sync (zeros, then 0x80) / overflow
+        if ((b & 0x03U) == 0U) {
+            // Timestamp or extension; a set top bit means continuation bytes follow.
+            if ((b & 0x80U) != 0U)
+                while (i < image_len && (image[i++] & 0x80U) != 0U) {
+                }
+            continue;
+        }
+        const size_t len = (b & 0x03U) == 3U ? 4U : (size_t)(b & 0x03U);
+        if (i + len > image_len)
+            break;
+        if ((b & 0x04U) == 0U && (uint32_t)(b >> 3) == LOG_ITM_PORT && len == 4U)
+            words[words_n++] = get_u32(&image[i]);
+        i += len;
+    }
+}
+
+// RAM dump: the ring from the oldest surviving message up to head.
+static int parse_dump(uint32_t *hz) {
+    if (image_len < HEADER_WORDS * 4U || get_u32(image) != LOG_MAGIC) {
+        fprintf(stderr, "not a g_log dump (bad magic)\n");
+        return 0;
+    }
+    const uint32_t size = get_u32(image + 4);
+    *hz = get_u32(image + 8);
+    const uint32_t head = get_u32(image + 12);
+    const uint32_t tail = get_u32(image + 16);
+    const uint32_t lost = get_u32(image + 24);
+    if (size == 0U || size > MAX_WORDS || (size & (size - 1U)) != 0U ||
+        image_len < (HEADER_WORDS + size) * 4U || head - tail > size) {
+        fprintf(stderr, "inconsistent g_log header\n");
+        return 0;
+    }
+    printf("ring %u words, %u written, %u messages lost on ITM\n", size, head, lost);
+    for (uint32_t k = tail; k != head; k++)
+        words[words_n++] = get_u32(image + (HEADER_WORDS + (k & (size - 1U))) * 4U);
+    return 1;
+}
+
+/* ----------------- Demo ----------------- */
+
+// Synthetic dump: a small ring that has wrapped, written like Log_Write.
+static void make_demo(void) {
+    const uint32_t size = 32U, hz = 40000000U;
+    add_entry(0x010069U, 2U, "Source/application.c:105", "setup: %u axes, CAN %u");
+    add_entry(0x02007EU, 1U, "Source/timesync.c:126", "timesync: sample rejected (%u in a row)");
+    add_entry(0x020082U, 2U, "Source/timesync.c:130", "timesync: step %d us, drift %d ppb");
+    add_entry(0x0100A0U, 2U, "Source/application.c:160", "axis %u: u = %q30");
+
+    static uint32_t ring[32];
+    uint32_t head = 0U, tail = 0U, t = 1000U;
+#define EMIT(ID, N, A, B)                                                          \
+    do {                                                                           \
+        const uint32_t msg[4] = {0x80000000U | ((uint32_t)(ID) << 8) | (LOG_SYNC << 3) | (N), \
+                                 t, (uint32_t)(A), (uint32_t)(B)};                 \
+        while (head + 2U + (N) - tail > size)                                      \
+            tail += 2U + (ring[tail % size] & 7U);                                 \
+        for (uint32_t k = 0; k < 2U + (N); k++)                                    \
+            ring[(head + k) % size] = msg[k];                                      \
+        head += 2U + (N);                                                          \
+    } while (0)
+
+    EMIT(0x010069U, 2U, 2, 1);
+    for (uint32_t tick = 0; tick < 12U; tick++) {
+        t += 400000U;
+        EMIT(0x0100A0U, 2U, tick & 1U, (int32_t)(0.25 * (1 << 30)) - (int32_t)tick * 1000000);
+        if (tick == 3U)
+            EMIT(0x020082U, 2U, -1234, 3000000);
+        if (tick == 7U)
+            EMIT(0x02007EU, 1U, 1, 0);
+    }
+    t += 400000U;
+    EMIT(0x030001U, 1U, 0xDEADBEEFU, 0); // site missing from the dictionary
+
+    const uint32_t hdr[HEADER_WORDS] = {LOG_MAGIC, size, hz, head, tail, head, 0U};
+    for (uint32_t w = 0; w < HEADER_WORDS + size; w++) {
+        const uint32_t v = (w < HEADER_WORDS) ? hdr[w] : ring[w - HEADER_WORDS];
+        for (int b = 0; b < 4; b++)
+            image[4 * w + (uint32_t)b] = (uint8_t)(v >> (8 * b));
+    }
+    image_len = (HEADER_WORDS + size) * 4U;
+}
+
+/* ----------------- Main ----------------- */
+
+int main(int argc, char **argv) {
+    int swo = 0;
+    if (argc > 1 && strcmp(argv[1], "-demo") == 0) {
+        make_demo();
+    } else {
+        if (argc > 1 && strcmp(argv[1], "-swo") == 0) {
+            swo = 1;
+            argc--;
+            argv++;
+        }
+        if (argc != 3) {
+            fprintf(stderr, "usage: log_decode [-swo] log_dict.txt <dump.hex|dump.bin|swo.bin>\n"
+                            "       log_decode -demo\n");
+            return 2;
+        }
+        if (!load_dict(argv[1]) || !load(argv[2], swo))
+            return 1;
+    }
+
+    uint32_t hz = 40000000U;
+    if (swo)
+        parse_swo();
+    else if (!parse_dump(&hz))
+        return 1;
+
+    const unsigned skipped = decode_words(words, words_n, hz);
+    if (skipped != 0U)
+        printf("(%u words skipped while resynchronising)\n", skipped);
+    return 0;
+}
@@ -0,0 +1,172 @@
+// log_dict.c
+//
+// Build-time format string extraction for the deferred-format log
+// (Headers/log.h). It scans the sources for LOG0..LOG4 calls and writes the
+// dictionary Tools/host/log_decode.c needs to turn logged words back into
+// text, one line per call site:
+//   <id hex>  <nargs>  <file>:<line>  "<format>"
+// where id = LOG_FILE_ID << 16 | line, as packed into the header word.
+//
+// The dictionary must come from the same sources as the running image, so
+// run it whenever the firmware is built, e.g. as a uVision
+// "Before Build" user command.
+//
+// Build and run (from Motor_Project):
+//   gcc -std=c11 -Wall -o log_dict Tools/host/log_dict.c
+//   ./log_dict Source/*.c > log_dict.txt
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FILE_IDS 128
+#define LINE_MAX_LEN 1024
+
+static const char *owner[FILE_IDS];
+static int errors = 0;
+
+// Start of a LOGn( call outside a string or comment, or NULL.
+static const char *find_call(const char *s, int *nargs) {
+    for (const char *p = s; (p = strstr(p, "LOG")) != NULL; p++) {
+        if (p > s && (isalnum((unsigned char)p[-1]) || p[-1] == '_'))
+            continue;
+        if (p[3] >= '0' && p[3] <= '4' && p[4] == '(') {
+            *nargs = p[3] - '0';
+            return p + 5;
+        }
+    }
+    return NULL;
+}
+
+// Copy the (possibly concatenated) string literal at s into out, escapes kept.
+static const char *take_literal(const char *s, char *out, size_t size) {
+    size_t n = 0;
+    int found = 0;
+    for (;;) {
+        while (isspace((unsigned char)*s))
+            s++;
+        if (*s != '"')
+            break;
+        found = 1;
+        for (s++; *s && *s != '"'; s++) {
+            if (*s == '\\' && s[1] != '\0' && n + 1 < size)
+                out[n++] = *s++;
+            if (n + 1 < size)
+                out[n++] = *s;
+        }
+        if (*s != '"')
+            return NULL;
+        s++;
+    }
+    out[n] = '\0';
+    return found ? s : NULL;
+}
+
+// Blank out comments, tracking /* */ across lines.
+static void strip_comments(char *line, int *in_block) {
+    int in_str = 0;
+    for (char *p = line; *p; p++) {
+        if (*in_block) {
+            if (p[0] == '*' && p[1] == '/') {
+                *in_block = 0;
+                p[0] = p[1] = ' ';
+                p++;
+            } else if (*p != '\n') {
+                *p = ' ';
+            }
+            continue;
+        }
+        if (in_str) {
+            if (*p == '\\' && p[1] != '\0')
+                p++;
+            else if (*p == '"')
+                in_str = 0;
+            continue;
+        }
+        if (*p == '"') {
+            in_str = 1;
+        } else if (p[0] == '/' && p[1] == '/') {
+            *p = '\0';
+            return;
+        } else if (p[0] == '/' && p[1] == '*') {
+            *in_block = 1;
+            p[0] = p[1] = ' ';
+            p++;
+        }
+    }
+}
+
+static void scan(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        errors++;
+        return;
+    }
+    char line[LINE_MAX_LEN];
+    int lineno = 0, file_id = 0, in_block = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        strip_comments(line, &in_block);
+
+        int id;
+        if (sscanf(line, " #define LOG_FILE_ID %d", &id) == 1) {
+            if (id <= 0 || id >= FILE_IDS) {
+                fprintf(stderr, "%s:%d: LOG_FILE_ID must be 1..%d\n", path, lineno, FILE_IDS - 1);
+                errors++;
+            } else if (owner[id] != NULL) {
+                fprintf(stderr, "%s:%d: LOG_FILE_ID %d already used by %s\n", path, lineno, id, owner[id]);
+                errors++;
+            } else {
+                owner[id] = path;
+                file_id = id;
+            }
+            continue;
+        }
+        if (line[strspn(line, " \t")] == '#')
+            continue;
+
+        int nargs, calls = 0;
+        const char *p = line;
+        while ((p = find_call(p, &nargs)) != NULL) {
+            if (++calls > 1) {
+                fprintf(stderr, "%s:%d: one LOG call per line (the line is its id)\n", path, lineno);
+                errors++;
+                break;
+            }
+            char fmt[LINE_MAX_LEN];
+            const char *end = take_literal(p, fmt, sizeof(fmt));
+            if (end == NULL || strchr(end, ')') == NULL) {
+                fprintf(stderr, "%s:%d: LOG%d call must fit on one line with a literal format\n",
+                        path, lineno, nargs);
+                errors++;
+                break;
+            }
+            if (file_id == 0) {
+                fprintf(stderr, "%s:%d: LOG%d used without LOG_FILE_ID\n", path, lineno, nargs);
+                errors++;
+                break;
+            }
+            if (lineno > 0xFFFF) {
+                fprintf(stderr, "%s:%d: line number does not fit the header\n", path, lineno);
+                errors++;
+                break;
+            }
+            printf("0x%06X\t%d\t%s:%d\t\"%s\"\n", ((unsigned)file_id << 16) | (unsigned)lineno, nargs,
+                   path, lineno, fmt);
+            p = end;
+        }
+    }
+    fclose(f);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s source.c... > log_dict.txt\n", argv[0]);
+        return 2;
+    }
+    printf("# id\tnargs\tsite\tformat\n");
+    for (int i = 1; i < argc; i++)
+        scan(argv[i]);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,502 @@
+// mem_report.c
+//
+// RAM and stack budget from the linker output of a uVision build (the
+// Listings options "Memory Map", "Size Info" and "Callgraph" are on in
+// motor_project.uvprojx):
+//   ram    RW + ZI data per module from "Image component sizes" in
+//          Listings/motor_project.map: one line per application object
+//          (controller.c, peripherals.c, application.c, ...), the STM32 HAL,
+//          the CubeMX/CMSIS glue, startup (stack and heap) and the C library,
+//          then the fill of every RAM execution region (SRAM1 is 96 KB at
+//          0x20000000, SRAM2 32 KB at 0x10000000)
+//   stack  static stack analysis from the call graph Objects/motor_project.htm:
+//          the deepest functions, the entry point of every interrupt layer of
+//          Headers/irq.h, and the worst case with all of them nested on the
+//          main stack, against its size
+//   demo   both reports on a built-in excerpt
+//
+// The static worst case assumes every layer preempts at its own deepest
+// point, so it bounds what g_irq_stack.used_max can ever show at runtime;
+// g_irq[].stack_max are sampled measurements of the same per-layer figures
+// (except the fast layer, which is too frequent to sample).
+// Functions armlink cannot size (assembly without frame info, function
+// pointers, recursion) are marked '+' and only count what is known.
+//
+// Build and run (from Motor_Project):
+//   gcc -std=gnu11 -O2 -Wall -o mem_report Tools/host/mem_report.c
+//   ./mem_report ram Listings/motor_project.map
+//   ./mem_report stack Objects/motor_project.htm [stack bytes] [top n]
+//   ./mem_report demo
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LINE_MAX_LEN 4096
+#define NAME_LEN 96
+#define MODULES_MAX 128
+#define REGIONS_MAX 16
+#define FUNCTIONS_MAX 4096
+
+#define STACK_BYTES 0x800	// Stack_Size in startup_stm32l476xx.s (IRQ_STACK_BYTES)
+#define EXC_FRAME 36		// basic exception frame (8 words) plus up to 4 bytes of alignment
+#define TOP_N 15
+
+/* ----------------- RAM by module ----------------- */
+
+typedef struct {
+    char name[NAME_LEN];
+    unsigned long rw, zi, code, ro;
+} module_t;
+
+typedef struct {
+    char name[NAME_LEN];
+    unsigned long base, size, max;
+} region_t;
+
+static module_t modules[MODULES_MAX];
+static int n_modules;
+static region_t regions[REGIONS_MAX];
+static int n_regions;
+
+// Module an object file or library member is accounted to.
+static void module_of(const char *object, int library, char *out, size_t size) {
+    if (library)
+        snprintf(out, size, "C library");
+    else if (strncmp(object, "stm32l4xx_hal", 13) == 0 && strcmp(object, "stm32l4xx_hal_msp.o") != 0)
+        snprintf(out, size, "HAL");
+    else if (strcmp(object, "main.o") == 0 || strcmp(object, "stm32l4xx_it.o") == 0 ||
+             strcmp(object, "stm32l4xx_hal_msp.o") == 0 || strncmp(object, "system_", 7) == 0)
+        snprintf(out, size, "CubeMX/CMSIS");
+    else if (strncmp(object, "startup_", 8) == 0)
+        snprintf(out, size, "startup (stack, heap)");
+    else {
+        // application.o -> application.c
+        snprintf(out, size, "%s", object);
+        char *dot = strrchr(out, '.');
+        if (dot != NULL && strcmp(dot, ".o") == 0)
+            dot[1] = 'c';
+    }
+}
+
+static void module_add(const char *name, unsigned long code, unsigned long ro, unsigned long rw,
+                       unsigned long zi) {
+    int i = 0;
+    while (i < n_modules && strcmp(modules[i].name, name) != 0)
+        i++;
+    if (i == n_modules) {
+        if (n_modules == MODULES_MAX)
+            return;
+        snprintf(modules[n_modules++].name, NAME_LEN, "%s", name);
+    }
+    modules[i].code += code;
+    modules[i].ro += ro;
+    modules[i].rw += rw;
+    modules[i].zi += zi;
+}
+
+static int by_ram(const void *a, const void *b) {
+    const module_t *x = a, *y = b;
+    const unsigned long rx = x->rw + x->zi, ry = y->rw + y->zi;
+    return (rx < ry) - (rx > ry);
+}
+
+// "Execution Region RW_IRAM1 (Exec base: 0x20000000, ..., Size: 0x..., Max: 0x..., ABSOLUTE)"
+static void parse_region(const char *line) {
+    const char *p = strstr(line, "Execution Region ");
+    const char *base = strstr(line, "Exec base: ");
+    const char *size = strstr(line, "Size: ");
+    const char *max = strstr(line, "Max: ");
+    if (p == NULL || base == NULL || size == NULL || max == NULL || n_regions == REGIONS_MAX)
+        return;
+    region_t *r = &regions[n_regions];
+    if (sscanf(p + 17, "%95s", r->name) != 1)
+        return;
+    r->base = strtoul(base + 11, NULL, 16);
+    r->size = strtoul(size + 6, NULL, 16);
+    r->max = strtoul(max + 5, NULL, 16);
+    // RAM lives below the flash alias at 0x08000000 (SRAM2) or at 0x20000000 (SRAM1).
+    if (r->base < 0x08000000UL || (r->base >= 0x20000000UL && r->base < 0x40000000UL))
+        n_regions++;
+}
+
+static int report_ram(FILE *f) {
+    char line[LINE_MAX_LEN];
+    // 0 before the table, 1 objects, 2 library members, 3 done (library totals follow)
+    int section = 0;
+    n_modules = n_regions = 0;
+
+    while (fgets(line, sizeof line, f) != NULL) {
+        if (strstr(line, "Execution Region ") != NULL) {
+            parse_region(line);
+            continue;
+        }
+        if (strstr(line, "Object Name") != NULL && strstr(line, "RW Data") != NULL) {
+            section = 1;
+            continue;
+        }
+        if (strstr(line, "Library Member Name") != NULL) {
+            section = 2;
+            continue;
+        }
+        if (strstr(line, "Library Name") != NULL) {
+            section = 3;
+            continue;
+        }
+        if (section != 1 && section != 2)
+            continue;
+
+        unsigned long code, inc, ro, rw, zi, debug;
+        char object[NAME_LEN];
+        if (sscanf(line, "%lu %lu %lu %lu %lu %lu %95s", &code, &inc, &ro, &rw, &zi, &debug, object) != 7)
+            continue;
+        if (object[0] == '(' || strstr(line, "Totals") != NULL)
+            continue;
+        char name[NAME_LEN];
+        module_of(object, section == 2, name, sizeof name);
+        module_add(name, code, ro, rw, zi);
+    }
+    if (n_modules == 0) {
+        fprintf(stderr, "mem_report: no \"Image component sizes\" table (link with Size Info on)\n");
+        return 1;
+    }
+
+    qsort(modules, (size_t)n_modules, sizeof modules[0], by_ram);
+    unsigned long rw = 0, zi = 0;
+    for (int i = 0; i < n_modules; i++) {
+        rw += modules[i].rw;
+        zi += modules[i].zi;
+    }
+    printf("RAM by module (RW data is also stored in flash)\n");
+    printf("  %-24s %8s %8s %8s %6s %8s\n", "module", "RW", "ZI", "RAM", "share", "flash");
+    for (int i = 0; i < n_modules; i++) {
+        const module_t *m = &modules[i];
+        const unsigned long ram = m->rw + m->zi;
+        printf("  %-24s %8lu %8lu %8lu %5.1f%% %8lu\n", m->name, m->rw, m->zi, ram,
+               rw + zi != 0 ? 100.0 * (double)ram / (double)(rw + zi) : 0.0, m->code + m->ro + m->rw);
+    }
+    printf("  %-24s %8lu %8lu %8lu\n", "total", rw, zi, rw + zi);
+
+    if (n_regions > 0) {
+        printf("\nRAM regions\n");
+        for (int i = 0; i < n_regions; i++) {
+            const region_t *r = &regions[i];
+            printf("  %-16s 0x%08lx %7lu of %7lu bytes (%5.1f%%), %lu free\n", r->name, r->base, r->size,
+                   r->max, r->max != 0 ? 100.0 * (double)r->size / (double)r->max : 0.0,
+                   r->max > r->size ? r->max - r->size : 0UL);
+        }
+        int sram2 = 0;
+        for (int i = 0; i < n_regions; i++)
+            sram2 |= regions[i].base >= 0x10000000UL && regions[i].base < 0x10008000UL;
+        if (!sram2)
+            printf("  SRAM2 (0x10000000, 32768 bytes) is not in the scatter file: unused\n");
+    }
+    return 0;
+}
+
+/* ----------------- Stack from the call graph ----------------- */
+
+typedef struct {
+    char name[NAME_LEN];
+    char object[NAME_LEN];
+    long own;			// own frame, -1 unknown
+    long depth;			// deepest call chain including own frame
+    int unknown;		// depth leaves something out
+    char *chain;		// deepest call chain, or NULL
+} function_t;
+
+static function_t functions[FUNCTIONS_MAX];
+static int n_functions;
+
+// Interrupt layers of Headers/irq.h, from thread mode up; each nests on the one before.
+typedef struct {
+    const char *layer;
+    const char *entries[3];
+} layer_t;
+
+static const layer_t layers[] = {
+    {"thread", {"main"}},
+    {"background (PendSV, 15)", {"PendSV_Handler"}},
+    {"SysTick (4)", {"SysTick_Handler"}},
+    {"tick (TIM7, 3)", {"TIM7_IRQHandler"}},
+    {"fast (TIM3, 2)", {"TIM3_IRQHandler"}},
+    {"CAN (1)", {"CAN1_RX0_IRQHandler", "CAN1_TX_IRQHandler"}},
+    {"faults", {"HardFault_Handler", "NMI_Handler"}},
+};
+
+static const function_t *find_function(const char *name) {
+    for (int i = 0; i < n_functions; i++)
+        if (strcmp(functions[i].name, name) == 0)
+            return &functions[i];
+    return NULL;
+}
+
+// Copy text without tags, with the entities the call graph uses decoded.
+static void strip_html(const char *s, char *out, size_t size) {
+    size_t n = 0;
+    while (*s != '\0' && *s != '\n' && n + 4 < size) {
+        if (*s == '<') {
+            while (*s != '\0' && *s != '>')
+                s++;
+            if (*s == '>')
+                s++;
+        } else if (strncmp(s, "&rArr;", 6) == 0) {
+            memcpy(out + n, "->", 2);
+            n += 2;
+            s += 6;
+        } else if (strncmp(s, "&amp;", 5) == 0) {
+            out[n++] = '&';
+            s += 5;
+        } else {
+            out[n++] = *s++;
+        }
+    }
+    out[n] = '\0';
+}
+
+// <P><STRONG><a name="[4c]"></a>main</STRONG> (Thumb, 200 bytes, Stack size 16 bytes, main.o(.text.main))
+static void parse_function(const char *line) {
+    const char *p = strstr(line, "</a>");
+    const char *end = strstr(line, "</STRONG>");
+    if (p == NULL || end == NULL || end < p || n_functions == FUNCTIONS_MAX)
+        return;
+    function_t *f = &functions[n_functions++];
+    memset(f, 0, sizeof *f);
+    p += 4;
+    snprintf(f->name, NAME_LEN, "%.*s", (int)(end - p), p);
+
+    const char *stack = strstr(end, "Stack size ");
+    f->own = -1;
+    if (stack != NULL && isdigit((unsigned char)stack[11]))
+        f->own = strtol(stack + 11, NULL, 10);
+    f->depth = f->own < 0 ? 0 : f->own;
+    f->unknown = f->own < 0;
+
+    // Object file: the word before the section name in the last parenthesis.
+    const char *obj = strrchr(end, '(');
+    if (obj != NULL) {
+        const char *start = obj;
+        while (start > end && start[-1] != ' ' && start[-1] != ',')
+            start--;
+        snprintf(f->object, NAME_LEN, "%.*s", (int)(obj - start), start);
+    }
+}
+
+// <BR><BR>[Stack]<UL><LI>Max Depth = 344 + Unknown Stack Size
+// <LI>Call Chain = main &rArr; Application_Setup &rArr; ...
+static void parse_stack(const char *line, function_t *f) {
+    const char *depth = strstr(line, "Max Depth = ");
+    if (depth != NULL) {
+        f->depth = strtol(depth + 12, NULL, 10);
+        if (strstr(depth, "Unknown") != NULL)
+            f->unknown = 1;
+    }
+    const char *chain = strstr(line, "Call Chain = ");
+    if (chain != NULL && f->chain == NULL) {
+        char text[LINE_MAX_LEN];
+        strip_html(chain + 13, text, sizeof text);
+        f->chain = strdup(text);
+    }
+}
+
+static int by_depth(const void *a, const void *b) {
+    const function_t *x = a, *y = b;
+    return (x->depth < y->depth) - (x->depth > y->depth);
+}
+
+static int report_stack(FILE *in, long stack_bytes, int top_n) {
+    char line[LINE_MAX_LEN];
+    function_t *current = NULL;
+    n_functions = 0;
+
+    while (fgets(line, sizeof line, in) != NULL) {
+        if (strstr(line, "<STRONG><a name=") != NULL) {
+            parse_function(line);
+            current = n_functions > 0 ? &functions[n_functions - 1] : NULL;
+        } else if (current != NULL) {
+            parse_stack(line, current);
+        }
+    }
+    if (n_functions == 0) {
+        fprintf(stderr, "mem_report: no functions in the call graph (link with Callgraph on)\n");
+        return 1;
+    }
+
+    // Layers first: find_function needs the file order kept until then.
+    printf("Interrupt layers (own frame, deepest chain; + = lower bound)\n");
+    long total = 0;
+    int unknown = 0;
+    for (size_t i = 0; i < sizeof layers / sizeof layers[0]; i++) {
+        const function_t *worst = NULL;
+        for (int e = 0; e < 3 && layers[i].entries[e] != NULL; e++) {
+            const function_t *f = find_function(layers[i].entries[e]);
+            if (f != NULL && (worst == NULL || f->depth > worst->depth))
+                worst = f;
+        }
+        if (worst == NULL) {
+            printf("  %-24s %-20s not in the image\n", layers[i].layer, layers[i].entries[0]);
+            continue;
+        }
+        const long frame = i == 0 ? 0 : EXC_FRAME;
+        total += worst->depth + frame;
+        unknown |= worst->unknown;
+        printf("  %-24s %-20s %5ld %5ld%s  + frame %2ld = %5ld\n", layers[i].layer, worst->name,
+               worst->own < 0 ? 0 : worst->own, worst->depth, worst->unknown ? "+" : " ", frame, total);
+        if (worst->chain != NULL)
+            printf("      %s\n", worst->chain);
+    }
+    printf("  worst case, all layers nested: %ld%s of %ld bytes (%.0f%%), %ld spare\n", total,
+           unknown ? "+" : "", stack_bytes, 100.0 * (double)total / (double)stack_bytes, stack_bytes - total);
+    if (total > stack_bytes)
+        printf("  WARNING: the main stack can overflow; raise Stack_Size and IRQ_STACK_BYTES\n");
+
+    qsort(functions, (size_t)n_functions, sizeof functions[0], by_depth);
+    printf("\nDeepest functions\n");
+    printf("  %-32s %-22s %6s %6s\n", "function", "object", "own", "depth");
+    for (int i = 0; i < n_functions && i < top_n; i++) {
+        const function_t *f = &functions[i];
+        printf("  %-32s %-22s %6ld %6ld%s\n", f->name, f->object, f->own < 0 ? 0 : f->own, f->depth,
+               f->unknown ? "+" : "");
+    }
+    for (int i = 0; i < n_functions; i++)
+        free(functions[i].chain);
+    return 0;
+}
+
+/* ----------------- Demo ----------------- */
+
+static const char demo_map[] =
+    "    Execution Region ER_IROM1 (Exec base: 0x08000000, Load base: 0x08000000, Size: 0x00005c40, Max: 0x00100000, ABSOLUTE)\n"
+    "    Execution Region RW_IRAM1 (Exec base: 0x20000000, Load base: 0x08005c40, Size: 0x0000426c, Max: 0x00018000, ABSOLUTE)\n"
+    "==============================================================================\n"
+    "\n"
+    "Image component sizes\n"
+    "\n"
+    "\n"
+    "      Code (inc. data)   RO Data    RW Data    ZI Data      Debug   Object Name\n"
+    "\n"
+    "      1204         64          0         20        412      21833   application.o\n"
+    "       212         12          0          0         96       9812   boot.o\n"
+    "       388         20          0          0        172      10343   canbus.o\n"
+    "       416         28          0          0          8      12001   canbus_bxcan.o\n"
+    "       620         36          0          0        336      11420   controller.o\n"
+    "       148          8          0          0        104       6412   irq.o\n"
+    "       356         16          0          0       2056       9810   log.o\n"
+    "      1820         96          0          4        220      27342   main.o\n"
+    "      1412         72          0         12        460      24102   peripherals.o\n"
+    "       980         44          0          4       8220      14327   recorder.o\n"
+    "        64         26        392          0       2560        740   startup_stm32l476xx.o\n"
+    "      1522         20          0          0          0      14322   stm32l4xx_hal_can.o\n"
+    "       196         16          0         12          4       6890   stm32l4xx_hal.o\n"
+    "      1020         40          0          0          0      13410   stm32l4xx_hal_rcc.o\n"
+    "       388         12          0          0          0       8122   stm32l4xx_hal_msp.o\n"
+    "       152          8          0          0          0       5423   stm32l4xx_it.o\n"
+    "        52         16         24          4          0       3140   system_stm32l4xx.o\n"
+    "       640         32          0          0        200      10901   timesync.o\n"
+    "       284         20          0          0       2064       8740   trace.o\n"
+    "       420         24          0          0         36       9012   watchdog.o\n"
+    "\n"
+    "    ----------------------------------------------------------------------\n"
+    "     12314        670        448         56      16448     257980   Object Totals\n"
+    "         0          0         32          0          0          0   (incl. Generated)\n"
+    "        32          0          0          0          0          0   (incl. Padding)\n"
+    "\n"
+    "    ----------------------------------------------------------------------\n"
+    "\n"
+    "      Code (inc. data)   RO Data    RW Data    ZI Data      Debug   Library Member Name\n"
+    "\n"
+    "         8          0          0          0          0         68   __main.o\n"
+    "        36          8          0          0          0         68   init.o\n"
+    "       110          0          0          0          0         84   memseta.o\n"
+    "        30          0          0          0          0          0   __scatter_zi.o\n"
+    "\n"
+    "    ----------------------------------------------------------------------\n"
+    "       188          8          0          0          0        220   Library Totals\n"
+    "\n"
+    "    ----------------------------------------------------------------------\n"
+    "\n"
+    "      Code (inc. data)   RO Data    RW Data    ZI Data      Debug   Library Name\n"
+    "\n"
+    "       184          8          0          0          0        220   mc_w.l\n";
+
+static const char demo_htm[] =
+    "<P><STRONG><a name=\"[1]\"></a>NMI_Handler</STRONG> (Thumb, 2 bytes, Stack size 0 bytes, stm32l4xx_it.o(.text.NMI_Handler))\n"
+    "<P><STRONG><a name=\"[2]\"></a>HardFault_Handler</STRONG> (Thumb, 12 bytes, Stack size 8 bytes, stm32l4xx_it.o(.text.HardFault_Handler))\n"
+    "<BR><BR>[Stack]<UL><LI>Max Depth = 40<LI>Call Chain = HardFault_Handler &rArr; Watchdog_Trip &rArr; Peripheral_GPIO_DisableMotorAll\n"
+    "</UL>\n"
+    "<P><STRONG><a name=\"[3]\"></a>PendSV_Handler</STRONG> (Thumb, 8 bytes, Stack size 8 bytes, stm32l4xx_it.o(.text.PendSV_Handler))\n"
+    "<BR><BR>[Stack]<UL><LI>Max Depth = 120<LI>Call Chain = PendSV_Handler &rArr; Application_Background &rArr; Irq_Report &rArr; Log_Write\n"
+    "</UL>\n"
+    "<P><STRONG><a name=\"[4]\"></a>SysTick_Handler</STRONG> (Thumb, 8 bytes, Stack size 8 bytes, stm32l4xx_it.o(.text.SysTick_Handler))\n"
+    "<BR><BR>[Stack]<UL><LI>Max Depth = 8<LI>Call Chain = SysTick_Handler &rArr; HAL_IncTick\n"
+    "</UL>\n"
+    "<P><STRONG><a name=\"[5]\"></a>TIM7_IRQHandler</STRONG> (Thumb, 40 bytes, Stack size 16 bytes, stm32l4xx_it.o(.text.TIM7_IRQHandler))\n"
+    "<BR><BR>[Stack]<UL><LI>Max Depth = 232<LI>Call Chain = TIM7_IRQHandler &rArr; Application_Tick &rArr; Controller_Update &rArr; Recorder_Tick\n"
+    "</UL>\n"
+    "<P><STRONG><a name=\"[6]\"></a>TIM3_IRQHandler</STRONG> (Thumb, 64 bytes, Stack size 16 bytes, stm32l4xx_it.o(.text.TIM3_IRQHandler))\n"
+    "<BR><BR>[Stack]<UL><LI>Max Depth = 72<LI>Call Chain = TIM3_IRQHandler &rArr; Peripheral_Sync_OnUpdate &rArr; Irq_PendTick\n"
+    "</UL>\n"
+    "<P><STRONG><a name=\"[7]\"></a>CAN1_RX0_IRQHandler</STRONG> (Thumb, 8 bytes, Stack size 8 bytes, stm32l4xx_it.o(.text.CAN1_RX0_IRQHandler))\n"
+    "<BR><BR>[Stack]<UL><LI>Max Depth = 96<LI>Call Chain = CAN1_RX0_IRQHandler &rArr; CanBus_Port_Rx0IRQHandler &rArr; TimeSync_OnSync\n"
+    "</UL>\n"
+    "<P><STRONG><a name=\"[8]\"></a>CAN1_TX_IRQHandler</STRONG> (Thumb, 8 bytes, Stack size 8 bytes, stm32l4xx_it.o(.text.CAN1_TX_IRQHandler))\n"
+    "<BR><BR>[Stack]<UL><LI>Max Depth = 48<LI>Call Chain = CAN1_TX_IRQHandler &rArr; CanBus_Port_TxIRQHandler\n"
+    "</UL>\n"
+    "<P><STRONG><a name=\"[9]\"></a>main</STRONG> (Thumb, 240 bytes, Stack size 16 bytes, main.o(.text.main))\n"
+    "<BR><BR>[Stack]<UL><LI>Max Depth = 184 + Unknown Stack Size\n"
+    "<LI>Call Chain = main &rArr; Application_Setup &rArr; HAL_CAN_Init &rArr; HAL_CAN_MspInit\n"
+    "</UL>\n"
+    "<P><STRONG><a name=\"[a]\"></a>Application_Tick</STRONG> (Thumb, 520 bytes, Stack size 56 bytes, application.o(.text.Application_Tick))\n"
+    "<BR><BR>[Stack]<UL><LI>Max Depth = 216<LI>Call Chain = Application_Tick &rArr; Controller_Update &rArr; Recorder_Tick\n"
+    "</UL>\n"
+    "<P><STRONG><a name=\"[b]\"></a>Controller_Update</STRONG> (Thumb, 300 bytes, Stack size 40 bytes, controller.o(.text.Controller_Update))\n"
+    "<BR><BR>[Stack]<UL><LI>Max Depth = 160<LI>Call Chain = Controller_Update &rArr; Recorder_Tick\n"
+    "</UL>\n"
+    "<P><STRONG><a name=\"[c]\"></a>Recorder_Tick</STRONG> (Thumb, 410 bytes, Stack size 120 bytes, recorder.o(.text.Recorder_Tick))\n"
+    "<P><STRONG><a name=\"[d]\"></a>__main</STRONG> (Thumb, 0 bytes, Stack size unknown bytes, __main.o(!!!main))\n";
+
+static int demo(void) {
+    FILE *f = fmemopen((void *)demo_map, sizeof demo_map - 1, "r");
+    if (f == NULL)
+        return 1;
+    int rc = report_ram(f);
+    fclose(f);
+    printf("\n");
+    f = fmemopen((void *)demo_htm, sizeof demo_htm - 1, "r");
+    if (f == NULL)
+        return 1;
+    rc |= report_stack(f, STACK_BYTES, TOP_N);
+    fclose(f);
+    return rc;
+}
+
+/* ----------------- Main ----------------- */
+
+static int usage(void) {
+    fprintf(stderr, "usage: mem_report ram <map> | stack <htm> [stack bytes] [top n] | demo\n");
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2)
+        return usage();
+    if (strcmp(argv[1], "demo") == 0)
+        return demo();
+    if (argc < 3)
+        return usage();
+
+    FILE *f = fopen(argv[2], "r");
+    if (f == NULL) {
+        perror(argv[2]);
+        return 1;
+    }
+    int rc;
+    if (strcmp(argv[1], "ram") == 0)
+        rc = report_ram(f);
+    else if (strcmp(argv[1], "stack") == 0)
+        rc = report_stack(f, argc > 3 ? strtol(argv[3], NULL, 0) : STACK_BYTES, argc > 4 ? atoi(argv[4]) : TOP_N);
+    else
+        rc = usage();
+    fclose(f);
+    return rc;
+}
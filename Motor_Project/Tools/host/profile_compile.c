@@ -0,0 +1,280 @@
+// profile_compile.c
+//
+// Host compiler for reference profiles (Headers/profile.h). Reads a text
+// profile, one instruction per line, '#' starts a comment:
+//   step RPM             jump to RPM
+//   ramp RPM MS          straight line to RPM over MS
+//   sine RPM MS [N]      N periods (default 1) of MS, amplitude RPM
+//   dwell MS             hold
+//   loop [COUNT]         repeat up to the matching next COUNT times
+//                        (default 0 = forever)
+//   next
+//   end                  stop, holding the reference (added if missing)
+// for example
+//   ramp 1500 1000
+//   loop 3
+//     sine 300 2000 2
+//     dwell 500
+//   next
+//   ramp 0 1000
+// and checks the image with the firmware's own loader (Source/profile.c),
+// so what it accepts the drive accepts. Outputs:
+//   -bin FILE        the image as bytes, for any upload path
+//   -ihex ADDR FILE  Intel HEX at ADDR, the address of g_profile_upload in
+//                    the map file: LOAD it in the debugger, then set
+//                    g_profile.cmd = 1 (PROFILE_CMD_UPLOAD)
+//   -c NAME          C initializer for a built-in script (Source/profile.c)
+//   -sim MS          run it for MS of ticks and print ms,reference
+//
+// Build and run (from Motor_Project):
+//   gcc -std=gnu11 -O2 -Wall -DLOG_ENABLE=0 -IHeaders -o profile_compile Tools/host/profile_compile.c Source/profile.c
+//   ./profile_compile test.prf -ihex 0x20000100 test.hex
+//   ./profile_compile test.prf -sim 20000 > test.csv
+#include "application.h"
+#include "profile.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LINE_MAX_CHARS 256
+
+static const char *const op_names[] = {"end", "step", "ramp", "sine", "dwell", "loop", "next"};
+#define OPS (sizeof(op_names) / sizeof(op_names[0]))
+
+// Parse one integer argument within [lo, hi]; 0 if missing or out of range.
+static int parse_arg(char **cursor, long long lo, long long hi, long long *value) {
+    char *tok = strtok_r(NULL, " \t\r\n", cursor);
+    if (tok == NULL)
+        return 0;
+    char *end;
+    errno = 0;
+    const long long v = strtoll(tok, &end, 0);
+    if (errno != 0 || *end != '\0' || v < lo || v > hi)
+        return 0;
+    *value = v;
+    return 1;
+}
+
+// Compile the text in f into image; prints errors with line numbers.
+static int compile(FILE *f, const char *name, Profile_Image_t *image) {
+    char line[LINE_MAX_CHARS];
+    uint32_t count = 0U, lineno = 0U;
+    int errors = 0;
+    memset(image, 0, sizeof(*image));
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash != NULL)
+            *hash = '\0';
+        char *cursor;
+        char *word = strtok_r(line, " \t\r\n", &cursor);
+        if (word == NULL)
+            continue;
+        for (char *c = word; *c; c++)
+            *c = (char)tolower((unsigned char)*c);
+
+        uint32_t op = 0U;
+        while (op < OPS && strcmp(word, op_names[op]) != 0)
+            op++;
+        if (op == OPS) {
+            fprintf(stderr, "%s:%u: unknown instruction '%s'\n", name, lineno, word);
+            errors++;
+            continue;
+        }
+        if (count == PROFILE_INSNS_MAX) {
+            fprintf(stderr, "%s:%u: more than %u instructions\n", name, lineno, PROFILE_INSNS_MAX);
+            return -1;
+        }
+
+        Profile_Insn_t in = {(uint8_t)op, 0U, 0, 0U};
+        long long rpm = 0, ms = 0, n = 1;
+        int ok = 1;
+        switch (op) {
+        case PROFILE_STEP:
+            ok = parse_arg(&cursor, INT16_MIN, INT16_MAX, &rpm);
+            break;
+        case PROFILE_RAMP:
+            ok = parse_arg(&cursor, INT16_MIN, INT16_MAX, &rpm) && parse_arg(&cursor, 0, UINT32_MAX, &ms);
+            break;
+        case PROFILE_SINE:
+            ok = parse_arg(&cursor, INT16_MIN, INT16_MAX, &rpm) && parse_arg(&cursor, 1, UINT32_MAX, &ms);
+            if (ok && !parse_arg(&cursor, 1, UINT8_MAX, &n))
+                n = 1;
+            break;
+        case PROFILE_DWELL:
+            ok = parse_arg(&cursor, 0, UINT32_MAX, &ms);
+            break;
+        case PROFILE_LOOP:
+            if (!parse_arg(&cursor, 0, UINT32_MAX, &ms))
+                ms = 0;
+            break;
+        default:
+            break;
+        }
+        if (!ok) {
+            fprintf(stderr, "%s:%u: '%s' needs valid arguments\n", name, lineno, word);
+            errors++;
+            continue;
+        }
+        in.rpm = (int16_t)rpm;
+        in.arg = (uint32_t)ms;
+        in.n = (uint8_t)((op == PROFILE_SINE) ? n : 0);
+        image->insn[count++] = in;
+    }
+
+    if (count == 0U || image->insn[count - 1U].op != PROFILE_END) {
+        if (count == PROFILE_INSNS_MAX) {
+            fprintf(stderr, "%s: no room for the final end\n", name);
+            return -1;
+        }
+        image->insn[count++] = (Profile_Insn_t){PROFILE_END, 0U, 0, 0U};
+    }
+    if (errors)
+        return -1;
+
+    image->magic = PROFILE_MAGIC;
+    image->count = (uint16_t)count;
+    image->hash = Profile_Hash(image->insn, count);
+    return 0;
+}
+
+/* ----------------- Output ----------------- */
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+    for (uint32_t b = 0U; b < 4U; b++)
+        *p++ = (uint8_t)(v >> (8U * b));
+    return p;
+}
+
+// The image as the target lays it out: header, then count instructions.
+static uint32_t serialize(const Profile_Image_t *image, uint8_t *out) {
+    uint8_t *p = put_u32(out, image->magic);
+    p = put_u32(p, (uint32_t)image->count | ((uint32_t)image->reserved << 16));
+    p = put_u32(p, image->hash);
+    for (uint32_t i = 0U; i < image->count; i++) {
+        const Profile_Insn_t *in = &image->insn[i];
+        *p++ = in->op;
+        *p++ = in->n;
+        *p++ = (uint8_t)(uint16_t)in->rpm;
+        *p++ = (uint8_t)((uint16_t)in->rpm >> 8);
+        p = put_u32(p, in->arg);
+    }
+    return (uint32_t)(p - out);
+}
+
+static void ihex_record(FILE *f, uint8_t type, uint16_t addr, const uint8_t *data, uint32_t len) {
+    uint8_t sum = (uint8_t)(len + (addr >> 8) + (addr & 0xFFU) + type);
+    fprintf(f, ":%02X%04X%02X", len, addr, type);
+    for (uint32_t i = 0U; i < len; i++) {
+        fprintf(f, "%02X", data[i]);
+        sum = (uint8_t)(sum + data[i]);
+    }
+    fprintf(f, "%02X\n", (uint8_t)(0x100U - sum) & 0xFFU);
+}
+
+static void write_ihex(FILE *f, uint32_t addr, const uint8_t *data, uint32_t len) {
+    uint32_t upper = 0xFFFFFFFFU;
+    for (uint32_t off = 0U; off < len; off += 16U) {
+        const uint32_t at = addr + off;
+        if ((at >> 16) != upper) {
+            upper = at >> 16;
+            const uint8_t ext[2] = {(uint8_t)(upper >> 8), (uint8_t)upper};
+            ihex_record(f, 0x04U, 0U, ext, 2U);
+        }
+        const uint32_t n = (len - off < 16U) ? len - off : 16U;
+        ihex_record(f, 0x00U, (uint16_t)at, &data[off], n);
+    }
+    ihex_record(f, 0x01U, 0U, NULL, 0U);
+}
+
+static void write_c(const Profile_Image_t *image, const char *name) {
+    printf("static const Profile_Insn_t %s[] = {\n", name);
+    for (uint32_t i = 0U; i < image->count; i++) {
+        const Profile_Insn_t *in = &image->insn[i];
+        static const char *const macros[] = {"PROFILE_END", "PROFILE_STEP", "PROFILE_RAMP", "PROFILE_SINE",
+                                             "PROFILE_DWELL", "PROFILE_LOOP", "PROFILE_NEXT"};
+        printf("    {%s, %uU, %d, %uU},\n", macros[in->op], in->n, in->rpm, in->arg);
+    }
+    printf("};\n");
+}
+
+// Run the script on the firmware interpreter, one control tick at a time,
+// starting from a stopped profile (reference 0).
+static void simulate(const Profile_Image_t *image, uint32_t run_ms) {
+    Profile_Init(0U);
+    g_profile.cmd = PROFILE_CMD_STOP;
+    Profile_Tick(0U);
+    Profile_Load(image, 0U);
+    printf("ms,reference\n");
+    printf("0,%d\n", g_profile.reference);
+    for (uint32_t ms = PERIOD_CTRL; ms <= run_ms; ms += PERIOD_CTRL) {
+        Profile_Tick(ms);
+        printf("%u,%d\n", ms, g_profile.reference);
+    }
+    fprintf(stderr, "%s at %u ms, at most %u instructions in one tick\n",
+            g_profile.running ? "still running" : "ended", run_ms, g_profile.steps_max);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        fprintf(stderr, "usage: profile_compile PROFILE -bin FILE\n"
+                        "       profile_compile PROFILE -ihex ADDR FILE\n"
+                        "       profile_compile PROFILE -c NAME\n"
+                        "       profile_compile PROFILE -sim MS\n");
+        return 2;
+    }
+    FILE *f = fopen(argv[1], "r");
+    if (f == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    static Profile_Image_t image;
+    const int rc = compile(f, argv[1], &image);
+    fclose(f);
+    if (rc != 0)
+        return 1;
+
+    // The firmware loader has the last word.
+    Profile_Init(0U);
+    const uint8_t status = Profile_Load(&image, 0U);
+    if (status != PROFILE_OK) {
+        static const char *const why[] = {"ok", "bad magic", "bad size", "hash mismatch", "bad instruction",
+                                          "unbalanced or too deeply nested loop", "no end", "no such script"};
+        fprintf(stderr, "%s: rejected by the loader: %s\n", argv[1], why[status]);
+        return 1;
+    }
+
+    uint8_t bytes[sizeof(Profile_Image_t)];
+    const uint32_t len = serialize(&image, bytes);
+    if (strcmp(argv[2], "-bin") == 0) {
+        FILE *out = fopen(argv[3], "wb");
+        if (out == NULL || fwrite(bytes, 1U, len, out) != len) {
+            perror(argv[3]);
+            return 1;
+        }
+        fclose(out);
+    } else if (strcmp(argv[2], "-ihex") == 0 && argc == 5) {
+        FILE *out = fopen(argv[4], "w");
+        if (out == NULL) {
+            perror(argv[4]);
+            return 1;
+        }
+        write_ihex(out, (uint32_t)strtoul(argv[3], NULL, 0), bytes, len);
+        fclose(out);
+    } else if (strcmp(argv[2], "-c") == 0) {
+        write_c(&image, argv[3]);
+        return 0;
+    } else if (strcmp(argv[2], "-sim") == 0) {
+        simulate(&image, (uint32_t)strtoul(argv[3], NULL, 0));
+        return 0;
+    } else {
+        fprintf(stderr, "unknown output '%s'\n", argv[2]);
+        return 2;
+    }
+    fprintf(stderr, "%u instructions, %u bytes\n", image.count, len);
+    return 0;
+}
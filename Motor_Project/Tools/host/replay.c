@@ -0,0 +1,352 @@
+// replay.c
+//
+// Host replay of a control-loop recording (g_recorder, Headers/recorder.h).
+// The recorded encoder counts, tick times, references, tunable changes and
+// gated outputs (what the drive ramp and stall detector let through, which
+// the thermal model heats with) are fed through the same velocity estimator
+// (Source/peripherals.c, built with PERIPHERALS_ESTIMATOR_ONLY) and
+// controller (Source/controller.c), in the order Application_Tick runs them,
+// so the control output comes out bit-exact. The checksums in the stream
+// confirm it tick window by window.
+//
+// Dump g_recorder from the uVision debugger command window, e.g.
+//   SAVE rec.hex g_recorder, (g_recorder + sizeof(g_recorder) - 1)
+// which writes Intel HEX; a raw binary dump of the same range also works.
+// Build with the AXIS_COUNT of the firmware. RECORDER_BYTES only has to hold
+// the recording, so a large value serves every dump.
+//
+// Build and run (from Motor_Project):
+//   gcc -std=gnu11 -O2 -Wall -DAXIS_COUNT=1 -DPERIPHERALS_ESTIMATOR_ONLY -DTRACE_ENABLE=0 -DRECORDER_BYTES=4194304U -IHeaders -o replay Tools/host/replay.c Source/recorder.c Source/controller.c Source/peripherals.c -lm
+//   ./replay rec.hex          # replay, verify checksums, summary
+//   ./replay -v rec.hex       # also print every tick (CSV)
+//   ./replay -demo [ticks]    # record a simulated run, replay it, time it
+#include "controller.h"
+#include "peripherals.h"
+#include "recorder.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HEADER_BYTES 28U
+#define PERIOD_MS 10U
+
+extern volatile int32_t Kp, Ki;
+extern volatile int32_t REV_MODE;
+extern volatile int32_t MANUAL_AXES, MANUAL_DUTY[AXIS_MAX];
+extern volatile int32_t g_vel_window_ms;
+
+static Recorder_Buffer_t dump;
+static uint8_t image[HEADER_BYTES + RECORDER_BYTES];
+static size_t image_len = 0;
+
+/* ----------------- Replay ----------------- */
+
+typedef struct {
+    uint32_t ticks;
+    uint32_t checks;
+    uint32_t bad_checks;
+    uint32_t first_bad_ms;
+    int status;   // Last Recorder_ReaderNext result
+} result_t;
+
+// Run one recording through the estimator and controller. If expect is given,
+// every output is also compared with it.
+static result_t replay(const Recorder_Buffer_t *buffer, int verbose, const int32_t *expect,
+                       uint32_t *mismatches) {
+    result_t r = {0};
+    Recorder_Reader_t reader;
+    if (!Recorder_ReaderInit(&reader, buffer)) {
+        r.status = -2;
+        return r;
+    }
+    Recorder_Tick_t tick;
+    uint32_t hash = 0U;
+    int32_t control[AXIS_COUNT];
+    while ((r.status = Recorder_ReaderNext(&reader, &tick)) == 1) {
+        int32_t velocity[AXIS_COUNT];
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++)
+            Peripheral_Encoder_SetLatched(axis, tick.counts[axis]);
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+            velocity[axis] = Peripheral_Encoder_CalculateVelocityAxis(axis, tick.millisec);
+            control[axis] = Controller_PIControllerAxis(axis, &tick.reference[axis], &velocity[axis],
+                                                        &tick.millisec);
+            if (tick.has_applied)
+                Controller_SetApplied(axis, tick.applied[axis]);
+        }
+        hash = Recorder_Hash(hash, control);
+        if (tick.has_check) {
+            r.checks++;
+            if (hash != tick.check && r.bad_checks++ == 0U)
+                r.first_bad_ms = tick.millisec;
+        }
+        if (expect != NULL) {
+            for (uint8_t axis = 0; axis < AXIS_COUNT; axis++)
+                *mismatches += (uint32_t)(control[axis] != expect[r.ticks * AXIS_COUNT + axis]);
+        }
+        if (verbose) {
+            printf("%u", (unsigned)tick.millisec);
+            for (uint8_t axis = 0; axis < AXIS_COUNT; axis++)
+                printf(",%d,%d,%d,%d", (int)tick.counts[axis], (int)tick.reference[axis],
+                       (int)velocity[axis], (int)control[axis]);
+            printf("\n");
+        }
+        r.ticks++;
+    }
+    return r;
+}
+
+static int report(const result_t *r) {
+    if (r->status == -2) {
+        fprintf(stderr, "recording does not start with a usable keyframe (AXIS_COUNT %d?)\n", AXIS_COUNT);
+        return 1;
+    }
+    printf("replayed %u ticks, %u/%u checksums match", r->ticks, r->checks - r->bad_checks, r->checks);
+    if (r->bad_checks != 0U)
+        printf(" (first divergence before t=%u ms)", r->first_bad_ms);
+    if (r->status < 0)
+        printf(", stream corrupt after the last tick");
+    printf("\n");
+    return (r->bad_checks != 0U || r->status < 0) ? 1 : 0;
+}
+
+/* ----------------- Input ----------------- */
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int hex_byte(const char *s) {
+    unsigned v;
+    return (sscanf(s, "%2x", &v) == 1) ? (int)v : -1;
+}
+
+// Intel HEX: data records only, addresses relative to the first one.
+static int load_hex(FILE *f) {
+    char line[600];
+    long base = -1;
+    uint32_t upper = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] != ':')
+            continue;
+        const int len = hex_byte(line + 1);
+        const int addr = (hex_byte(line + 3) << 8) | hex_byte(line + 5);
+        const int type = hex_byte(line + 7);
+        if (len < 0 || type < 0)
+            return 0;
+        if (type == 4) {
+            upper = (uint32_t)((hex_byte(line + 9) << 8) | hex_byte(line + 11)) << 16;
+        } else if (type == 0) {
+            const long at = (long)(upper + (uint32_t)addr);
+            if (base < 0)
+                base = at;
+            for (int i = 0; i < len; i++) {
+                const long off = at - base + i;
+                if (off < 0 || (size_t)off >= sizeof(image))
+                    return 0;
+                image[off] = (uint8_t)hex_byte(line + 9 + 2 * i);
+                if ((size_t)off + 1U > image_len)
+                    image_len = (size_t)off + 1U;
+            }
+        }
+    }
+    return 1;
+}
+
+static int load(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    const int c = fgetc(f);
+    rewind(f);
+    int ok;
+    if (c == ':') {
+        ok = load_hex(f);
+    } else {
+        image_len = fread(image, 1, sizeof(image), f);
+        ok = 1;
+    }
+    fclose(f);
+    if (!ok)
+        return 0;
+
+    // Header words, then the stream; the firmware buffer may be smaller than ours.
+    if (image_len < HEADER_BYTES || get_u32(image) != RECORDER_MAGIC) {
+        fprintf(stderr, "not a g_recorder dump (bad magic)\n");
+        return 0;
+    }
+    dump.magic = get_u32(image);
+    dump.axis_count = get_u32(image + 4);
+    dump.period_ms = get_u32(image + 8);
+    dump.capacity = get_u32(image + 12);
+    dump.used = get_u32(image + 16);
+    dump.ticks = get_u32(image + 20);
+    dump.state = get_u32(image + 24);
+    if (dump.used > RECORDER_BYTES || HEADER_BYTES + dump.used > image_len) {
+        fprintf(stderr, "dump is truncated (%u bytes recorded)\n", dump.used);
+        return 0;
+    }
+    memcpy(dump.data, image + HEADER_BYTES, dump.used);
+    printf("recording: %u axes, %u ticks in %u of %u bytes, %s\n", dump.axis_count, dump.ticks,
+           dump.used, dump.capacity, (dump.state == RECORDER_FULL) ? "full" : "open");
+    return 1;
+}
+
+/* ----------------- Demo ----------------- */
+
+// Live run against a first-order motor model, recorded like the firmware does.
+// Near the end axis 0 is also gated like the drive does it: off for a while
+// (a fault), then ramped back in (the soft start). That only shows in the
+// winding heat, which is compared at the end.
+#define GATE_OFF 3000U		// ticks
+#define GATE_RAMP 20U
+static uint32_t simulate(uint32_t ticks, int32_t *live) {
+    const uint32_t gate_at = (ticks > 2U * GATE_OFF) ? ticks - GATE_OFF - GATE_OFF / 3U : UINT32_MAX;
+    const double max_rpm = 11200.0, tau_s = 0.05, counts_per_rev = 2048.0;
+    double rpm = 0.0, pos = 0.0;
+    int32_t local_ref = 2000;
+    uint32_t millisec = 0U, recorded = 0U;
+    int32_t control[AXIS_COUNT] = {0};
+    int32_t applied[AXIS_COUNT] = {0};
+    srand(1);
+
+    Controller_Reset();
+    Recorder_Init(PERIOD_MS);
+    for (uint32_t k = 1U; k <= ticks; k++) {
+        // A missed tick now and then, as after a long debugger halt.
+        millisec += (k % 5000U == 0U) ? 2U * PERIOD_MS : PERIOD_MS;
+        if (millisec % 4000U == 0U)
+            local_ref = -local_ref;
+        if (k == 300U)
+            Recorder_Arm();   // restart mid-run, from a warm estimator and integrator
+
+        // Plant between ticks, 1 ms steps with the last outputs held.
+        for (uint32_t ms = 0U; ms < PERIOD_MS; ms++) {
+            const double duty = (double)applied[0] / 1073741824.0;
+            rpm += (duty * max_rpm - rpm) * (0.001 / tau_s) + ((rand() % 21) - 10) * 0.2;
+            pos += rpm / 60.0 * counts_per_rev * 0.001;
+        }
+
+        int16_t counts[AXIS_COUNT];
+        int32_t reference[AXIS_COUNT];
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+            // Other axes see a scaled copy of the same motion.
+            counts[axis] = (int16_t)(uint16_t)(int64_t)llround(pos * (1.0 + 0.1 * axis));
+            reference[axis] = local_ref;
+            Peripheral_Encoder_SetLatched(axis, counts[axis]);
+        }
+        for (uint8_t axis = 0; axis < AXIS_COUNT; axis++) {
+            int32_t velocity = Peripheral_Encoder_CalculateVelocityAxis(axis, millisec);
+            control[axis] = Controller_PIControllerAxis(axis, &reference[axis], &velocity, &millisec);
+            applied[axis] = control[axis];
+            if (axis == 0U && k >= gate_at && k < gate_at + GATE_OFF)
+                applied[axis] = 0;
+            else if (axis == 0U && k >= gate_at + GATE_OFF && k < gate_at + GATE_OFF + GATE_RAMP)
+                applied[axis] = (int32_t)(((int64_t)control[axis] * (int64_t)(k - gate_at - GATE_OFF)) / GATE_RAMP);
+            Controller_SetApplied(axis, applied[axis]);
+        }
+
+        // Tunables changed from Watch after this tick's outputs, as the
+        // recorder stamps them: in effect from the next tick on.
+        if (k == 2000U)
+            Ki = 8000;
+        if (k == 3500U)
+            g_vel_window_ms = 60;
+        if (k == 5200U)
+            REV_MODE = CONTROLLER_REV_BANGBANG;
+        if (k == 6000U) {
+            MANUAL_DUTY[0] = 214748365;   // axis 0 on a fixed 20 % duty
+            MANUAL_AXES = 1;
+        }
+        if (k == 6600U)
+            MANUAL_AXES = 0;
+        if (k == 7000U)
+            Kp = 400;
+
+        // Keep the outputs of the ticks that made it into the recording.
+        const uint32_t before = g_recorder.ticks;
+        Recorder_Tick(millisec, counts, reference, control, applied);
+        if (g_recorder.ticks == before + 1U) {
+            memcpy(&live[before * AXIS_COUNT], control, sizeof(control));
+            recorded = g_recorder.ticks;
+        }
+    }
+    return recorded;
+}
+
+static int demo(uint32_t ticks) {
+    int32_t *live = malloc(sizeof(int32_t) * AXIS_COUNT * ticks);
+    if (live == NULL)
+        return 1;
+    const uint32_t recorded = simulate(ticks, live);
+    uint16_t thermal[AXIS_COUNT];
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++)
+        thermal[axis] = Controller_Thermal(axis);
+    printf("recorded %u ticks in %u bytes (%.2f bytes/tick, %u axes)\n", recorded, g_recorder.used,
+           (double)g_recorder.used / recorded, AXIS_COUNT);
+
+    // Scramble what the keyframe has to restore.
+    Controller_Reset();
+    Ki = 0;
+    g_vel_window_ms = 1;
+    REV_MODE = CONTROLLER_REV_PI;
+    MANUAL_AXES = 1;
+    Kp = 0;
+
+    uint32_t mismatches = 0U;
+    const result_t r = replay(&g_recorder, 0, live, &mismatches);
+    const int rc = report(&r);
+    printf("outputs differing from the live run: %u\n", mismatches);
+    uint32_t hot = 0U;
+    for (uint8_t axis = 0; axis < AXIS_COUNT; axis++)
+        hot += (uint32_t)(Controller_Thermal(axis) != thermal[axis]);
+    printf("winding heat differing at the end: %u axes (axis 0 at %u permille)\n", hot, thermal[0]);
+    mismatches += hot;
+
+    // Throughput: replay repeatedly for about half a second.
+    struct timespec t0, t1;
+    uint64_t total = 0U;
+    double elapsed = 0.0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    do {
+        total += replay(&g_recorder, 0, NULL, &mismatches).ticks;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        elapsed = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    } while (elapsed < 0.5);
+    printf("replay speed: %.2f M ticks/s\n", (double)total / elapsed * 1e-6);
+    free(live);
+    return (rc != 0 || mismatches != 0U) ? 1 : 0;
+}
+
+/* ----------------- Main ----------------- */
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "-demo") == 0)
+        return demo((argc > 2) ? (uint32_t)atoi(argv[2]) : 200000U);
+
+    int verbose = 0;
+    if (argc > 1 && strcmp(argv[1], "-v") == 0) {
+        verbose = 1;
+        argc--;
+        argv++;
+    }
+    if (argc != 2) {
+        fprintf(stderr, "usage: replay [-v] <rec.hex|rec.bin>\n"
+                        "       replay -demo [ticks]\n");
+        return 2;
+    }
+    if (!load(argv[1]))
+        return 1;
+    if (verbose) {
+        printf("ms");
+        for (int axis = 0; axis < AXIS_COUNT; axis++)
+            printf(",count%d,ref%d,rpm%d,u%d", axis, axis, axis, axis);
+        printf("\n");
+    }
+    const result_t r = replay(&dump, verbose, NULL, NULL);
+    return report(&r);
+}
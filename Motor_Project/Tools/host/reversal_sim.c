@@ -0,0 +1,193 @@
+// reversal_sim.c
+//
+// Host plant simulation of direction reversals under each strategy of the
+// reversal manager (Headers/controller.h). The firmware estimator and
+// controller (Source/peripherals.c built with PERIPHERALS_ESTIMATOR_ONLY,
+// Source/controller.c) run every 10 ms tick against a DC motor model:
+//   - H-bridge average voltage: duty * supply, 0 = both low sides on (brake)
+//   - armature current with L/R = 1 ms; 1.0 = stall current at full duty
+//   - speed from torque minus Coulomb friction, 50 ms mechanical time
+//     constant, 12000 RPM no-load at full duty
+//   - 2048 counts/rev quadrature encoder, latched at the tick
+// The reference flips between +REF and -REF every 4 s, as the firmware
+// profile does, and every flip after the first is measured on the true
+// plant speed:
+//   zero     flip to the speed crossing zero
+//   settle   flip to the speed entering +-SETTLE_RPM of the new reference
+//            for good (SETTLE_HOLD_MS)
+//   over     overshoot past the new reference
+//   peak     largest armature current during the reversal (x stall)
+//
+// Build and run (from Motor_Project):
+//   gcc -std=gnu11 -O2 -Wall -DAXIS_COUNT=1 -DPERIPHERALS_ESTIMATOR_ONLY -DTRACE_ENABLE=0 -IHeaders -o reversal_sim Tools/host/reversal_sim.c Source/controller.c Source/peripherals.c -lm
+//   ./reversal_sim                 # compare all strategies
+//   ./reversal_sim -csv 3          # time series (ms, ref, rpm, estimate, current, control) of one strategy
+#include "controller.h"
+#include "peripherals.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PERIOD_MS 10U
+#define FLIP_MS 4000U
+#define RUN_MS 20000U
+#define REF_RPM 2000
+#define SETTLE_RPM 100.0
+#define SETTLE_HOLD_MS 200U
+#define SUBSTEPS 10U			// plant steps per millisecond
+
+#define MAX_RPM 12000.0			// no-load speed at full duty
+#define TAU_M_S 0.05			// mechanical time constant at stall current
+#define TAU_E_S 0.001			// armature L/R
+#define FRICTION 0.03			// Coulomb friction, x stall current
+#define COUNTS_PER_REV 2048.0
+
+extern volatile int32_t REV_MODE;
+
+static const char *const mode_names[] = {"PI only", "brake", "plug", "bang-bang"};
+
+typedef struct {
+    double rpm, current, pos;
+} plant_t;
+
+// Advance the motor by one millisecond at a constant duty (-1..1).
+static void plant_step(plant_t *m, double duty) {
+    const double dt = 0.001 / SUBSTEPS;
+    for (uint32_t s = 0U; s < SUBSTEPS; s++) {
+        const double emf = m->rpm / MAX_RPM;
+        m->current += (duty - emf - m->current) * (dt / TAU_E_S);
+        double torque = m->current;
+        // Friction opposes motion, and holds a motor at rest below breakaway.
+        if (m->rpm > 0.5)
+            torque -= FRICTION;
+        else if (m->rpm < -0.5)
+            torque += FRICTION;
+        else if (fabs(torque) <= FRICTION)
+            torque = 0.0, m->rpm = 0.0;
+        else
+            torque -= (torque > 0.0) ? FRICTION : -FRICTION;
+        m->rpm += torque * (MAX_RPM / TAU_M_S) * dt;
+        m->pos += m->rpm / 60.0 * COUNTS_PER_REV * dt;
+    }
+}
+
+typedef struct {
+    uint32_t reversals;
+    double zero_ms, settle_ms, over_rpm, peak;
+} stats_t;
+
+// One run with the given strategy; prints the time series when csv is set.
+static stats_t run(int32_t mode, int csv) {
+    plant_t m = {0};
+    stats_t st = {0};
+    int32_t reference = REF_RPM, control = 0;
+    uint32_t millisec = 0U;
+
+    // Current reversal: flip time, zero crossing, last time outside the band.
+    uint32_t flip_at = 0U, zero_at = 0U, out_at = 0U;
+    double over = 0.0, peak = 0.0;
+    int measuring = 0;
+
+    REV_MODE = mode;
+    Controller_Reset();
+    srand(1);
+    if (csv)
+        printf("ms,reference,rpm,estimate,current,control\n");
+
+    // Close the reversal in progress, once it has settled for good.
+    #define CLOSE_REVERSAL()                                                        \
+        do {                                                                        \
+            if (measuring) {                                                        \
+                st.reversals++;                                                     \
+                st.zero_ms += (double)(zero_at - flip_at);                          \
+                st.settle_ms += (double)(out_at + 1U - flip_at);                    \
+                st.over_rpm += over;                                                \
+                st.peak += peak;                                                    \
+                measuring = 0;                                                      \
+            }                                                                       \
+        } while (0)
+
+    while (millisec < RUN_MS) {
+        // Plant between ticks, with the last output held.
+        const double duty = (double)control / 1073741824.0;
+        for (uint32_t ms = 0U; ms < PERIOD_MS; ms++) {
+            plant_step(&m, duty);
+            const uint32_t now = millisec + ms + 1U;
+            if (!measuring)
+                continue;
+            if (zero_at == flip_at && (m.rpm * reference) >= 0.0)
+                zero_at = now;
+            if (fabs(m.rpm - reference) > SETTLE_RPM)
+                out_at = now;
+            const double past = (reference > 0) ? m.rpm - reference : reference - m.rpm;
+            if (past > over)
+                over = past;
+            if (fabs(m.current) > peak)
+                peak = fabs(m.current);
+            if (now - out_at >= SETTLE_HOLD_MS)
+                CLOSE_REVERSAL();
+        }
+        millisec += PERIOD_MS;
+
+        if (millisec % FLIP_MS == 0U) {
+            CLOSE_REVERSAL();
+            reference = -reference;
+            // The first flip starts from a controller that never reversed.
+            if (millisec > FLIP_MS) {
+                measuring = 1;
+                flip_at = zero_at = out_at = millisec;
+                over = peak = 0.0;
+            }
+        }
+
+        Peripheral_Encoder_SetLatched(0, (int16_t)(uint16_t)(int64_t)llround(m.pos));
+        int32_t velocity = Peripheral_Encoder_CalculateVelocityAxis(0, millisec);
+        control = Controller_PIControllerAxis(0, &reference, &velocity, &millisec);
+        if (csv)
+            printf("%u,%d,%.1f,%d,%.3f,%.4f\n", millisec, reference, m.rpm, velocity, m.current,
+                   (double)control / 1073741824.0);
+    }
+    CLOSE_REVERSAL();
+    #undef CLOSE_REVERSAL
+
+    if (st.reversals != 0U) {
+        st.zero_ms /= st.reversals;
+        st.settle_ms /= st.reversals;
+        st.over_rpm /= st.reversals;
+        st.peak /= st.reversals;
+    }
+    return st;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 3 && strcmp(argv[1], "-csv") == 0) {
+        const int32_t mode = atoi(argv[2]);
+        if (mode < CONTROLLER_REV_PI || mode > CONTROLLER_REV_BANGBANG) {
+            fprintf(stderr, "strategy must be 0..3\n");
+            return 2;
+        }
+        run(mode, 1);
+        return 0;
+    }
+    if (argc != 1) {
+        fprintf(stderr, "usage: reversal_sim [-csv strategy]\n");
+        return 2;
+    }
+
+    printf("reversal +-%d RPM, mean over the flips after the first\n", REF_RPM);
+    printf("  %-10s %4s %9s %10s %10s %9s\n", "strategy", "n", "zero ms", "settle ms", "over rpm", "peak i");
+    double base = 0.0;
+    for (int32_t mode = CONTROLLER_REV_PI; mode <= CONTROLLER_REV_BANGBANG; mode++) {
+        const stats_t st = run(mode, 0);
+        if (mode == CONTROLLER_REV_PI)
+            base = st.settle_ms;
+        printf("  %-10s %4u %9.1f %10.1f %10.1f %9.2f", mode_names[mode], st.reversals, st.zero_ms,
+               st.settle_ms, st.over_rpm, st.peak);
+        if (mode != CONTROLLER_REV_PI && base > 0.0)
+            printf("   settle %+.0f%%", 100.0 * (st.settle_ms - base) / base);
+        printf("\n");
+    }
+    return 0;
+}
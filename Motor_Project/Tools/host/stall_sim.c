@@ -0,0 +1,252 @@
+// stall_sim.c
+//
+// Host plant simulation of the stall detector (Headers/stall.h) against
+// injected blocked-rotor episodes. The firmware estimator, controller, drive
+// state machine and detector (Source/peripherals.c built with
+// PERIPHERALS_ESTIMATOR_ONLY, Source/controller.c, Source/drive.c,
+// Source/stall.c) run every 10 ms tick against the DC motor model of
+// reversal_sim.c, extended with:
+//   - a blocked rotor: the shaft is held at rest whatever the torque
+//   - a bridge enable: disabled, the current freewheels back to the supply
+//     and dies out, and the motor coasts
+//   - an extra load torque, x stall current
+// Each scenario is judged on what the detector must do:
+//   normal   free runs, reversals in every strategy: no trip
+//   block    a block trips the axis; once released, a retry runs it again
+//   locked   a block that stays trips every retry and locks the axis out
+// and a block must trip within trip_ms of the speed estimate seeing it, i.e.
+// within trip_ms + g_vel_window_ms + two ticks of the block (or of the soft
+// start reaching ENABLED, if that is later), with no trip before it.
+// The table shows the trips, the time from the block to the first trip, the
+// most retries in a row, the final state, and the time from the release to
+// the speed being back within 100 RPM of the reference (recover); a retry
+// restarts the drive with its soft start.
+//
+// Build and run (from Motor_Project):
+//   gcc -std=gnu11 -O2 -Wall -DAXIS_COUNT=1 -DPERIPHERALS_ESTIMATOR_ONLY -DTRACE_ENABLE=0 -DLOG_ENABLE=0 -IHeaders -o stall_sim Tools/host/stall_sim.c Source/controller.c Source/peripherals.c Source/drive.c Source/stall.c -lm
+//   ./stall_sim                    # run every scenario, exit status 1 if one fails
+//   ./stall_sim -csv 5             # time series (ms, ref, rpm, current, control, applied, stall, drive) of one scenario
+#include "controller.h"
+#include "drive.h"
+#include "peripherals.h"
+#include "stall.h"
+#include "watchdog.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PERIOD_MS 10U
+#define FLIP_MS 4000U
+#define RECOVER_RPM 100.0
+#define SUBSTEPS 10U			// plant steps per millisecond
+
+#define MAX_RPM 12000.0			// no-load speed at full duty
+#define TAU_M_S 0.05			// mechanical time constant at stall current
+#define TAU_E_S 0.001			// armature L/R
+#define FRICTION 0.03			// Coulomb friction, x stall current
+#define COUNTS_PER_REV 2048.0
+
+#define NEVER UINT32_MAX
+
+extern volatile int32_t REV_MODE;
+extern volatile int32_t g_vel_window_ms;
+
+// The GPIO half of peripherals.c is not in the estimator build: the bridge
+// enable is the plant's.
+static int bridge_on;
+Watchdog_State_t g_watchdog;
+
+void Peripheral_GPIO_EnableMotorAxis(uint8_t axis) {
+    (void)axis;
+    bridge_on = 1;
+}
+
+void Peripheral_GPIO_DisableMotorAxis(uint8_t axis) {
+    (void)axis;
+    bridge_on = 0;
+}
+
+typedef struct {
+    double rpm, current, pos;
+} plant_t;
+
+// Advance the motor by one millisecond at a constant duty (-1..1).
+static void plant_step(plant_t *m, double duty, int blocked, double load) {
+    const double dt = 0.001 / SUBSTEPS;
+    for (uint32_t s = 0U; s < SUBSTEPS; s++) {
+        const double emf = m->rpm / MAX_RPM;
+        if (bridge_on) {
+            m->current += (duty - emf - m->current) * (dt / TAU_E_S);
+        } else if (m->current != 0.0) {
+            // Freewheel diodes put the full supply against the current.
+            const double sign = (m->current > 0.0) ? 1.0 : -1.0;
+            const double next = m->current + (-sign - emf - m->current) * (dt / TAU_E_S);
+            m->current = (next * sign > 0.0) ? next : 0.0;
+        }
+        if (blocked) {
+            m->rpm = 0.0;
+            continue;
+        }
+        double torque = m->current;
+        const double stiction = FRICTION + load;
+        // Friction opposes motion, and holds a motor at rest below breakaway.
+        if (m->rpm > 0.5)
+            torque -= stiction;
+        else if (m->rpm < -0.5)
+            torque += stiction;
+        else if (fabs(torque) <= stiction)
+            torque = 0.0, m->rpm = 0.0;
+        else
+            torque -= (torque > 0.0) ? stiction : -stiction;
+        m->rpm += torque * (MAX_RPM / TAU_M_S) * dt;
+        m->pos += m->rpm / 60.0 * COUNTS_PER_REV * dt;
+    }
+}
+
+/* Expected outcome */
+#define EXPECT_FREE 0			// never trips
+#define EXPECT_RECOVER 1		// trips, then runs again after the release
+#define EXPECT_LOCKED 2			// ends locked out
+
+typedef struct {
+    const char *name;
+    int32_t reference;			// RPM; flips every FLIP_MS when flip is set
+    uint8_t flip;
+    int32_t mode;				// reversal strategy
+    double load;				// extra load torque, x stall current
+    uint32_t block_at, release_at;	// ms; NEVER for none
+    uint32_t run_ms;
+    int expect;
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    {"reversals PI", 2000, 1, CONTROLLER_REV_PI, 0.0, NEVER, NEVER, 20000U, EXPECT_FREE},
+    {"reversals brake", 2000, 1, CONTROLLER_REV_BRAKE, 0.0, NEVER, NEVER, 20000U, EXPECT_FREE},
+    {"reversals plug", 2000, 1, CONTROLLER_REV_PLUG, 0.0, NEVER, NEVER, 20000U, EXPECT_FREE},
+    {"reversals bang", 2000, 1, CONTROLLER_REV_BANGBANG, 0.0, NEVER, NEVER, 20000U, EXPECT_FREE},
+    {"heavy load", 2000, 1, CONTROLLER_REV_PI, 0.1, NEVER, NEVER, 20000U, EXPECT_FREE},
+    {"block at speed", 2000, 0, CONTROLLER_REV_PI, 0.0, 3000U, 6000U, 15000U, EXPECT_RECOVER},
+    {"block reversing", 2000, 1, CONTROLLER_REV_PLUG, 0.0, 4000U, 7000U, 15000U, EXPECT_RECOVER},
+    {"block slow", 200, 0, CONTROLLER_REV_PI, 0.0, 8000U, 11000U, 20000U, EXPECT_RECOVER},
+    {"block at start", 2000, 0, CONTROLLER_REV_PI, 0.0, 0U, 2500U, 10000U, EXPECT_RECOVER},
+    {"block for good", 2000, 0, CONTROLLER_REV_PI, 0.0, 2000U, NEVER, 30000U, EXPECT_LOCKED},
+};
+#define SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+static const char *const state_names[] = {"running", "safe", "locked"};
+
+typedef struct {
+    uint32_t trips, early, latency_ms, recover_ms;
+    uint8_t attempt, state;
+} result_t;
+
+// One run of a scenario; prints the time series when csv is set.
+static result_t run(const scenario_t *sc, int csv) {
+    plant_t m = {0};
+    result_t r = {0, 0, NEVER, NEVER, 0U, 0U};
+    int32_t reference = sc->reference, control = 0, applied = 0;
+    uint32_t millisec = 0U, enabled_at = NEVER;
+
+    REV_MODE = sc->mode;
+    Controller_Reset();
+    Drive_Init();
+    Drive_Enable(0);
+    Stall_Init();
+    if (csv)
+        printf("ms,reference,rpm,current,control,applied,stall,drive\n");
+
+    while (millisec < sc->run_ms) {
+        // Plant between ticks, with the last output held.
+        const double duty = (double)applied / 1073741824.0;
+        for (uint32_t ms = 0U; ms < PERIOD_MS; ms++) {
+            const uint32_t now = millisec + ms;
+            const int blocked = now >= sc->block_at && now < sc->release_at;
+            plant_step(&m, duty, blocked, sc->load);
+        }
+        millisec += PERIOD_MS;
+
+        if (sc->flip && millisec % FLIP_MS == 0U)
+            reference = -reference;
+
+        Peripheral_Encoder_SetLatched(0, (int16_t)(uint16_t)(int64_t)llround(m.pos));
+        int32_t velocity = Peripheral_Encoder_CalculateVelocityAxis(0, millisec);
+        control = Controller_PIControllerAxis(0, &reference, &velocity, &millisec);
+        applied = Drive_Tick(0, control, millisec);
+        applied = Stall_Check(0, reference, velocity, applied, millisec);
+        Controller_SetApplied(0, applied);
+
+        if (g_stall[0].attempt > r.attempt)
+            r.attempt = g_stall[0].attempt;
+        if (enabled_at == NEVER && g_drive[0].state == DRIVE_ENABLED)
+            enabled_at = millisec;
+        if (millisec < sc->block_at)
+            r.early = g_stall[0].trips;
+        else if (r.latency_ms == NEVER && g_stall[0].trips > r.early)
+            r.latency_ms = millisec - ((enabled_at > sc->block_at) ? enabled_at : sc->block_at);
+        if (r.recover_ms == NEVER && millisec > sc->release_at && g_stall[0].state == STALL_RUNNING
+            && fabs(m.rpm - reference) < RECOVER_RPM)
+            r.recover_ms = millisec - sc->release_at;
+        if (csv)
+            printf("%u,%d,%.1f,%.3f,%.4f,%.4f,%u,%u\n", millisec, reference, m.rpm, m.current,
+                   (double)control / 1073741824.0, (double)applied / 1073741824.0, g_stall[0].state,
+                   g_drive[0].state);
+    }
+    r.trips = g_stall[0].trips;
+    r.state = g_stall[0].state;
+    return r;
+}
+
+static int passed(const scenario_t *sc, const result_t *r) {
+    const uint32_t latency_max = g_stall_cfg.trip_ms + (uint32_t)g_vel_window_ms + 2U * PERIOD_MS;
+    switch (sc->expect) {
+    case EXPECT_FREE:
+        return r->trips == 0U;
+    case EXPECT_RECOVER:
+        return r->early == 0U && r->latency_ms <= latency_max && r->state == STALL_RUNNING
+               && r->recover_ms != NEVER;
+    default:
+        return r->early == 0U && r->latency_ms <= latency_max && r->state == STALL_LOCKED;
+    }
+}
+
+static void print_ms(uint32_t ms) {
+    if (ms == NEVER)
+        printf(" %9s", "-");
+    else
+        printf(" %9u", ms);
+}
+
+int main(int argc, char **argv) {
+    if (argc == 3 && strcmp(argv[1], "-csv") == 0) {
+        const int n = atoi(argv[2]);
+        if (n < 0 || (size_t)n >= SCENARIOS) {
+            fprintf(stderr, "scenario must be 0..%u\n", (unsigned)SCENARIOS - 1U);
+            return 2;
+        }
+        run(&scenarios[n], 1);
+        return 0;
+    }
+    if (argc != 1) {
+        fprintf(stderr, "usage: stall_sim [-csv scenario]\n");
+        return 2;
+    }
+
+    printf("stall detector: trip %u ms, below %d rpm, effort %.2f, retry %u ms x%u\n", g_stall_cfg.trip_ms,
+           g_stall_cfg.rpm, (double)g_stall_cfg.effort / 1073741824.0, g_stall_cfg.retry_ms, g_stall_cfg.retries);
+    printf("  %2s %-16s %5s %9s %7s %-8s %9s\n", "#", "scenario", "trips", "trip ms", "retries", "state", "recover");
+    int failed = 0;
+    for (size_t n = 0; n < SCENARIOS; n++) {
+        const scenario_t *sc = &scenarios[n];
+        const result_t r = run(sc, 0);
+        const int ok = passed(sc, &r);
+        failed |= !ok;
+        printf("  %2u %-16s %5u", (unsigned)n, sc->name, r.trips);
+        print_ms(r.latency_ms);
+        printf(" %7u %-8s", r.attempt, state_names[r.state]);
+        print_ms(r.recover_ms);
+        printf("   %s\n", ok ? "ok" : "FAIL");
+    }
+    return failed;
+}
@@ -0,0 +1,305 @@
+// timesync_sim.c
+//
+// Host simulation of the CAN clock sync, so the servo in timesync.c can be
+// checked against several drifting nodes without hardware.
+//
+// Each node is modelled at PWM-period resolution the way peripherals.c runs
+// it: a 2048-count master period on its own (MSI-grade) oscillator, trimmed
+// by fractions of a count through the preloaded ARR, with the control tick
+// paced in nominal periods. Node 0 is the time master; it sends SYNC every
+// TIMESYNC_PERIOD_TICKS ticks and the TIME follow-up on the next tick. Every
+// timestamp carries interrupt latency jitter, and a few are held off long
+// enough to exercise outlier rejection.
+//
+// Once per simulated second it prints the worst control tick skew between the
+// master and any other node, and each node's drift estimate against the truth.
+//
+// Build and run (from Motor_Project):
+//   gcc -std=c11 -Wall -DTIMESYNC_SERVO_ONLY -IHeaders -o timesync_sim Tools/host/timesync_sim.c Source/timesync.c -lm
+//   ./timesync_sim [seconds]
+#include "timesync.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* ----------------- Config ----------------- */
+
+#define NODES 4
+#define CLOCK_HZ 40000000.0	// Nominal timer clock
+#define CLOCKS_PER_US 40U
+#define NOMINAL_TOP 2048U		// PWM period (clocks)
+#define TICK_CLOCKS 400000U		// 10 ms control tick
+#define SLEW_MAX 128			// Same as SYNC_SLEW_MAX in peripherals.c
+
+#define LAT_MIN_US 0.3			// Interrupt entry latency range
+#define LAT_MAX_US 2.0
+#define LATE_PERCENT 2			// Timestamps held off by a long interrupt ...
+#define LATE_US 150.0			// ... by this much
+#define TX_DELAY_MAX_US 400.0	// Queueing + arbitration before the SYNC goes out
+
+#define GRID_N 256U				// Tick history per node
+
+// Oscillator error per node (ppm) and its wander (ppm/s, temperature).
+static const double drift_ppm[NODES] = {0.0, 3000.0, -2500.0, 800.0};
+static const double wander_ppm_s[NODES] = {0.0, 5.0, -3.0, 0.0};
+// Boot time of each node (s); nodes start with unrelated clocks.
+static const double boot_s[NODES] = {0.0, 0.0123, 0.4567, 1.2345};
+
+/* ----------------- Node model ----------------- */
+
+typedef struct {
+    // Oscillator
+    double freq;
+    double last_update;       // Real time of the last master update
+    uint32_t cur_top;         // Length of the running period
+    uint32_t next_top;        // Preloaded ARR + 1, takes effect at the next update
+    // Mirror of the sync state in peripherals.c
+    uint64_t periods;
+    int64_t offset;
+    uint32_t acc;
+    int32_t trim_q16;
+    int32_t phase_left;
+    uint32_t frac_q16;
+    int trimming;
+    // Mirror of the node state in timesync.c
+    TimeSync_Servo_t servo;
+    uint64_t sync_us;
+    uint8_t sync_counter;
+    int have_sync;
+    int have_time;
+    uint8_t time_counter;
+    uint64_t time_us;
+    uint8_t ticks;
+    uint8_t counter;
+    int rejected;
+    // Tick history: real time of the tick on each grid index
+    int64_t grid_k[GRID_N];
+    double grid_t[GRID_N];
+} node_t;
+
+static node_t nodes[NODES];
+
+// Frames in flight (SYNC end of frame, TIME arrival).
+typedef struct {
+    double t;
+    int is_time;
+    uint8_t counter;
+    uint64_t time_us;
+    int live;
+} bus_event_t;
+
+#define BUS_N 8
+static bus_event_t bus[BUS_N];
+
+static double rnd(double lo, double hi) {
+    return lo + (hi - lo) * ((double)rand() / (double)RAND_MAX);
+}
+
+static double latency_us(void) {
+    double lat = rnd(LAT_MIN_US, LAT_MAX_US);
+    if (rand() % 100 < LATE_PERCENT)
+        lat += LATE_US;
+    return lat;
+}
+
+// Peripheral_Sync_TimeUs at real time t.
+static uint64_t node_time_us(const node_t *n, double t) {
+    double cnt = (t - n->last_update) * n->freq;
+    if (cnt < 0.0)
+        cnt = 0.0;
+    const int64_t clocks = (int64_t)(n->periods * NOMINAL_TOP) + n->offset + (int64_t)cnt;
+    return (uint64_t)clocks / CLOCKS_PER_US;
+}
+
+static void node_step(node_t *n, int64_t step_us) {
+    const int64_t step = step_us * (int64_t)CLOCKS_PER_US;
+    const int64_t top = (int64_t)NOMINAL_TOP;
+    const int64_t whole = ((step >= 0) ? (step + top / 2) : (step - top / 2)) / top * top;
+    n->offset += whole;
+    n->phase_left = (int32_t)(step - whole);
+    n->trimming = 1;
+    const uint64_t clocks = (uint64_t)((int64_t)(n->periods * NOMINAL_TOP) + n->offset);
+    n->acc = (uint32_t)(clocks % TICK_CLOCKS);
+}
+
+static void node_trim(node_t *n, int32_t ppb, int32_t phase_us) {
+    n->trim_q16 = (int32_t)(-((int64_t)NOMINAL_TOP * 65536 * ppb) / 1000000000);
+    n->phase_left = phase_us * (int32_t)CLOCKS_PER_US;
+    n->trimming = 1;
+}
+
+static void node_next_period(node_t *n) {
+    int32_t slice = n->phase_left;
+    if (slice > SLEW_MAX)
+        slice = SLEW_MAX;
+    if (slice < -SLEW_MAX)
+        slice = -SLEW_MAX;
+    n->phase_left -= slice;
+    const int64_t len_q16 = ((int64_t)NOMINAL_TOP << 16) + n->trim_q16 - ((int64_t)slice << 16);
+    const uint64_t sum_q16 = (uint64_t)n->frac_q16 + (uint64_t)len_q16;
+    n->frac_q16 = (uint32_t)(sum_q16 & 0xFFFFU);
+    n->next_top = (uint32_t)(sum_q16 >> 16);
+}
+
+static void bus_send(double t, int is_time, uint8_t counter, uint64_t time_us) {
+    for (int i = 0; i < BUS_N; i++) {
+        if (!bus[i].live) {
+            bus[i] = (bus_event_t){t, is_time, counter, time_us, 1};
+            return;
+        }
+    }
+    fprintf(stderr, "bus overrun\n");
+    exit(1);
+}
+
+// TimeSync_Tick on one node.
+static void node_tick(int id, double t) {
+    node_t *n = &nodes[id];
+    const uint64_t clocks = (uint64_t)((int64_t)(n->periods * NOMINAL_TOP) + n->offset);
+    const int64_t k = (int64_t)(clocks / TICK_CLOCKS);
+    n->grid_k[(uint64_t)k % GRID_N] = k;
+    n->grid_t[(uint64_t)k % GRID_N] = t;
+
+    if (n->have_time) {
+        n->have_time = 0;
+        if (n->have_sync && n->sync_counter == n->time_counter) {
+            TimeSync_Correction_t c;
+            if (!TimeSync_ServoSample(&n->servo, n->time_us, n->sync_us, &c))
+                n->rejected++;
+            else if (c.step_us != 0)
+                node_step(n, c.step_us);
+            else
+                node_trim(n, c.ppb, c.phase_us);
+        }
+    }
+
+    if (id != 0)
+        return;
+    if (n->have_sync) {
+        // TIME follow-up of the SYNC that went out since the last tick.
+        bus_send(t + rnd(100.0, TX_DELAY_MAX_US) * 1e-6, 1, n->sync_counter, n->sync_us);
+        n->have_sync = 0;
+    }
+    if (++n->ticks < TIMESYNC_PERIOD_TICKS)
+        return;
+    n->ticks = 0;
+    bus_send(t + rnd(100.0, TX_DELAY_MAX_US) * 1e-6, 0, n->counter++, 0U);
+}
+
+// Peripheral_Sync_OnUpdate on one node.
+static void node_update(int id) {
+    node_t *n = &nodes[id];
+    const double t = n->last_update + (double)n->cur_top / n->freq;
+    n->last_update = t;
+    n->periods++;
+    n->cur_top = n->next_top;
+    if (n->trimming)
+        node_next_period(n);
+    n->acc += NOMINAL_TOP;
+    if (n->acc >= TICK_CLOCKS) {
+        n->acc -= TICK_CLOCKS;
+        node_tick(id, t);
+    }
+}
+
+static void bus_deliver(bus_event_t *ev) {
+    for (int id = 0; id < NODES; id++) {
+        node_t *n = &nodes[id];
+        if (ev->t < boot_s[id])
+            continue;
+        if (ev->is_time) {
+            if (id == 0)
+                continue;
+            n->have_time = 1;
+            n->time_counter = ev->counter;
+            n->time_us = ev->time_us;
+        } else {
+            // Master: TX complete interrupt; others: RX interrupt.
+            n->sync_us = node_time_us(n, ev->t + latency_us() * 1e-6);
+            n->sync_counter = ev->counter;
+            n->have_sync = 1;
+        }
+    }
+    ev->live = 0;
+}
+
+/* ----------------- Main ----------------- */
+
+int main(int argc, char **argv) {
+    const int seconds = (argc > 1) ? atoi(argv[1]) : 30;
+    srand(1);
+
+    for (int id = 0; id < NODES; id++) {
+        node_t *n = &nodes[id];
+        *n = (node_t){0};
+        n->freq = CLOCK_HZ * (1.0 + drift_ppm[id] * 1e-6);
+        n->last_update = boot_s[id];
+        n->cur_top = n->next_top = NOMINAL_TOP;
+        TimeSync_ServoReset(&n->servo);
+        for (uint32_t i = 0; i < GRID_N; i++)
+            n->grid_k[i] = -1;
+    }
+
+    printf("   t [s]  max tick skew [us]   drift estimate / truth [ppm] per node, rejected\n");
+    double next_report = 1.0;
+    for (;;) {
+        // Earliest pending event: a node update or a frame on the bus.
+        int node_id = -1;
+        double t_node = 1e30;
+        for (int id = 0; id < NODES; id++) {
+            const double t = nodes[id].last_update + (double)nodes[id].cur_top / nodes[id].freq;
+            if (t < t_node) {
+                t_node = t;
+                node_id = id;
+            }
+        }
+        bus_event_t *ev = NULL;
+        for (int i = 0; i < BUS_N; i++) {
+            if (bus[i].live && (ev == NULL || bus[i].t < ev->t))
+                ev = &bus[i];
+        }
+
+        const double t = (ev != NULL && ev->t < t_node) ? ev->t : t_node;
+        if (t >= next_report) {
+            // Compare a tick every node has already passed.
+            const node_t *m = &nodes[0];
+            const uint64_t mc = (uint64_t)((int64_t)(m->periods * NOMINAL_TOP) + m->offset);
+            const int64_t k = (int64_t)(mc / TICK_CLOCKS) - 4;
+            double skew = 0.0;
+            int complete = 1;
+            for (int id = 1; id < NODES; id++) {
+                const node_t *n = &nodes[id];
+                const uint64_t slot = (uint64_t)k % GRID_N;
+                if (n->grid_k[slot] != k || m->grid_k[slot] != k) {
+                    complete = 0;
+                    continue;
+                }
+                const double d = fabs(n->grid_t[slot] - m->grid_t[slot]) * 1e6;
+                if (d > skew)
+                    skew = d;
+            }
+            if (complete)
+                printf("%8.1f  %18.2f ", next_report, skew);
+            else
+                printf("%8.1f  %18s ", next_report, "(acquiring)");
+            for (int id = 1; id < NODES; id++) {
+                const double truth = -(drift_ppm[id] + wander_ppm_s[id] * (next_report - boot_s[id]));
+                printf("  %8.1f/%8.1f %d", (double)nodes[id].servo.drift_ppb * 1e-3, truth, nodes[id].rejected);
+            }
+            printf("\n");
+            next_report += 1.0;
+            if (next_report > (double)seconds)
+                break;
+        }
+
+        if (ev != NULL && ev->t < t_node) {
+            bus_deliver(ev);
+            continue;
+        }
+        node_t *n = &nodes[node_id];
+        n->freq = CLOCK_HZ * (1.0 + (drift_ppm[node_id] + wander_ppm_s[node_id] * (t_node - boot_s[node_id])) * 1e-6);
+        node_update(node_id);
+    }
+    return 0;
+}
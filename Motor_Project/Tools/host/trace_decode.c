@@ -0,0 +1,326 @@
+// trace_decode.c
+//
+// Host decoder for the RAM trace ring (g_trace, Headers/trace.h). It turns a
+// memory dump into a timeline and a per-stage latency breakdown of the
+// control tick:
+//   tick start -> estimate -> controller -> PWM applied (per axis) -> tick end
+//
+// Dump g_trace from the uVision debugger command window, e.g.
+//   SAVE trace.hex g_trace, (g_trace + sizeof(g_trace) - 1)
+// which writes Intel HEX; a raw binary dump of the same range also works.
+//
+// Build and run (from Motor_Project):
+//   gcc -std=c11 -Wall -o trace_decode Tools/host/trace_decode.c
+//   ./trace_decode trace.hex          # timeline + latency table
+//   ./trace_decode -q trace.hex       # latency table only
+//   ./trace_decode -demo              # decode a synthetic trace
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ----------------- Layout (must match Headers/trace.h) ----------------- */
+
+#define TRACE_MAGIC 0x31435254U
+#define HEADER_BYTES 16U
+#define RECORD_BYTES 12U
+#define NO_AXIS 0xFFFFU
+#define MAX_AXES 4U
+#define MAX_RECORDS 65536U
+
+enum { TICK_START = 1, EST_DONE, CTRL_DONE, PWM_APPLIED, SATURATION, REVERSAL, TICK_END, REVERSAL_DONE };
+
+static const char *const names[] = {"?", "TickStart", "EstDone", "CtrlDone", "PwmApplied",
+                                    "Saturation", "Reversal", "TickEnd", "ReversalDone"};
+
+typedef struct {
+    uint32_t cycles;
+    uint16_t id;
+    uint16_t axis;
+    int32_t payload;
+} record_t;
+
+static uint8_t image[HEADER_BYTES + MAX_RECORDS * RECORD_BYTES];
+static size_t image_len = 0;
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/* ----------------- Input ----------------- */
+
+static int hex_byte(const char *s) {
+    unsigned v;
+    return (sscanf(s, "%2x", &v) == 1) ? (int)v : -1;
+}
+
+// Intel HEX: data records only, addresses relative to the first one.
+static int load_hex(FILE *f) {
+    char line[600];
+    long base = -1;
+    uint32_t upper = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] != ':')
+            continue;
+        const int len = hex_byte(line + 1);
+        const int addr = (hex_byte(line + 3) << 8) | hex_byte(line + 5);
+        const int type = hex_byte(line + 7);
+        if (len < 0 || type < 0)
+            return 0;
+        if (type == 4) {
+            upper = (uint32_t)((hex_byte(line + 9) << 8) | hex_byte(line + 11)) << 16;
+        } else if (type == 0) {
+            const long at = (long)(upper + (uint32_t)addr);
+            if (base < 0)
+                base = at;
+            for (int i = 0; i < len; i++) {
+                const long off = at - base + i;
+                if (off < 0 || (size_t)off >= sizeof(image))
+                    return 0;
+                image[off] = (uint8_t)hex_byte(line + 9 + 2 * i);
+                if ((size_t)off + 1U > image_len)
+                    image_len = (size_t)off + 1U;
+            }
+        }
+    }
+    return 1;
+}
+
+static int load(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    const int c = fgetc(f);
+    rewind(f);
+    int ok;
+    if (c == ':') {
+        ok = load_hex(f);
+    } else {
+        image_len = fread(image, 1, sizeof(image), f);
+        ok = 1;
+    }
+    fclose(f);
+    return ok;
+}
+
+// Synthetic trace shaped like a real one: 2 axes, a few ticks, one reversal.
+static void make_demo(void) {
+    const uint32_t n = 64U, hz = 40000000U;
+    uint32_t t = 0U, index = 0U;
+    memset(image, 0, sizeof(image));
+    uint8_t *p = image;
+    const uint32_t hdr[4] = {TRACE_MAGIC, n, hz, 0U};
+    for (int i = 0; i < 4; i++)
+        for (int b = 0; b < 4; b++)
+            p[4 * i + b] = (uint8_t)(hdr[i] >> (8 * b));
+
+#define PUT(ID, AXIS, PAYLOAD, DT)                                     \
+    do {                                                               \
+        t += (DT);                                                     \
+        uint8_t *r = image + HEADER_BYTES + (index % n) * RECORD_BYTES; \
+        const uint32_t v[3] = {t, (uint32_t)(ID) | ((uint32_t)(AXIS) << 16), (uint32_t)(PAYLOAD)}; \
+        for (int w = 0; w < 3; w++)                                    \
+            for (int b = 0; b < 4; b++)                                \
+                r[4 * w + b] = (uint8_t)(v[w] >> (8 * b));             \
+        index++;                                                       \
+    } while (0)
+
+    for (uint32_t tick = 0; tick < 8U; tick++) {
+        const int32_t ref = (tick < 5U) ? 2000 : -2000;
+        t = 1000U + 400000U * tick + (tick % 3U) * 37U; // a little release jitter
+        PUT(TICK_START, NO_AXIS, 10 * (tick + 1U), 0U);
+        if (tick == 5U) {
+            PUT(REVERSAL, 0, ref, 40U);
+            PUT(REVERSAL, 1, ref, 12U);
+        }
+        for (uint16_t axis = 0; axis < 2U; axis++) {
+            PUT(EST_DONE, axis, 1990 + (int)tick, 210U + 3U * tick);
+            if (tick == 5U)
+                PUT(SATURATION, axis, 12345, 150U);
+            PUT(CTRL_DONE, axis, ref * 100000, 320U);
+            PUT(PWM_APPLIED, axis, ref * 100000, 45U);
+        }
+        PUT(TICK_END, NO_AXIS, 10 * (tick + 1U), 60U);
+    }
+#undef PUT
+    for (int b = 0; b < 4; b++)
+        image[12 + b] = (uint8_t)(index >> (8 * b));
+    image_len = HEADER_BYTES + n * RECORD_BYTES;
+}
+
+/* ----------------- Latency statistics ----------------- */
+
+typedef struct {
+    const char *name;
+    uint32_t n;
+    uint64_t sum;
+    uint32_t min;
+    uint32_t max;
+} stat_t;
+
+static void stat_add(stat_t *s, uint32_t cycles) {
+    if (s->n == 0U || cycles < s->min)
+        s->min = cycles;
+    if (cycles > s->max)
+        s->max = cycles;
+    s->sum += cycles;
+    s->n++;
+}
+
+static void stat_print(const stat_t *s, double us_per_cycle) {
+    if (s->n == 0U)
+        return;
+    printf("  %-28s %6u  %9.2f %9.2f %9.2f\n", s->name, s->n, s->min * us_per_cycle,
+           (double)s->sum / s->n * us_per_cycle, s->max * us_per_cycle);
+}
+
+/* ----------------- Main ----------------- */
+
+int main(int argc, char **argv) {
+    int quiet = 0, demo = 0;
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-q"))
+            quiet = 1;
+        else if (!strcmp(argv[i], "-demo"))
+            demo = 1;
+        else
+            path = argv[i];
+    }
+    if (demo) {
+        make_demo();
+    } else if (!path || !load(path)) {
+        fprintf(stderr, "usage: %s [-q] dump.hex|dump.bin | -demo\n", argv[0]);
+        return 2;
+    }
+
+    if (image_len < HEADER_BYTES || get_u32(image) != TRACE_MAGIC) {
+        fprintf(stderr, "not a trace dump (bad magic)\n");
+        return 1;
+    }
+    const uint32_t count = get_u32(image + 4);
+    const uint32_t hz = get_u32(image + 8);
+    const uint32_t index = get_u32(image + 12);
+    if (count == 0U || count > MAX_RECORDS || image_len < HEADER_BYTES + (size_t)count * RECORD_BYTES) {
+        fprintf(stderr, "truncated dump (%u records declared)\n", count);
+        return 1;
+    }
+    const double us = 1e6 / (double)(hz ? hz : 1U);
+
+    // Oldest record first: once the ring has wrapped it starts at index.
+    const uint32_t n = (index < count) ? index : count;
+    const uint32_t first = (index < count) ? 0U : index % count;
+    record_t *rec = calloc(n ? n : 1U, sizeof(record_t));
+    for (uint32_t i = 0; i < n; i++) {
+        const uint8_t *p = image + HEADER_BYTES + (size_t)((first + i) % count) * RECORD_BYTES;
+        rec[i].cycles = get_u32(p);
+        rec[i].id = get_u16(p + 4);
+        rec[i].axis = get_u16(p + 6);
+        rec[i].payload = (int32_t)get_u32(p + 8);
+    }
+    printf("%u records (%u written, ring %u), %.1f MHz cycle counter\n\n", n, index, count, hz / 1e6);
+
+    if (!quiet) {
+        printf("  time [us]   +dt [us]  event        axis  payload\n");
+        for (uint32_t i = 0; i < n; i++) {
+            const uint32_t since = rec[i].cycles - rec[0].cycles;
+            const uint32_t dt = i ? rec[i].cycles - rec[i - 1].cycles : 0U;
+            const char *name = (rec[i].id < sizeof(names) / sizeof(names[0])) ? names[rec[i].id] : "?";
+            if (rec[i].id == TICK_START)
+                printf("  ----------\n");
+            printf("%11.2f %10.2f  %-11s ", since * us, dt * us, name);
+            if (rec[i].axis == NO_AXIS)
+                printf("   -  ");
+            else
+                printf("%4u  ", rec[i].axis);
+            printf("%d\n", rec[i].payload);
+        }
+        printf("\n");
+    }
+
+    // Latency breakdown, per stage, over complete ticks.
+    stat_t total = {"tick start -> tick end", 0, 0, 0, 0};
+    stat_t period = {"tick start -> next start", 0, 0, 0, 0};
+    stat_t est[MAX_AXES], ctrl[MAX_AXES], pwm[MAX_AXES], io[MAX_AXES];
+    static char labels[4][MAX_AXES][40];
+    for (uint32_t a = 0; a < MAX_AXES; a++) {
+        snprintf(labels[0][a], 40, "axis %u: -> estimate", a);
+        snprintf(labels[1][a], 40, "axis %u: estimate -> ctrl", a);
+        snprintf(labels[2][a], 40, "axis %u: ctrl -> PWM", a);
+        snprintf(labels[3][a], 40, "axis %u: tick start -> PWM", a);
+        est[a] = (stat_t){labels[0][a], 0, 0, 0, 0};
+        ctrl[a] = (stat_t){labels[1][a], 0, 0, 0, 0};
+        pwm[a] = (stat_t){labels[2][a], 0, 0, 0, 0};
+        io[a] = (stat_t){labels[3][a], 0, 0, 0, 0};
+    }
+    uint32_t saturations = 0, reversals = 0, managed = 0, managed_ms = 0;
+    int have_start = 0;
+    uint32_t start = 0, last = 0, prev_start = 0;
+    uint32_t est_at[MAX_AXES] = {0}, ctrl_at[MAX_AXES] = {0};
+    for (uint32_t i = 0; i < n; i++) {
+        const record_t *r = &rec[i];
+        const uint32_t a = (r->axis < MAX_AXES) ? r->axis : 0U;
+        switch (r->id) {
+        case TICK_START:
+            if (have_start)
+                stat_add(&period, r->cycles - prev_start);
+            have_start = 1;
+            start = prev_start = last = r->cycles;
+            break;
+        case EST_DONE:
+            if (have_start)
+                stat_add(&est[a], r->cycles - last);
+            est_at[a] = r->cycles;
+            break;
+        case CTRL_DONE:
+            if (have_start)
+                stat_add(&ctrl[a], r->cycles - est_at[a]);
+            ctrl_at[a] = r->cycles;
+            break;
+        case PWM_APPLIED:
+            if (have_start) {
+                stat_add(&pwm[a], r->cycles - ctrl_at[a]);
+                stat_add(&io[a], r->cycles - start);
+            }
+            last = r->cycles;
+            break;
+        case TICK_END:
+            if (have_start)
+                stat_add(&total, r->cycles - start);
+            break;
+        case SATURATION:
+            saturations++;
+            break;
+        case REVERSAL:
+            reversals++;
+            break;
+        case REVERSAL_DONE:
+            managed++;
+            managed_ms += (uint32_t)r->payload;
+            break;
+        default:
+            break;
+        }
+    }
+
+    printf("  %-28s %6s  %9s %9s %9s\n", "stage [us]", "n", "min", "avg", "max");
+    for (uint32_t a = 0; a < MAX_AXES; a++) {
+        stat_print(&est[a], us);
+        stat_print(&ctrl[a], us);
+        stat_print(&pwm[a], us);
+        stat_print(&io[a], us);
+    }
+    stat_print(&total, us);
+    stat_print(&period, us);
+    printf("\n  saturation events: %u, reversals: %u\n", saturations, reversals);
+    if (managed != 0U)
+        printf("  reversal manager: %u handoffs, %u ms on average\n", managed, managed_ms / managed);
+    free(rec);
+    return 0;
+}